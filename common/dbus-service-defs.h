@@ -23,6 +23,7 @@
 #define CPIM_SERVICE_NAME                   "com.canonical.pim"
 #define CPIM_ADDRESSBOOK_OBJECT_PATH        "/com/canonical/pim/AddressBook"
 #define CPIM_ADDRESSBOOK_IFACE_NAME         "com.canonical.pim.AddressBook"
+#define CPIM_ADDRESSBOOK_STATS_IFACE_NAME   "com.canonical.pim.AddressBook.Stats"
 #define CPIM_ADDRESSBOOK_VIEW_OBJECT_PATH   "/com/canonical/pim/AddressBookView"
 #define CPIM_ADDRESSBOOK_VIEW_IFACE_NAME    "com.canonical.pim.AddressBookView"
 
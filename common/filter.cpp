@@ -23,6 +23,9 @@
 #include <QtCore/QString>
 #include <QtCore/QLocale>
 #include <QtCore/QDebug>
+#include <QtCore/QCache>
+#include <QtCore/QPair>
+#include <QtCore/QThreadStorage>
 
 #include <QtContacts/QContactGuid>
 #include <QtContacts/QContactExtendedDetail>
@@ -35,9 +38,41 @@
 #include <QtContacts/QContactDetailFilter>
 #include <QtContacts/QContactIdFilter>
 #include <QtContacts/QContactRelationshipFilter>
+#include <QtContacts/QContactPhoneNumber>
 
 #include <phonenumbers/phonenumberutil.h>
 
+// max number of entries in the per thread phone number memo tables, the least recently used entries are dropped
+#define FILTER_PHONE_NORMALIZE_MEMO_SIZE    1024
+#define FILTER_PHONE_MATCH_MEMO_SIZE        2048
+
+namespace
+{
+    // the filter runs in several threads at same time, each thread keeps its own memo to avoid locks
+    struct PhoneMemo
+    {
+        PhoneMemo()
+            : normalized(FILTER_PHONE_NORMALIZE_MEMO_SIZE),
+              matches(FILTER_PHONE_MATCH_MEMO_SIZE)
+        {
+        }
+
+        QCache<QString, QString> normalized;
+        // keyed by the normalized numbers
+        QCache<QPair<QString, QString>, int> matches;
+    };
+
+    QThreadStorage<PhoneMemo*> phoneMemo;
+
+    PhoneMemo *threadPhoneMemo()
+    {
+        if (!phoneMemo.hasLocalData()) {
+            phoneMemo.setLocalData(new PhoneMemo);
+        }
+        return phoneMemo.localData();
+    }
+}
+
 using namespace QtContacts;
 
 namespace galera
@@ -63,18 +98,19 @@ QtContacts::QContactFilter Filter::toContactFilter() const
     return m_filter;
 }
 
-bool Filter::test(const QContact &contact, const QDateTime &deletedDate) const
+bool Filter::test(const QContact &contact, const QDateTime &deletedDate, const QStringList &normalizedPhones) const
 {
     if (deletedDate.isValid() && !includeRemoved()) {
         return false;
     }
 
-    return testFilter(m_filter, contact, deletedDate);
+    return testFilter(m_filter, contact, deletedDate, normalizedPhones);
 }
 
 bool Filter::testFilter(const QContactFilter& filter,
                         const QContact &contact,
-                        const QDateTime &deletedDate)
+                        const QDateTime &deletedDate,
+                        const QStringList &normalizedPhones)
 {
     switch(filter.type()) {
         case QContactFilter::IdFilter:
@@ -109,14 +145,26 @@ bool Filter::testFilter(const QContactFilter& filter,
 
             if (cdf.matchFlags() & QContactFilter::MatchPhoneNumber) {
                 /* Doing phone number filtering.  We hand roll an implementation here, backends will obviously want to override this. */
-                QString input = cdf.value().toString();
+                QString input = normalizePhoneNumber(cdf.value().toString());
+
+                if ((cdf.detailType() == QContactPhoneNumber::Type) &&
+                    (cdf.detailField() == QContactPhoneNumber::FieldNumber) &&
+                    !normalizedPhones.isEmpty()) {
+                    // the numbers were already normalized by the caller
+                    Q_FOREACH(const QString &value, normalizedPhones) {
+                        if (comparePhoneNumbers(input, value, cdf.matchFlags())) {
+                            return true;
+                        }
+                    }
+                    break;
+                }
 
                 /* Look at every detail in the set of details and compare */
                 for (int j = 0; j < details.count(); j++) {
                     const QContactDetail& detail = details.at(j);
                     const QString& valueString = detail.value(cdf.detailField()).toString();
 
-                    if (comparePhoneNumbers(input, valueString, cdf.matchFlags())) {
+                    if (comparePhoneNumbers(input, normalizePhoneNumber(valueString), cdf.matchFlags())) {
                         return true;
                     }
                 }
@@ -137,7 +185,7 @@ bool Filter::testFilter(const QContactFilter& filter,
             }
 
            Q_FOREACH(const QContactFilter &f, terms) {
-                if (!testFilter(f, contact, deletedDate)) {
+                if (!testFilter(f, contact, deletedDate, normalizedPhones)) {
                     return false;
                 }
             }
@@ -152,7 +200,7 @@ bool Filter::testFilter(const QContactFilter& filter,
             const QList<QContactFilter>& terms = bf.filters();
             if (terms.count() > 0) {
                 for(int j = 0; j < terms.count(); j++) {
-                    if (testFilter(terms.at(j), contact, deletedDate)) {
+                    if (testFilter(terms.at(j), contact, deletedDate, normalizedPhones)) {
                         return true;
                     }
                 }
@@ -173,19 +221,132 @@ bool Filter::testFilter(const QContactFilter& filter,
     return false;
 }
 
-bool Filter::comparePhoneNumbers(const QString &input, const QString &value, QContactFilter::MatchFlags flags)
+bool Filter::isNarrowerThan(const Filter &other) const
+{
+    return isNarrowerThan(m_filter, other.m_filter);
+}
+
+bool Filter::isNarrowerThan(const QContactFilter &filter, const QContactFilter &other)
+{
+    if (filter.type() != other.type()) {
+        return false;
+    }
+
+    switch(filter.type()) {
+        case QContactFilter::ContactDetailFilter:
+            return isNarrowerValue(QContactDetailFilter(filter), QContactDetailFilter(other));
+
+        case QContactFilter::IntersectionFilter:
+        case QContactFilter::UnionFilter:
+        {
+            // only filters with the same structure are compared, each term must be narrower
+            // than the term in the same position
+            QList<QContactFilter> terms;
+            QList<QContactFilter> otherTerms;
+            if (filter.type() == QContactFilter::IntersectionFilter) {
+                terms = QContactIntersectionFilter(filter).filters();
+                otherTerms = QContactIntersectionFilter(other).filters();
+            } else {
+                terms = QContactUnionFilter(filter).filters();
+                otherTerms = QContactUnionFilter(other).filters();
+            }
+
+            if (terms.size() != otherTerms.size()) {
+                return false;
+            }
+
+            for (int i = 0; i < terms.size(); i++) {
+                if (!isNarrowerThan(terms[i], otherTerms[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        default:
+            return (filter == other);
+    }
+}
+
+bool Filter::isNarrowerValue(const QContactDetailFilter &filter, const QContactDetailFilter &other)
+{
+    if ((filter.detailType() != other.detailType()) ||
+        (filter.detailField() != other.detailField()) ||
+        (filter.matchFlags() != other.matchFlags())) {
+        return false;
+    }
+
+    QString value = filter.value().toString();
+    QString otherValue = other.value().toString();
+    if (value == otherValue) {
+        return true;
+    }
+
+    QContactFilter::MatchFlags flags = filter.matchFlags();
+    bool mc = flags & QContactFilter::MatchContains;
+    bool msw = flags & QContactFilter::MatchStartsWith;
+    bool mew = flags & QContactFilter::MatchEndsWith;
+    if (!mc && !msw && !mew) {
+        return false;
+    }
+
+    if (flags & QContactFilter::MatchPhoneNumber) {
+        // phone numbers are compared after the normalization, a empty number does not match anything
+        value = normalizePhoneNumber(value);
+        otherValue = normalizePhoneNumber(otherValue);
+        if (otherValue.isEmpty()) {
+            return value.isEmpty();
+        }
+    }
+
+    Qt::CaseSensitivity cs = (flags & QContactFilter::MatchCaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (mc) {
+        return value.contains(otherValue, cs);
+    } else if (msw) {
+        return value.startsWith(otherValue, cs);
+    } else {
+        return value.endsWith(otherValue, cs);
+    }
+}
+
+QString Filter::normalizePhoneNumber(const QString &phoneNumber)
 {
     static i18n::phonenumbers::PhoneNumberUtil *phonenumberUtil = i18n::phonenumbers::PhoneNumberUtil::GetInstance();
 
-    std::string stdPreprocessedInput(input.toStdString());
-    std::string stdProcessedValue(value.toStdString());
+    PhoneMemo *memo = threadPhoneMemo();
+    QString *cached = memo->normalized.object(phoneNumber);
+    if (cached) {
+        return *cached;
+    }
 
-    phonenumberUtil->NormalizeDiallableCharsOnly(&stdPreprocessedInput);
-    phonenumberUtil->NormalizeDiallableCharsOnly(&stdProcessedValue);
+    std::string stdPreprocessedPhone(phoneNumber.toStdString());
+    phonenumberUtil->NormalizeDiallableCharsOnly(&stdPreprocessedPhone);
+    QString result = QString::fromStdString(stdPreprocessedPhone);
 
-    QString preprocessedInput = QString::fromStdString(stdPreprocessedInput);
-    QString preprocessedValue = QString::fromStdString(stdProcessedValue);
+    memo->normalized.insert(phoneNumber, new QString(result));
+    return result;
+}
 
+int Filter::matchPhoneNumbers(const QString &phoneNumberA, const QString &phoneNumberB)
+{
+    static i18n::phonenumbers::PhoneNumberUtil *phonenumberUtil = i18n::phonenumbers::PhoneNumberUtil::GetInstance();
+
+    QPair<QString, QString> key(phoneNumberA, phoneNumberB);
+    PhoneMemo *memo = threadPhoneMemo();
+    int *cached = memo->matches.object(key);
+    if (cached) {
+        return *cached;
+    }
+
+    int match = phonenumberUtil->IsNumberMatchWithTwoStrings(phoneNumberA.toStdString(),
+                                                             phoneNumberB.toStdString());
+
+    memo->matches.insert(key, new int(match));
+    return match;
+}
+
+bool Filter::comparePhoneNumbers(const QString &preprocessedInput, const QString &preprocessedValue, QContactFilter::MatchFlags flags)
+{
     // if one of they does not contain digits return false
     if (preprocessedInput.isEmpty() || preprocessedValue.isEmpty()) {
         return false;
@@ -207,9 +368,7 @@ bool Filter::comparePhoneNumbers(const QString &input, const QString &value, QCo
     } else if (mew) {
         return preprocessedValue.endsWith(preprocessedInput);
     } else {
-        i18n::phonenumbers::PhoneNumberUtil::MatchType match =
-                phonenumberUtil->IsNumberMatchWithTwoStrings(input.toStdString(),
-                                                             value.toStdString());
+        int match = matchPhoneNumbers(preprocessedInput, preprocessedValue);
         if (me) {
             return match == i18n::phonenumbers::PhoneNumberUtil::EXACT_MATCH;
         } else {
@@ -20,7 +20,9 @@
 #define __GALERA_FILTER_H__
 
 #include <QtCore/QDateTime>
+#include <QtCore/QStringList>
 #include <QtContacts/QContactFilter>
+#include <QtContacts/QContactDetailFilter>
 #include <QtContacts/QContact>
 
 
@@ -35,15 +37,26 @@ public:
 
     QString toString() const;
     QtContacts::QContactFilter toContactFilter() const;
-    bool test(const QtContacts::QContact &contact, const QDateTime &deletedDate = QDateTime()) const;
+    // normalizedPhones are the contact phone numbers already normalized with normalizePhoneNumber,
+    // if empty the numbers are normalized from the contact details
+    bool test(const QtContacts::QContact &contact,
+              const QDateTime &deletedDate = QDateTime(),
+              const QStringList &normalizedPhones = QStringList()) const;
     bool isValid() const;
     bool isEmpty() const;
     bool includeRemoved() const;
+    // true if every contact accepted by this filter is also accepted by the other filter
+    bool isNarrowerThan(const Filter &other) const;
 
     // optimization by index
     QString phoneNumberToFilter() const;
     QStringList idsToFilter() const;
 
+    // phone number helpers, the results are memoized per thread
+    static QString normalizePhoneNumber(const QString &phoneNumber);
+    // both numbers must be normalized with normalizePhoneNumber
+    static int matchPhoneNumbers(const QString &phoneNumberA, const QString &phoneNumberB);
+
 private:
     QtContacts::QContactFilter m_filter;
 
@@ -65,8 +78,10 @@ private:
     static QtContacts::QContactFilter parseFilter(const QtContacts::QContactFilter &filter);
     static QtContacts::QContactFilter parseUnionFilter(const QtContacts::QContactFilter &filter);
     static QtContacts::QContactFilter parseIntersectionFilter(const QtContacts::QContactFilter &filter);
-    static bool testFilter(const QtContacts::QContactFilter& filter, const QtContacts::QContact &contact, const QDateTime &deletedDate);
-    static bool comparePhoneNumbers(const QString &phoneNumberA, const QString &phoneNumberB, QtContacts::QContactFilter::MatchFlags flags);
+    static bool testFilter(const QtContacts::QContactFilter& filter, const QtContacts::QContact &contact, const QDateTime &deletedDate, const QStringList &normalizedPhones);
+    static bool isNarrowerThan(const QtContacts::QContactFilter &filter, const QtContacts::QContactFilter &other);
+    static bool isNarrowerValue(const QtContacts::QContactDetailFilter &filter, const QtContacts::QContactDetailFilter &other);
+    static bool comparePhoneNumbers(const QString &preprocessedInput, const QString &preprocessedValue, QtContacts::QContactFilter::MatchFlags flags);
 };
 
 }
@@ -20,6 +20,11 @@
 
 #include <QtCore/QMimeDatabase>
 #include <QtCore/QMimeType>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
 
 #include <QtVersit/QVersitDocument>
 #include <QtVersit/QVersitWriter>
@@ -34,6 +39,9 @@
 using namespace QtVersit;
 using namespace QtContacts;
 
+// minimum number of vcards parsed by each thread
+#define VCARD_PARSER_MIN_CHUNK_SIZE     10
+
 namespace
 {
     class ContactExporterDetailHandler : public QVersitContactExporterDetailHandlerV2
@@ -108,6 +116,14 @@ namespace
                     QVersitProperty &prop = toBeAdded->last();
                     prop.insertParameter(QStringLiteral("VALUE"), QStringLiteral("URL"));
                     prop.setValue(avatar.imageUrl().toString(QUrl::RemoveUserInfo));
+                    // downscaled renditions generated by the service (Eg. X-THUMBNAIL-48=<path>), the
+                    // local path is used because the ':' of the url is not allowed on parameter values
+                    QVariantMap thumbnails = avatar.value(galera::VCardParser::AvatarThumbnailsField).toMap();
+                    QVariantMap::const_iterator i = thumbnails.constBegin();
+                    for(; i != thumbnails.constEnd(); i++) {
+                        prop.insertParameter(galera::VCardParser::ThumbnailParamName + i.key(),
+                                             QUrl(i.value().toString()).toLocalFile());
+                    }
                     break;
                 }
                 case QContactDetail::TypePhoneNumber:
@@ -228,6 +244,18 @@ namespace
                     if (value == "URL") {
                         det.setValue(QContactAvatar::FieldImageUrl, QUrl(property.value()));
                     }
+                    QVariantMap thumbnails;
+                    QMultiHash<QString, QString> params = property.parameters();
+                    QMultiHash<QString, QString>::const_iterator i = params.constBegin();
+                    for(; i != params.constEnd(); i++) {
+                        if (i.key().startsWith(galera::VCardParser::ThumbnailParamName)) {
+                            thumbnails.insert(i.key().mid(galera::VCardParser::ThumbnailParamName.size()),
+                                              QUrl::fromLocalFile(i.value()).toString());
+                        }
+                    }
+                    if (!thumbnails.isEmpty()) {
+                        det.setValue(galera::VCardParser::AvatarThumbnailsField, thumbnails);
+                    }
                     break;
                 }
                 default:
@@ -270,12 +298,102 @@ namespace
 namespace galera
 {
 
+// private pool, this way the vcard parse does not compete with the filter threads
+Q_GLOBAL_STATIC(QThreadPool, vcardParserPool)
+
+class VCardImportState
+{
+public:
+    VCardImportState(VCardParser *parser, int generation, int chunks)
+        : parser(parser),
+          generation(generation),
+          pending(chunks),
+          canceled(false)
+    {
+        results.resize(chunks);
+    }
+
+    QMutex lock;
+    QWaitCondition done;
+    VCardParser *parser;
+    // identifies the import on the parser, a finish notification of a canceled import is ignored
+    int generation;
+    QVector<QList<QContact> > results;
+    int pending;
+    bool canceled;
+};
+
+class VCardImportChunk : public QRunnable
+{
+public:
+    VCardImportChunk(QSharedPointer<VCardImportState> state, int index, const QByteArray &data)
+        : m_state(state),
+          m_index(index),
+          m_data(data)
+    {
+        setAutoDelete(true);
+    }
+
+protected:
+    void run()
+    {
+        QList<QContact> contacts;
+        if (!isCanceled()) {
+            contacts = import();
+        }
+
+        QMutexLocker locker(&m_state->lock);
+        m_state->results[m_index] = contacts;
+        m_state->pending--;
+        if (m_state->pending == 0) {
+            m_state->done.wakeAll();
+            if (m_state->parser) {
+                QMetaObject::invokeMethod(m_state->parser, "onImportFinished", Qt::QueuedConnection,
+                                          Q_ARG(int, m_state->generation));
+            }
+        }
+    }
+
+private:
+    QSharedPointer<VCardImportState> m_state;
+    int m_index;
+    QByteArray m_data;
+
+    bool isCanceled() const
+    {
+        QMutexLocker locker(&m_state->lock);
+        return m_state->canceled;
+    }
+
+    QList<QContact> import()
+    {
+        QVersitReader reader(m_data);
+        reader.startReading();
+        reader.waitForFinished();
+        if (isCanceled()) {
+            return QList<QContact>();
+        }
+
+        // the property handler keeps state between properties, it can not be shared between threads
+        ContactImporterPropertyHandler propertyHandler;
+        QVersitContactImporter contactImporter;
+        contactImporter.setPropertyHandler(&propertyHandler);
+        if (!contactImporter.importDocuments(reader.results())) {
+            qWarning() << "Fail to import contacts";
+            return QList<QContact>();
+        }
+        return contactImporter.contacts();
+    }
+};
+
 const QString VCardParser::PidMapFieldName = QStringLiteral("CLIENTPIDMAP");
 const QString VCardParser::PidFieldName = QStringLiteral("PID");
 const QString VCardParser::PrefParamName = QStringLiteral("PREF");
 const QString VCardParser::IrremovableFieldName = QStringLiteral("IRREMOVABLE");
 const QString VCardParser::ReadOnlyFieldName = QStringLiteral("READ-ONLY");
 const QString VCardParser::TagFieldName = QStringLiteral("TAG");
+const QString VCardParser::ThumbnailParamName = QStringLiteral("X-THUMBNAIL-");
+const int VCardParser::AvatarThumbnailsField = QContactAvatar::FieldMetaData + 1;
 
 static QMap<QtContacts::QContactDetail::DetailType, QString> prefferedActions()
 {
@@ -296,10 +414,9 @@ const QMap<QtContacts::QContactDetail::DetailType, QString> VCardParser::Preferr
 VCardParser::VCardParser(QObject *parent)
     : QObject(parent),
       m_versitWriter(0),
-      m_versitReader(0)
+      m_importGeneration(0)
 {
     m_exporterHandler = new ContactExporterDetailHandler;
-    m_importerHandler = new ContactImporterPropertyHandler;
 }
 
 VCardParser::~VCardParser()
@@ -307,7 +424,6 @@ VCardParser::~VCardParser()
     waitForFinished();
 
     delete m_exporterHandler;
-    delete m_importerHandler;
  }
 
 QList<QContact> VCardParser::vcardToContactSync(const QStringList &vcardList)
@@ -326,31 +442,35 @@ QtContacts::QContact VCardParser::vcardToContact(const QString &vcard)
 
 void VCardParser::vcardToContact(const QStringList &vcardList)
 {
-    if (m_versitReader) {
+    if (m_importState) {
         qWarning() << "Import operation in progress.";
         return;
     }
     m_vcardsResult.clear();
     m_contactsResult.clear();
 
-    QString vcards = vcardList.join("\r\n");
-    m_versitReader = new QVersitReader(vcards.toUtf8());
-    connect(m_versitReader,
-            SIGNAL(resultsAvailable()),
-            SLOT(onReaderResultsAvailable()));
-    connect(m_versitReader,
-            SIGNAL(stateChanged(QVersitReader::State)),
-            SLOT(onReaderStateChanged(QVersitReader::State)));
-    m_versitReader->startReading();
+    // split the vcards in chunks and parse them in parallel
+    QStringList vcards = splitVcards(vcardList.join("\r\n").toUtf8());
+    int maxChunks = qMax(1, vcardParserPool()->maxThreadCount());
+    int chunks = qBound(1, vcards.size() / VCARD_PARSER_MIN_CHUNK_SIZE, maxChunks);
+    int chunkSize = (vcards.size() + chunks - 1) / chunks;
+
+    m_importState = QSharedPointer<VCardImportState>(new VCardImportState(this, ++m_importGeneration, chunks));
+    for(int i = 0; i < chunks; i++) {
+        QString chunk = QStringList(vcards.mid(i * chunkSize, chunkSize)).join(QString());
+        vcardParserPool()->start(new VCardImportChunk(m_importState, i, chunk.toUtf8()));
+    }
 }
 
 void VCardParser::cancel()
 {
-    if (m_versitReader) {
-        m_versitReader->disconnect(this);
-        m_versitReader->cancel();
-        m_versitReader->deleteLater();
-        m_versitReader = 0;
+    if (m_importState) {
+        // running chunks will finish in background and the result will be discarded
+        m_importState->lock.lock();
+        m_importState->canceled = true;
+        m_importState->parser = 0;
+        m_importState->lock.unlock();
+        m_importState.clear();
     }
 
     if (m_versitWriter) {
@@ -365,8 +485,11 @@ void VCardParser::cancel()
 
 void VCardParser::waitForFinished()
 {
-    if (m_versitReader) {
-        m_versitReader->waitForFinished();
+    if (m_importState) {
+        QMutexLocker locker(&m_importState->lock);
+        while (m_importState->pending > 0) {
+            m_importState->done.wait(&m_importState->lock);
+        }
     }
     if (m_versitWriter) {
         m_versitWriter->waitForFinished();
@@ -386,11 +509,6 @@ QList<QContact> VCardParser::contactsResult() const
     return m_contactsResult;
 }
 
-void VCardParser::onReaderResultsAvailable()
-{
-    //NOTHING FOR NOW
-}
-
 QStringList VCardParser::splitVcards(const QByteArray &vcardList)
 {
     QStringList result;
@@ -410,23 +528,28 @@ QStringList VCardParser::splitVcards(const QByteArray &vcardList)
     return result;
 }
 
-void VCardParser::onReaderStateChanged(QVersitReader::State state)
+void VCardParser::onImportFinished(int generation)
 {
-    if (m_versitReader && (state == QVersitReader::FinishedState)) {
-        QList<QVersitDocument> documents = m_versitReader->results();
-
-        QVersitContactImporter contactImporter;
-        contactImporter.setPropertyHandler(m_importerHandler);
-        if (!contactImporter.importDocuments(documents)) {
-            qWarning() << "Fail to import contacts";
-            return;
-        }
-        m_contactsResult = contactImporter.contacts();
-        Q_EMIT contactsParsed(contactImporter.contacts());
+    // the notification can arrive after the import was canceled and a new one started
+    if (!m_importState || (m_importState->generation != generation)) {
+        return;
+    }
 
-        delete m_versitReader;
-        m_versitReader = 0;
+    // chunks results are stored in the same order of the vcards
+    QList<QContact> contacts;
+    m_importState->lock.lock();
+    if (m_importState->pending != 0) {
+        m_importState->lock.unlock();
+        return;
     }
+    Q_FOREACH(const QList<QContact> &chunk, m_importState->results) {
+        contacts += chunk;
+    }
+    m_importState->lock.unlock();
+    m_importState.clear();
+
+    m_contactsResult = contacts;
+    Q_EMIT contactsParsed(contacts);
 }
 
 void VCardParser::contactToVcard(QList<QtContacts::QContact> contacts)
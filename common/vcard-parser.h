@@ -22,6 +22,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QStringList>
 #include <QtCore/QList>
+#include <QtCore/QSharedPointer>
 
 #include <QtContacts/QtContacts>
 
@@ -36,6 +37,8 @@ namespace galera
 
 using namespace QtVersit;
 
+class VCardImportState;
+
 class VCardParser : public QObject
 {
     Q_OBJECT
@@ -57,6 +60,9 @@ public:
     static const QString IrremovableFieldName;
     static const QString ReadOnlyFieldName;
     static const QString TagFieldName;
+    static const QString ThumbnailParamName;
+    // QContactAvatar field with the urls of the avatar thumbnails keyed by size
+    static const int AvatarThumbnailsField;
     static const QMap<QtContacts::QContactDetail::DetailType, QString> PreferredActionNames;
 
     static QtContacts::QContact vcardToContact(const QString &vcard);
@@ -74,14 +80,13 @@ Q_SIGNALS:
 
 private Q_SLOTS:
     void onWriterStateChanged(QVersitWriter::State state);
-    void onReaderStateChanged(QVersitReader::State state);
-    void onReaderResultsAvailable();
+    void onImportFinished(int generation);
 
 private:
     QtVersit::QVersitWriter *m_versitWriter;
-    QtVersit::QVersitReader *m_versitReader;
     QtVersit::QVersitContactExporterDetailHandlerV2 *m_exporterHandler;
-    QtVersit::QVersitContactImporterPropertyHandlerV2 *m_importerHandler;
+    QSharedPointer<VCardImportState> m_importState;
+    int m_importGeneration;
 
     QByteArray m_vcardData;
     QStringList m_vcardsResult;
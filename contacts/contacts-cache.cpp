@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contacts-cache.h"
+
+#include <QtContacts/QContactGuid>
+
+using namespace QtContacts;
+
+namespace galera
+{
+
+ContactsCache::ContactsCache(int maxSize)
+    : m_contacts(maxSize),
+      m_generation(0)
+{
+}
+
+bool ContactsCache::isEnabled() const
+{
+    return (m_contacts.maxCost() > 0);
+}
+
+// any invalidation changes the generation, results of fetches started before that can not be stored
+qint64 ContactsCache::generation() const
+{
+    return m_generation;
+}
+
+void ContactsCache::insert(const QList<QContact> &contacts, const QStringList &fields, qint64 generation)
+{
+    if (!isEnabled() || (generation != m_generation)) {
+        return;
+    }
+
+    const QString fieldsKey = fields.join(",");
+    Q_FOREACH(const QContact &contact, contacts) {
+        QString id = contact.detail<QContactGuid>().guid();
+        if (id.isEmpty()) {
+            continue;
+        }
+        QString key = cacheKey(id, fieldsKey);
+        m_contacts.insert(key, new QContact(contact));
+        if (!m_keysById.contains(id, key)) {
+            m_keysById.insert(id, key);
+        }
+    }
+
+    // remove the keys evicted from the cache
+    if (m_keysById.size() > (m_contacts.maxCost() * 2)) {
+        QMultiHash<QString, QString>::iterator i = m_keysById.begin();
+        while (i != m_keysById.end()) {
+            if (m_contacts.contains(i.value())) {
+                i++;
+            } else {
+                i = m_keysById.erase(i);
+            }
+        }
+    }
+}
+
+bool ContactsCache::values(const QList<QContactId> &ids,
+                           const QStringList &fields,
+                           QList<QContact> *contacts)
+{
+    if (!isEnabled() || ids.isEmpty()) {
+        return false;
+    }
+
+    const QString fieldsKey = fields.join(",");
+    QList<QContact> result;
+    Q_FOREACH(const QContactId &contactId, ids) {
+        QString id = ContactsCache::contactId(contactId);
+        QContact *contact = m_contacts.object(cacheKey(id, fieldsKey));
+        if (!contact && !fieldsKey.isEmpty()) {
+            // a contact with all fields can be used for any request
+            contact = m_contacts.object(cacheKey(id, QString()));
+        }
+        if (!contact) {
+            return false;
+        }
+        result << *contact;
+    }
+
+    *contacts = result;
+    return true;
+}
+
+void ContactsCache::remove(const QStringList &ids)
+{
+    m_generation++;
+    Q_FOREACH(const QString &id, ids) {
+        Q_FOREACH(const QString &key, m_keysById.values(id)) {
+            m_contacts.remove(key);
+        }
+        m_keysById.remove(id);
+    }
+}
+
+void ContactsCache::remove(const QList<QContactId> &ids)
+{
+    QStringList strIds;
+    Q_FOREACH(const QContactId &id, ids) {
+        strIds << contactId(id);
+    }
+    remove(strIds);
+}
+
+void ContactsCache::clear()
+{
+    m_generation++;
+    m_contacts.clear();
+    m_keysById.clear();
+}
+
+QString ContactsCache::contactId(const QContactId &id)
+{
+    return QString::fromUtf8(id.localId());
+}
+
+QString ContactsCache::cacheKey(const QString &id, const QString &fields)
+{
+    return id + QStringLiteral("|") + fields;
+}
+
+} //namespace
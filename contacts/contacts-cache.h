@@ -0,0 +1,62 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_CONTACTS_CACHE_H__
+#define __GALERA_CONTACTS_CACHE_H__
+
+#include <QtCore/QCache>
+#include <QtCore/QMultiHash>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <QtContacts/QContact>
+#include <QtContacts/QContactId>
+
+namespace galera
+{
+
+// Keep the last contacts fetched by id, the contacts are stored based on the contact id and the fields
+// requested. A contact fetched with all fields can be used to answer any request.
+class ContactsCache
+{
+public:
+    ContactsCache(int maxSize);
+
+    bool isEnabled() const;
+    qint64 generation() const;
+    void insert(const QList<QtContacts::QContact> &contacts, const QStringList &fields, qint64 generation);
+    bool values(const QList<QtContacts::QContactId> &ids,
+                const QStringList &fields,
+                QList<QtContacts::QContact> *contacts);
+    void remove(const QStringList &ids);
+    void remove(const QList<QtContacts::QContactId> &ids);
+    void clear();
+
+    static QString contactId(const QtContacts::QContactId &id);
+
+private:
+    QCache<QString, QtContacts::QContact> m_contacts;
+    QMultiHash<QString, QString> m_keysById;
+    qint64 m_generation;
+
+    static QString cacheKey(const QString &id, const QString &fields);
+};
+
+}
+
+#endif
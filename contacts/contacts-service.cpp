@@ -21,6 +21,7 @@
 #include "qcontactrequest-data.h"
 #include "qcontactfetchrequest-data.h"
 #include "qcontactfetchbyidrequest-data.h"
+#include "qcontactidfetchrequest-data.h"
 #include "qcontactremoverequest-data.h"
 #include "qcontactsaverequest-data.h"
 
@@ -53,6 +54,22 @@
 
 #define ALTERNATIVE_CPIM_SERVICE_PAGE_SIZE  "CANONICAL_PIM_SERVICE_PAGE_SIZE"
 #define FETCH_PAGE_SIZE                     25
+// number of page requests sent before receive the previous ones
+#define FETCH_PAGES_IN_FLIGHT               2
+#define ALTERNATIVE_CPIM_SERVICE_CACHE_SIZE "CANONICAL_PIM_SERVICE_CACHE_SIZE"
+#define CONTACTS_CACHE_SIZE                 200
+// max number of ids in a id filter that can be answered by the cache
+#define CONTACTS_CACHE_MAX_FILTER_IDS       20
+
+namespace {
+int contactsCacheSize()
+{
+    if (qEnvironmentVariableIsSet(ALTERNATIVE_CPIM_SERVICE_CACHE_SIZE)) {
+        return qgetenv(ALTERNATIVE_CPIM_SERVICE_CACHE_SIZE).toInt();
+    }
+    return CONTACTS_CACHE_SIZE;
+}
+}
 
 using namespace QtVersit;
 using namespace QtContacts;
@@ -62,7 +79,10 @@ namespace galera
 GaleraContactsService::GaleraContactsService(const QString &managerUri)
     : m_managerUri(managerUri),
       m_serviceIsReady(false),
-      m_iface(0)
+      m_streamingFetch(false),
+      m_changesListenerRegistered(false),
+      m_iface(0),
+      m_cache(contactsCacheSize())
 {
     Source::registerMetaType();
 
@@ -72,10 +92,13 @@ GaleraContactsService::GaleraContactsService(const QString &managerUri)
         m_serviceName = CPIM_SERVICE_NAME;
     }
 
+    // the page size will change based on the fetch speed unless a fixed size was requested
     if (qEnvironmentVariableIsSet(ALTERNATIVE_CPIM_SERVICE_PAGE_SIZE)) {
         m_pageSize = qgetenv(ALTERNATIVE_CPIM_SERVICE_PAGE_SIZE).toInt();
+        m_adaptivePageSize = false;
     } else {
         m_pageSize = FETCH_PAGE_SIZE;
+        m_adaptivePageSize = true;
     }
 
     m_serviceWatcher = new QDBusServiceWatcher(m_serviceName,
@@ -90,7 +113,9 @@ GaleraContactsService::GaleraContactsService(const QString &managerUri)
 
 GaleraContactsService::GaleraContactsService(const GaleraContactsService &other)
     : m_managerUri(other.m_managerUri),
-      m_iface(other.m_iface)
+      m_streamingFetch(other.m_streamingFetch),
+      m_iface(other.m_iface),
+      m_cache(contactsCacheSize())
 {
 }
 
@@ -113,6 +138,8 @@ void GaleraContactsService::serviceOwnerChanged(const QString &name, const QStri
             // service appear
             qDebug() << "Service appeared";
             initialize();
+            // the new service instance does not know about the listener
+            registerChangesListener();
         } else if (!m_iface.isNull()) {
             // lost service
             qDebug() << "Service disappeared";
@@ -143,6 +170,9 @@ void GaleraContactsService::initialize()
             connect(m_iface.data(), SIGNAL(contactsAdded(QStringList)), this, SLOT(onContactsAdded(QStringList)));
             connect(m_iface.data(), SIGNAL(contactsRemoved(QStringList)), this, SLOT(onContactsRemoved(QStringList)));
             connect(m_iface.data(), SIGNAL(contactsUpdated(QStringList)), this, SLOT(onContactsUpdated(QStringList)));
+            connect(m_iface.data(), SIGNAL(contactsUpdatedDetailed(QStringList, QList<int>, QStringList)),
+                    this, SLOT(onContactsUpdatedDetailed(QStringList, QList<int>, QStringList)));
+            registerChangesListener();
             if (m_serviceIsReady) {
                 Q_EMIT serviceChanged();
             }
@@ -160,6 +190,11 @@ void GaleraContactsService::deinitialize()
         QCoreApplication::processEvents();
     }
 
+    // the listener registration does not survive to the service restart
+    m_changesListenerRegistered = false;
+    // we will not receive the change notifications while the service is away
+    m_cache.clear();
+
     // this will make the service re-initialize
     m_iface->call("ping");
 
@@ -179,6 +214,24 @@ bool GaleraContactsService::isOnline() const
     return !m_iface.isNull() && m_serviceIsReady;
 }
 
+void GaleraContactsService::registerChangesListener()
+{
+    if (m_iface.isNull()) {
+        return;
+    }
+
+    // ask for the changed detail types, the contacts are not necessary
+    QDBusPendingCall pcall = m_iface->asyncCall("registerChangesListener", QStringList(), false);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pcall, this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     [=](QDBusPendingCallWatcher *call) {
+                        QDBusPendingReply<> reply = *call;
+                        // old services does not support it, keep using the simple signal
+                        m_changesListenerRegistered = !reply.isError();
+                        call->deleteLater();
+                     });
+}
+
 void GaleraContactsService::fetchCollections(QContactCollectionFetchRequest *request)
 {
     if (!isOnline()) {
@@ -241,6 +294,54 @@ void GaleraContactsService::fetchContactsById(QtContacts::QContactFetchByIdReque
         return;
     }
 
+    QList<QContact> contacts;
+    if (m_cache.values(request->contactIds(), QStringList(), &contacts)) {
+        QContactManagerEngine::updateContactFetchByIdRequest(request,
+                                                             contacts,
+                                                             QContactManager::NoError,
+                                                             QMap<int, QContactManager::Error>(),
+                                                             QContactAbstractRequest::FinishedState);
+        return;
+    }
+    qint64 cacheGeneration = m_cache.generation();
+
+    if (m_showInvisibleContacts) {
+        fetchContactsByIdQuery(request, cacheGeneration);
+        return;
+    }
+
+    // fetch all contacts with a single call, without create a view
+    QStringList ids;
+    Q_FOREACH(const QContactId &id, request->contactIds()) {
+        ids << QString::fromUtf8(id.localId());
+    }
+
+    QContactFetchByIdRequestData *data = new QContactFetchByIdRequestData(request, 0);
+    QDBusPendingCall pcall = m_iface->asyncCall("contactsByIds", ids, data->fields());
+    if (pcall.isError()) {
+        qWarning() << pcall.error().name() << pcall.error().message();
+        QContactFetchByIdRequestData::notifyError(request);
+        delete data;
+        return;
+    }
+
+    data->setCacheGeneration(cacheGeneration);
+    data->setStreaming(m_streamingFetch);
+    data->reserveResults(ids.size());
+    m_runningRequests << data;
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pcall, 0);
+    data->appendPageRequest(0, ids.size(), watcher, true);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     [=](QDBusPendingCallWatcher *call) {
+                        this->fetchContactsDone(data, call, 0);
+                     });
+}
+
+void GaleraContactsService::fetchContactsByIdQuery(QtContacts::QContactFetchByIdRequest *request,
+                                                   qint64 cacheGeneration)
+{
+    // invisible contacts are not returned by "contactsByIds", a view is necessary
     QContactIdFilter filter;
     filter.setIds(request->contactIds());
     QString filterStr = Filter(filter).toString();
@@ -261,6 +362,10 @@ void GaleraContactsService::fetchContactsById(QtContacts::QContactFetchByIdReque
                                              CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
 
     QContactFetchByIdRequestData *data = new QContactFetchByIdRequestData(request, view);
+    data->setCacheGeneration(cacheGeneration);
+    data->setPageSize(m_pageSize, m_adaptivePageSize);
+    data->setStreaming(m_streamingFetch);
+    data->reserveResults(request->contactIds().size());
     m_runningRequests << data;
     fetchContactsPage(data);
 }
@@ -301,22 +406,39 @@ void GaleraContactsService::fetchContacts(QtContacts::QContactFetchRequest *requ
         }
     }
 
+    if (fetchContactsFromCache(request)) {
+        return;
+    }
+    qint64 cacheGeneration = m_cache.generation();
+
     QString sortStr = SortClause(request->sorting()).toString();
     QString filterStr = Filter(request->filter()).toString();
     FetchHint fetchHint = FetchHint(request->fetchHint()).toString();
-    QDBusPendingCall pcall = m_iface->asyncCall("query",
+    QContactFetchRequestData *data = new QContactFetchRequestData(request, 0, fetchHint);
+    data->setPageSize(m_pageSize, m_adaptivePageSize);
+    data->setStreaming(m_streamingFetch);
+
+    // create the view and receive the first page with a single call
+    QDBusPendingCall pcall = m_iface->asyncCall("queryFirstPage",
                                                 filterStr,
                                                 sortStr,
                                                 request->fetchHint().maxCountHint(),
                                                 m_showInvisibleContacts,
-                                                QStringList());
+                                                QStringList(),
+                                                data->fields(),
+                                                data->pageSize());
     if (pcall.isError()) {
         qWarning() << pcall.error().name() << pcall.error().message();
         QContactFetchRequestData::notifyError(request);
+        delete data;
         return;
     }
-
-    QContactFetchRequestData *data = new QContactFetchRequestData(request, 0, fetchHint);
+    data->appendPageRequest(0, data->pageSize(), 0);
+    // only small id queries are cached, they are used to resolve contacts
+    if ((request->filter().type() == QContactFilter::IdFilter) &&
+        (static_cast<QContactIdFilter>(request->filter()).ids().size() <= CONTACTS_CACHE_MAX_FILTER_IDS)) {
+        data->setCacheGeneration(cacheGeneration);
+    }
     m_runningRequests << data;
 
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pcall, 0);
@@ -328,6 +450,39 @@ void GaleraContactsService::fetchContacts(QtContacts::QContactFetchRequest *requ
 }
 
 
+bool GaleraContactsService::fetchContactsFromCache(QContactFetchRequest *request)
+{
+    if (request->filter().type() != QContactFilter::IdFilter) {
+        return false;
+    }
+
+    QList<QContactId> ids = static_cast<QContactIdFilter>(request->filter()).ids();
+    if (ids.size() > CONTACTS_CACHE_MAX_FILTER_IDS) {
+        return false;
+    }
+
+    QList<QContact> contacts;
+    if (!m_cache.values(ids, FetchHint(request->fetchHint()).fields(), &contacts)) {
+        return false;
+    }
+
+    QList<QContact> result;
+    Q_FOREACH(const QContact &contact, contacts) {
+        QContactManagerEngine::addSorted(&result, contact, request->sorting());
+    }
+
+    int maxCount = request->fetchHint().maxCountHint();
+    if ((maxCount > 0) && (result.size() > maxCount)) {
+        result = result.mid(0, maxCount);
+    }
+
+    QContactManagerEngine::updateContactFetchRequest(request,
+                                                     result,
+                                                     QContactManager::NoError,
+                                                     QContactAbstractRequest::FinishedState);
+    return true;
+}
+
 void GaleraContactsService::fetchContactsContinue(QContactFetchRequestData *data,
                                                   QDBusPendingCallWatcher *call)
 {
@@ -336,37 +491,42 @@ void GaleraContactsService::fetchContactsContinue(QContactFetchRequestData *data
         return;
     }
 
-    QDBusPendingReply<QDBusObjectPath> reply = *call;
+    QDBusPendingReply<QDBusObjectPath, QStringList> reply = *call;
 
     if (reply.isError()) {
         qWarning() << reply.error().name() << reply.error().message();
         destroyRequest(data);
     } else {
-        QDBusObjectPath viewObjectPath = reply.value();
+        QDBusObjectPath viewObjectPath = reply.argumentAt<0>();
         QDBusInterface *view = new QDBusInterface(m_serviceName,
                                                   viewObjectPath.path(),
                                                   CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
         data->updateView(view);
-        fetchContactsPage(data);
+
+        // the view size is only necessary if there are more pages to fetch
+        const QStringList vcards = reply.argumentAt<1>();
+        if (vcards.size() >= data->pageSize()) {
+            fetchContactsCount(data);
+        }
+        fetchContactsPageReceived(data, 0, vcards);
     }
 }
 
-void GaleraContactsService::fetchContactsPage(QContactFetchRequestData *data)
+void GaleraContactsService::fetchContactsCount(QContactFetchRequestData *data)
 {
-    if (!isOnline() || !data->isLive()) {
-        destroyRequest(data);
+    if (data->isStreaming()) {
         return;
     }
 
-    // Load contacs async
-    QDBusPendingCall pcall = data->view()->asyncCall("contactsDetails",
-                                                     data->fields(),
-                                                     data->offset(),
-                                                     m_pageSize);
+    // the view size is used to preallocate the request result
+    QDBusMessage msg = QDBusMessage::createMethodCall(m_serviceName,
+                                                      data->view()->path(),
+                                                      "org.freedesktop.DBus.Properties",
+                                                      "Get");
+    msg << QString(CPIM_ADDRESSBOOK_VIEW_IFACE_NAME) << QString("count");
+    QDBusPendingCall pcall = data->view()->connection().asyncCall(msg);
     if (pcall.isError()) {
         qWarning() << pcall.error().name() << pcall.error().message();
-        data->finish(QContactManager::UnspecifiedError);
-        destroyRequest(data);
         return;
     }
 
@@ -374,12 +534,56 @@ void GaleraContactsService::fetchContactsPage(QContactFetchRequestData *data)
     data->updateWatcher(watcher);
     QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
                      [=](QDBusPendingCallWatcher *call) {
-                        this->fetchContactsDone(data, call);
+                        this->fetchContactsCountDone(data, call);
                      });
 }
 
+void GaleraContactsService::fetchContactsCountDone(QContactFetchRequestData *data,
+                                                   QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QDBusVariant> reply = *call;
+    if (reply.isError()) {
+        qWarning() << reply.error().name() << reply.error().message();
+    } else if (data->isLive()) {
+        data->reserveResults(reply.value().variant().toInt());
+    }
+}
+
+void GaleraContactsService::fetchContactsPage(QContactFetchRequestData *data)
+{
+    if (!isOnline() || !data->isLive()) {
+        destroyRequest(data);
+        return;
+    }
+
+    // Load contacs async, keep more than one page request in flight this way the next page
+    // will be serialized and transfered while the current one is parsed
+    while (data->canRequestPage(FETCH_PAGES_IN_FLIGHT)) {
+        int offset = data->nextPageOffset();
+        int pageSize = data->pageSize();
+        QDBusPendingCall pcall = data->view()->asyncCall("contactsDetails",
+                                                         data->fields(),
+                                                         offset,
+                                                         pageSize);
+        if (pcall.isError()) {
+            qWarning() << pcall.error().name() << pcall.error().message();
+            data->finish(QContactManager::UnspecifiedError);
+            destroyRequest(data);
+            return;
+        }
+
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pcall, 0);
+        data->appendPageRequest(offset, pageSize, watcher);
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                         [=](QDBusPendingCallWatcher *call) {
+                            this->fetchContactsDone(data, call, offset);
+                         });
+    }
+}
+
 void GaleraContactsService::fetchContactsDone(QContactFetchRequestData *data,
-                                              QDBusPendingCallWatcher *call)
+                                              QDBusPendingCallWatcher *call,
+                                              int offset)
 {
     if (!data->isLive()) {
         destroyRequest(data);
@@ -393,33 +597,70 @@ void GaleraContactsService::fetchContactsDone(QContactFetchRequestData *data,
                         QContactAbstractRequest::FinishedState,
                         QContactManager::UnspecifiedError);
         destroyRequest(data);
-    } else {
-        const QStringList vcards = reply.value();
-        if (vcards.size()) {
-            VCardParser *parser = new VCardParser;
-            parser->setProperty("DATA", QVariant::fromValue<void*>(data));
-            data->setVCardParser(parser);
-            connect(parser,
-                    SIGNAL(contactsParsed(QList<QtContacts::QContact>)),
-                    SLOT(onVCardsParsed(QList<QtContacts::QContact>)));
-            connect(parser,
-                    SIGNAL(canceled()),
-                    SLOT(onVCardParseCanceled()));
-            parser->vcardToContact(vcards);
-        } else {
-            data->update(QList<QContact>(), QContactAbstractRequest::FinishedState);
-            destroyRequest(data);
-        }
+        return;
+    }
+
+    fetchContactsPageReceived(data, offset, reply.value());
+}
+
+void GaleraContactsService::fetchContactsPageReceived(QContactFetchRequestData *data,
+                                                      int offset,
+                                                      const QStringList &vcards)
+{
+    bool parse = data->pageReceived(offset, vcards.size());
+    learnPageSize(data);
+
+    if (parse) {
+        VCardParser *parser = new VCardParser;
+        parser->setProperty("DATA", QVariant::fromValue<void*>(data));
+        parser->setProperty("OFFSET", offset);
+        data->appendVCardParser(parser);
+        connect(parser,
+                SIGNAL(contactsParsed(QList<QtContacts::QContact>)),
+                SLOT(onVCardsParsed(QList<QtContacts::QContact>)));
+        connect(parser,
+                SIGNAL(canceled()),
+                SLOT(onVCardParseCanceled()));
+        parser->vcardToContact(vcards);
+    } else if (deliverContactsPages(data)) {
+        return;
+    }
+
+    // request the next page while this one is parsed
+    fetchContactsPage(data);
+}
+
+void GaleraContactsService::learnPageSize(QContactFetchRequestData *data)
+{
+    // the next requests start with the page size learned by this one, the requests without
+    // a view (Eg. "contactsByIds") are a single page sized by the number of ids
+    if (m_adaptivePageSize && data->view()) {
+        m_pageSize = data->pageSize();
     }
 }
 
+bool GaleraContactsService::deliverContactsPages(QContactFetchRequestData *data)
+{
+    QList<QContact> contacts = data->takeParsedPages();
+    if (data->allPagesDelivered()) {
+        data->update(contacts, QContactAbstractRequest::FinishedState);
+        destroyRequest(data);
+        return true;
+    }
+
+    if (!contacts.isEmpty()) {
+        data->update(contacts, QContactAbstractRequest::ActiveState);
+    }
+    return false;
+}
+
 void GaleraContactsService::onVCardParseCanceled()
 {
     QObject *sender = QObject::sender();
     disconnect(sender);
 
     QContactFetchRequestData *data = static_cast<QContactFetchRequestData*>(sender->property("DATA").value<void*>());
-    data->clearVCardParser();
+    data->removeVCardParser(static_cast<VCardParser*>(sender));
 
     if (!data->isLive()) {
         sender->deleteLater();
@@ -436,10 +677,11 @@ void GaleraContactsService::onVCardsParsed(QList<QContact> contacts)
     disconnect(sender);
 
     QContactFetchRequestData *data = static_cast<QContactFetchRequestData*>(sender->property("DATA").value<void*>());
-    data->clearVCardParser();
+    int offset = sender->property("OFFSET").toInt();
+    data->removeVCardParser(static_cast<VCardParser*>(sender));
+    sender->deleteLater();
 
     if (!data->isLive()) {
-        sender->deleteLater();
         destroyRequest(data);
         return;
     }
@@ -453,17 +695,69 @@ void GaleraContactsService::onVCardsParsed(QList<QContact> contacts)
         }
     }
 
-    if (contacts.size() == m_pageSize) {
-        data->update(contacts, QContactAbstractRequest::ActiveState);
-        data->updateOffset(m_pageSize);
-        data->updateWatcher(0);
+    if (data->cacheGeneration() >= 0) {
+        m_cache.insert(contacts, data->fields(), data->cacheGeneration());
+    }
+
+    data->pageParsed(offset, contacts);
+    learnPageSize(data);
+    if (!deliverContactsPages(data)) {
         fetchContactsPage(data);
-    } else {
-        data->update(contacts, QContactAbstractRequest::FinishedState);
+    }
+}
+
+void GaleraContactsService::fetchContactIds(QContactIdFetchRequest *request)
+{
+    if (!isOnline()) {
+        qWarning() << "Server is not online";
+        QContactIdFetchRequestData::notifyError(request);
+        return;
+    }
+
+    // only the ids are returned, the contacts are not serialized
+    QString sortStr = SortClause(request->sorting()).toString();
+    QString filterStr = Filter(request->filter()).toString();
+    QDBusPendingCall pcall = m_iface->asyncCall("queryIds",
+                                                filterStr,
+                                                sortStr,
+                                                -1,
+                                                m_showInvisibleContacts,
+                                                QStringList());
+    if (pcall.isError()) {
+        qWarning() << pcall.error().name() << pcall.error().message();
+        QContactIdFetchRequestData::notifyError(request);
+        return;
+    }
+
+    QContactIdFetchRequestData *data = new QContactIdFetchRequestData(request);
+    m_runningRequests << data;
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pcall, 0);
+    data->updateWatcher(watcher);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     [=](QDBusPendingCallWatcher *call) {
+                        this->fetchContactIdsDone(data, call);
+                     });
+}
+
+void GaleraContactsService::fetchContactIdsDone(QContactIdFetchRequestData *data,
+                                                QDBusPendingCallWatcher *call)
+{
+    if (!data->isLive()) {
         destroyRequest(data);
+        return;
     }
 
-    sender->deleteLater();
+    QDBusPendingReply<QStringList> reply = *call;
+    if (reply.isError()) {
+        qWarning() << reply.error().name() << reply.error().message();
+        data->update(QList<QContactId>(),
+                     QContactAbstractRequest::FinishedState,
+                     QContactManager::UnspecifiedError);
+    } else {
+        data->update(parseIds(reply.value()), QContactAbstractRequest::FinishedState);
+    }
+    destroyRequest(data);
 }
 
 void GaleraContactsService::fetchContactsGroupsContinue(QContactFetchRequestData *data,
@@ -520,6 +814,17 @@ void GaleraContactsService::fetchContactsGroupsContinue(QContactFetchRequestData
  */
 void GaleraContactsService::saveContact(QtContacts::QContactSaveRequest *request)
 {
+    // do not wait for the update signal to drop the old contact data
+    QList<QContactId> ids;
+    Q_FOREACH(const QContact &contact, request->contacts()) {
+        if (!contact.id().isNull()) {
+            ids << contact.id();
+        }
+    }
+    if (!ids.isEmpty()) {
+        m_cache.remove(ids);
+    }
+
     QContactSaveRequestData *data = new QContactSaveRequestData(request);
     m_runningRequests << data;
 
@@ -782,6 +1087,8 @@ void GaleraContactsService::removeContact(QContactRemoveRequest *request)
         return;
     }
 
+    m_cache.remove(request->contactIds());
+
     QContactRemoveRequestData *data = new QContactRemoveRequestData(request);
     m_runningRequests << data;
 
@@ -917,6 +1224,11 @@ void GaleraContactsService::setShowInvisibleContacts(bool show)
     m_showInvisibleContacts = show;
 }
 
+void GaleraContactsService::setStreamingFetch(bool streaming)
+{
+    m_streamingFetch = streaming;
+}
+
 void GaleraContactsService::addRequest(QtContacts::QContactAbstractRequest *request)
 {
     if (!isOnline()) {
@@ -937,7 +1249,7 @@ void GaleraContactsService::addRequest(QtContacts::QContactAbstractRequest *requ
             fetchContactsById(static_cast<QContactFetchByIdRequest*>(request));
             break;
         case QContactAbstractRequest::ContactIdFetchRequest:
-            qDebug() << "Not implemented: ContactIdFetchRequest";
+            fetchContactIds(static_cast<QContactIdFetchRequest*>(request));
             break;
         case QContactAbstractRequest::ContactSaveRequest:
             saveContact(static_cast<QContactSaveRequest*>(request));
@@ -985,12 +1297,34 @@ void GaleraContactsService::onContactsAdded(const QStringList &ids)
 
 void GaleraContactsService::onContactsRemoved(const QStringList &ids)
 {
+    m_cache.remove(ids);
     Q_EMIT contactsRemoved(parseIds(ids));
 }
 
 void GaleraContactsService::onContactsUpdated(const QStringList &ids)
 {
+    m_cache.remove(ids);
+
+    // the detailed signal will be used instead
+    if (m_changesListenerRegistered) {
+        return;
+    }
     Q_EMIT contactsUpdated(parseIds(ids), {});
 }
 
+void GaleraContactsService::onContactsUpdatedDetailed(const QStringList &ids,
+                                                      const QList<int> &types,
+                                                      const QStringList &vcards)
+{
+    Q_UNUSED(vcards);
+
+    m_cache.remove(ids);
+
+    QList<QContactDetail::DetailType> typesChanged;
+    Q_FOREACH(int type, types) {
+        typesChanged << static_cast<QContactDetail::DetailType>(type);
+    }
+    Q_EMIT contactsUpdated(parseIds(ids), typesChanged);
+}
+
 } //namespace
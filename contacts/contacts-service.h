@@ -38,6 +38,8 @@
 #include <QtDBus/QDBusPendingCallWatcher>
 #include <QtDBus/QDBusServiceWatcher>
 
+#include "contacts-cache.h"
+
 class QDBusInterface;
 using namespace QtContacts; // necessary for signal signatures
 
@@ -47,6 +49,7 @@ class QContactCollectionFetchRequestData;
 class QContactRequestData;
 class QContactSaveRequestData;
 class QContactFetchRequestData;
+class QContactIdFetchRequestData;
 class QContactRemoveRequestData;
 
 class GaleraContactsService : public QObject
@@ -68,6 +71,7 @@ public:
     void waitRequest(QtContacts::QContactAbstractRequest *request);
     void releaseRequest(QtContacts::QContactAbstractRequest *request);
     void setShowInvisibleContacts(bool show);
+    void setStreamingFetch(bool streaming);
 
 Q_SIGNALS:
     void contactsAdded(QList<QContactId> ids);
@@ -80,6 +84,7 @@ private Q_SLOTS:
     void onContactsAdded(const QStringList &ids);
     void onContactsRemoved(const QStringList &ids);
     void onContactsUpdated(const QStringList &ids);
+    void onContactsUpdatedDetailed(const QStringList &ids, const QList<int> &types, const QStringList &vcards);
     void serviceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner);
     void onServiceReady();
     void onVCardsParsed(QList<QtContacts::QContact> contacts);
@@ -89,16 +94,21 @@ private:
     QDBusServiceWatcher *m_serviceWatcher;
     bool m_serviceIsReady;
     int m_pageSize;
+    bool m_adaptivePageSize;
     bool m_showInvisibleContacts;
+    bool m_streamingFetch;
+    bool m_changesListenerRegistered;
 
     QSharedPointer<QDBusInterface> m_iface;
     QString m_serviceName;
     QList<QContactRequestData*> m_runningRequests;
+    ContactsCache m_cache;
 
     Q_INVOKABLE void initialize();
     Q_INVOKABLE void deinitialize();
 
     bool isOnline() const;
+    void registerChangesListener();
 
     void fetchCollections(QtContacts::QContactCollectionFetchRequest *request);
     void fetchCollectionsContinue(QContactCollectionFetchRequestData *data,
@@ -106,11 +116,21 @@ private:
     void fetchContacts(QtContacts::QContactFetchRequest *request);
     void fetchContactsContinue(QContactFetchRequestData *data,
                                QDBusPendingCallWatcher *call);
+    void fetchContactsCount(QContactFetchRequestData *data);
+    void fetchContactsCountDone(QContactFetchRequestData *data,
+                                QDBusPendingCallWatcher *call);
     void fetchContactsGroupsContinue(QContactFetchRequestData *request,
                                      QDBusPendingCallWatcher *call);
     void fetchContactsById(QtContacts::QContactFetchByIdRequest *request);
+    void fetchContactsByIdQuery(QtContacts::QContactFetchByIdRequest *request, qint64 cacheGeneration);
+    void fetchContactIds(QtContacts::QContactIdFetchRequest *request);
+    void fetchContactIdsDone(QContactIdFetchRequestData *data, QDBusPendingCallWatcher *call);
+    bool fetchContactsFromCache(QtContacts::QContactFetchRequest *request);
     void fetchContactsPage(QContactFetchRequestData *data);
-    void fetchContactsDone(QContactFetchRequestData *data, QDBusPendingCallWatcher *call);
+    void fetchContactsDone(QContactFetchRequestData *data, QDBusPendingCallWatcher *call, int offset);
+    void fetchContactsPageReceived(QContactFetchRequestData *data, int offset, const QStringList &vcards);
+    bool deliverContactsPages(QContactFetchRequestData *data);
+    void learnPageSize(QContactFetchRequestData *data);
 
     void saveContact(QtContacts::QContactSaveRequest *request);
     void createGroupsStart(QContactSaveRequestData *data);
@@ -24,6 +24,7 @@
 #include <QContactChangeSet>
 #include <QContactTimestamp>
 #include <QContactIdFilter>
+#include <QContactIdFetchRequest>
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qstringbuilder.h>
@@ -58,6 +59,7 @@ GaleraManagerEngine* GaleraManagerEngine::createEngine(const QMap<QString, QStri
 {
     GaleraManagerEngine *engine = new GaleraManagerEngine();
     engine->m_service->setShowInvisibleContacts(parameters.value(ADDRESS_BOOK_SHOW_INVISIBLE_PROP, "false").toLower() == "true");
+    engine->m_service->setStreamingFetch(parameters.value(ADDRESS_BOOK_STREAMING_FETCH_PROP, "false").toLower() == "true");
     return engine;
 }
 
@@ -100,16 +102,18 @@ int GaleraManagerEngine::managerVersion() const
 /* Filtering */
 QList<QContactId> GaleraManagerEngine::contactIds(const QtContacts::QContactFilter &filter, const QList<QtContacts::QContactSortOrder> &sortOrders, QtContacts::QContactManager::Error *error) const
 {
-    QContactFetchHint hint;
-    hint.setDetailTypesHint(QList<QContactDetail::DetailType>() << QContactDetail::TypeGuid);
-    QList<QtContacts::QContact> clist = contacts(filter, sortOrders, hint, error);
+    QContactIdFetchRequest request;
+    request.setFilter(filter);
+    request.setSorting(sortOrders);
+
+    const_cast<GaleraManagerEngine*>(this)->startRequest(&request);
+    const_cast<GaleraManagerEngine*>(this)->waitForRequestFinished(&request, -1);
 
-    /* Extract the ids */
-    QList<QtContacts::QContactId> ids;
-    Q_FOREACH(const QContact &c, clist)
-        ids.append(c.id());
+    if (error) {
+        *error = request.error();
+    }
 
-    return ids;
+    return request.ids();
 }
 
 QList<QtContacts::QContact> GaleraManagerEngine::contacts(const QtContacts::QContactFilter &filter,
@@ -20,8 +20,15 @@
 #include "common/vcard-parser.h"
 
 #include <QtCore/QDebug>
+#include <QtDBus/QDBusPendingCallWatcher>
 #include <QtContacts/QContactManagerEngine>
 
+// min and max number of contacts in a single page
+#define FETCH_MIN_PAGE_SIZE     25
+#define FETCH_MAX_PAGE_SIZE     500
+// time that each step of the page fetch (server serialization/transport or client parse) should take
+#define FETCH_PAGE_TARGET_TIME  50
+
 using namespace QtContacts;
 namespace galera
 {
@@ -30,40 +37,152 @@ QContactFetchRequestData::QContactFetchRequestData(QContactAbstractRequest *requ
                                                    QDBusInterface *view,
                                                    const FetchHint &hint)
     : QContactRequestData(request),
-      m_runningParser(0),
       m_view(0),
+      m_pageSize(FETCH_MIN_PAGE_SIZE),
+      m_adaptivePageSize(true),
+      m_nextOffset(0),
       m_offset(0),
+      m_endOffset(-1),
+      m_lastPageOffset(-1),
+      m_lastPageReceivedAt(0),
+      m_lastPageParsedAt(0),
+      m_cacheGeneration(-1),
+      m_streaming(false),
       m_hint(hint)
 {
     if (view) {
         updateView(view);
     }
+    m_clock.start();
 }
 
 QContactFetchRequestData::~QContactFetchRequestData()
 {
-    delete m_runningParser;
-    m_runningParser = 0;
+    m_pageRequests.clear();
+    qDeleteAll(m_runningParsers);
+    m_runningParsers.clear();
 }
 
-int QContactFetchRequestData::offset() const
+QDBusInterface* QContactFetchRequestData::view() const
 {
-    return m_offset;
+    return m_view.data();
 }
 
-QDBusInterface* QContactFetchRequestData::view() const
+void QContactFetchRequestData::appendVCardParser(VCardParser *parser)
 {
-    return m_view.data();
+    m_runningParsers << parser;
+}
+
+void QContactFetchRequestData::removeVCardParser(VCardParser *parser)
+{
+    m_runningParsers.removeOne(parser);
+}
+
+void QContactFetchRequestData::setPageSize(int pageSize, bool adaptive)
+{
+    m_pageSize = pageSize;
+    m_adaptivePageSize = adaptive;
+}
+
+int QContactFetchRequestData::pageSize() const
+{
+    return m_pageSize;
+}
+
+int QContactFetchRequestData::nextPageOffset() const
+{
+    return m_nextOffset;
+}
+
+bool QContactFetchRequestData::canRequestPage(int maxPagesInFlight) const
+{
+    // the end of the view is already known
+    if ((m_endOffset >= 0) || (m_lastPageOffset >= 0)) {
+        return false;
+    }
+
+    // limit the number of pages in memory waiting to be parsed and delivered
+    int pagesInFlight = m_pageRequests.size() + m_runningParsers.size() + m_parsedPages.size();
+    return (m_pageRequests.size() < maxPagesInFlight) && (pagesInFlight <= maxPagesInFlight);
+}
+
+void QContactFetchRequestData::appendPageRequest(int offset, int pageSize, QDBusPendingCallWatcher *watcher, bool lastPage)
+{
+    if (lastPage) {
+        m_lastPageOffset = offset;
+    }
+    m_pageRequests.insert(offset, QSharedPointer<QDBusPendingCallWatcher>(watcher, QContactFetchRequestData::deletePageWatcher));
+    m_pageSizes.insert(offset, pageSize);
+    m_pageRequestedAt.insert(offset, m_clock.elapsed());
+    m_nextOffset = offset + pageSize;
+}
+
+bool QContactFetchRequestData::pageReceived(int offset, int count)
+{
+    m_pageRequests.remove(offset);
+    int requested = m_pageSizes.take(offset);
+    qint64 requestedAt = m_pageRequestedAt.take(offset);
+    qint64 now = m_clock.elapsed();
+
+    // a incomplete page means the end of the view
+    if (((count < requested) || (offset == m_lastPageOffset)) && ((m_endOffset < 0) || ((offset + count) < m_endOffset))) {
+        m_endOffset = offset + count;
+    }
+
+    // pages after the end of the view are ignored
+    if ((count == 0) || ((m_endOffset >= 0) && (offset >= m_endOffset))) {
+        return false;
+    }
+
+    // with several pages in flight the server only starts a page after sending the previous one,
+    // the time waiting on the queue is not part of the page time
+    qint64 startedAt = qMax(requestedAt, m_lastPageReceivedAt);
+    m_lastPageReceivedAt = now;
+
+    m_pageReceivedAt.insert(offset, now);
+    m_pageCounts.insert(offset, count);
+    updatePageSize(count, now - startedAt);
+    return true;
 }
 
-void QContactFetchRequestData::setVCardParser(VCardParser *parser)
+void QContactFetchRequestData::pageParsed(int offset, const QList<QContact> &contacts)
 {
-    m_runningParser = parser;
+    // same for the parse, a page waits for the previous one to be parsed
+    qint64 startedAt = qMax(m_pageReceivedAt.take(offset), m_lastPageParsedAt);
+    qint64 now = m_clock.elapsed();
+    m_lastPageParsedAt = now;
+    updatePageSize(m_pageCounts.value(offset), now - startedAt);
+    m_parsedPages.insert(offset, contacts);
 }
 
-void QContactFetchRequestData::clearVCardParser()
+QList<QContact> QContactFetchRequestData::takeParsedPages()
 {
-    m_runningParser = 0;
+    // deliver the pages in order
+    QList<QContact> contacts;
+    while (m_parsedPages.contains(m_offset)) {
+        contacts += m_parsedPages.take(m_offset);
+        m_offset += m_pageCounts.take(m_offset);
+    }
+    return contacts;
+}
+
+bool QContactFetchRequestData::allPagesDelivered() const
+{
+    return (m_endOffset >= 0) && (m_offset >= m_endOffset);
+}
+
+void QContactFetchRequestData::updatePageSize(int count, qint64 elapsed)
+{
+    if (!m_adaptivePageSize || (count <= 0)) {
+        return;
+    }
+
+    // the slowest step (serialization/transport or parse) defines the page size,
+    // big pages reduce the number of round trips, small pages keep the pipeline moving
+    double timePerContact = qMax<double>(elapsed, 1) / count;
+    int newPageSize = qRound(FETCH_PAGE_TARGET_TIME / timePerContact);
+    newPageSize = qBound(m_pageSize / 2, newPageSize, m_pageSize * 2);
+    m_pageSize = qBound(FETCH_MIN_PAGE_SIZE, newPageSize, FETCH_MAX_PAGE_SIZE);
 }
 
 void QContactFetchRequestData::updateView(QDBusInterface* view)
@@ -76,14 +195,36 @@ QStringList QContactFetchRequestData::fields() const
     return m_hint.fields();
 }
 
-void QContactFetchRequestData::updateOffset(int offset)
+QList<QContact> QContactFetchRequestData::result() const
+{
+    return m_result;
+}
+
+void QContactFetchRequestData::setStreaming(bool streaming)
 {
-    m_offset += offset;
+    m_streaming = streaming;
 }
 
-QList<QContact> QContactFetchRequestData::result() const
+bool QContactFetchRequestData::isStreaming() const
 {
-    return m_result;
+    return m_streaming;
+}
+
+void QContactFetchRequestData::reserveResults(int count)
+{
+    if (!m_streaming && (count > m_allResults.size())) {
+        m_allResults.reserve(count);
+    }
+}
+
+void QContactFetchRequestData::setCacheGeneration(qint64 generation)
+{
+    m_cacheGeneration = generation;
+}
+
+qint64 QContactFetchRequestData::cacheGeneration() const
+{
+    return m_cacheGeneration;
 }
 
 void QContactFetchRequestData::update(QContactAbstractRequest::State state,
@@ -102,14 +243,17 @@ void QContactFetchRequestData::update(QList<QContact> result,
                                       QMap<int, QContactManager::Error> errorMap)
 {
     m_result = result;
-    m_allResults += result;
+    if (!m_streaming) {
+        m_allResults.append(result);
+    }
     QContactRequestData::update(state, error, errorMap);
 }
 
 void QContactFetchRequestData::cancel()
 {
-    if (m_runningParser) {
-        m_runningParser->cancel();
+    m_pageRequests.clear();
+    Q_FOREACH(VCardParser *parser, m_runningParsers) {
+        parser->cancel();
     }
     QContactRequestData::cancel();
 }
@@ -122,25 +266,36 @@ void QContactFetchRequestData::notifyError(QContactFetchRequest *request, QConta
                                                      QContactAbstractRequest::FinishedState);
 }
 
-void QContactFetchRequestData::updateRequest(QContactAbstractRequest::State state, QContactManager::Error error, QMap<int, QContactManager::Error> errorMap)
+QList<QContact> QContactFetchRequestData::takeResult(QContactAbstractRequest::State state)
 {
-    QList<QtContacts::QContact> result;
     // send all results only in the finished state, this will avoid a contact update in every updateContactFetchRequest
-    switch(state)
-    {
-    case QContactAbstractRequest::FinishedState:
-        result = m_allResults;
-        break;
-    default:
-        result = m_result;
+    if ((state != QContactAbstractRequest::FinishedState) || m_streaming) {
+        return m_result;
     }
 
+    // the accumulated list is moved to the request, this avoids a copy when the list is modified
+    QList<QContact> result;
+    result.swap(m_allResults);
+    return result;
+}
+
+void QContactFetchRequestData::updateRequest(QContactAbstractRequest::State state, QContactManager::Error error, QMap<int, QContactManager::Error> errorMap)
+{
     QContactManagerEngine::updateContactFetchRequest(static_cast<QContactFetchRequest*>(m_request.data()),
-                                                     result,
+                                                     takeResult(state),
                                                      error,
                                                      state);
 }
 
+void QContactFetchRequestData::deletePageWatcher(QDBusPendingCallWatcher *watcher)
+{
+    if (watcher) {
+        // the watcher can be destroyed while emitting the finished signal
+        watcher->disconnect();
+        watcher->deleteLater();
+    }
+}
+
 void QContactFetchRequestData::deleteView(QDBusInterface *view)
 {
     if (view) {
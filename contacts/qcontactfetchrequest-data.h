@@ -23,8 +23,10 @@
 #include <common/fetch-hint.h>
 
 #include <QtCore/QList>
+#include <QtCore/QMap>
 #include <QtCore/QSet>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QElapsedTimer>
 
 #include <QtContacts/QContactAbstractRequest>
 #include <QtContacts/QContactFetchRequest>
@@ -44,16 +46,34 @@ public:
 
     QStringList fields() const;
 
-    void updateOffset(int offset);
-    int offset() const;
-
     void updateView(QDBusInterface *view);
     QDBusInterface* view() const;
 
-    void setVCardParser(VCardParser *parser);
-    void clearVCardParser();
+    void appendVCardParser(VCardParser *parser);
+    void removeVCardParser(VCardParser *parser);
+
+    // pages
+    void setPageSize(int pageSize, bool adaptive);
+    int pageSize() const;
+    int nextPageOffset() const;
+    bool canRequestPage(int maxPagesInFlight) const;
+    // "lastPage" is used when all contacts are requested in a single page
+    void appendPageRequest(int offset, int pageSize, QDBusPendingCallWatcher *watcher, bool lastPage = false);
+    // return false if the page does not need to be parsed
+    bool pageReceived(int offset, int count);
+    void pageParsed(int offset, const QList<QtContacts::QContact> &contacts);
+    QList<QtContacts::QContact> takeParsedPages();
+    bool allPagesDelivered() const;
 
     QList<QtContacts::QContact> result() const;
+    // streaming requests only deliver the current page, the pages are not accumulated
+    void setStreaming(bool streaming);
+    bool isStreaming() const;
+    // preallocate the result list with the expected number of contacts
+    void reserveResults(int count);
+    // cache generation when the request started, -1 means that the result should not be cached
+    void setCacheGeneration(qint64 generation);
+    qint64 cacheGeneration() const;
 
     void update(QList<QtContacts::QContact> result,
                 QtContacts::QContactAbstractRequest::State state,
@@ -68,6 +88,7 @@ protected:
     QList<QtContacts::QContact> m_result;
     QList<QtContacts::QContact> m_allResults;
 
+    QList<QtContacts::QContact> takeResult(QtContacts::QContactAbstractRequest::State state);
     virtual void updateRequest(QtContacts::QContactAbstractRequest::State state,
                                QtContacts::QContactManager::Error error,
                                QMap<int, QtContacts::QContactManager::Error> errorMap);
@@ -77,12 +98,34 @@ protected:
                 QMap<int, QtContacts::QContactManager::Error> errorMap = QMap<int, QtContacts::QContactManager::Error>());
 
 private:
-    VCardParser *m_runningParser;
+    QList<VCardParser*> m_runningParsers;
     QSharedPointer<QDBusInterface> m_view;
+
+    // pages requested but not received yet
+    QMap<int, QSharedPointer<QDBusPendingCallWatcher> > m_pageRequests;
+    QMap<int, int> m_pageSizes;
+    QMap<int, qint64> m_pageRequestedAt;
+    QMap<int, qint64> m_pageReceivedAt;
+    QMap<int, int> m_pageCounts;
+    // pages parsed waiting for the previous pages
+    QMap<int, QList<QtContacts::QContact> > m_parsedPages;
+    QElapsedTimer m_clock;
+    int m_pageSize;
+    bool m_adaptivePageSize;
+    int m_nextOffset;
     int m_offset;
+    int m_endOffset;
+    int m_lastPageOffset;
+    qint64 m_lastPageReceivedAt;
+    qint64 m_lastPageParsedAt;
+    qint64 m_cacheGeneration;
+    bool m_streaming;
     FetchHint m_hint;
 
+    void updatePageSize(int count, qint64 elapsed);
+
     static void deleteView(QDBusInterface *view);
+    static void deletePageWatcher(QDBusPendingCallWatcher *watcher);
 };
 
 }
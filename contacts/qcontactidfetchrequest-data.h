@@ -0,0 +1,55 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __GALERA_QCONTACTIDFETCHREQUEST_DATA_H__
+#define __GALERA_QCONTACTIDFETCHREQUEST_DATA_H__
+
+#include "qcontactrequest-data.h"
+
+#include <QtCore/QList>
+
+#include <QtContacts/QContactId>
+#include <QtContacts/QContactIdFetchRequest>
+
+namespace galera
+{
+class QContactIdFetchRequestData : public QContactRequestData
+{
+public:
+    QContactIdFetchRequestData(QtContacts::QContactIdFetchRequest *request);
+
+    void update(QList<QtContacts::QContactId> result,
+                QtContacts::QContactAbstractRequest::State state,
+                QtContacts::QContactManager::Error error = QtContacts::QContactManager::NoError);
+
+    static void notifyError(QtContacts::QContactIdFetchRequest *request,
+                            QtContacts::QContactManager::Error error = QtContacts::QContactManager::NotSupportedError);
+
+protected:
+    virtual void updateRequest(QtContacts::QContactAbstractRequest::State state,
+                               QtContacts::QContactManager::Error error,
+                               QMap<int, QtContacts::QContactManager::Error> errorMap);
+
+private:
+    QList<QtContacts::QContactId> m_result;
+};
+
+}
+
+#endif
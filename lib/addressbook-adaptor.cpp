@@ -19,6 +19,8 @@
 #include "addressbook-adaptor.h"
 #include "addressbook.h"
 #include "view.h"
+#include "stats.h"
+#include "workload-recorder.h"
 
 namespace galera
 {
@@ -41,6 +43,7 @@ AddressBookAdaptor::~AddressBookAdaptor()
 
 SourceList AddressBookAdaptor::availableSources(const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "availableSources",
                               Qt::QueuedConnection,
@@ -50,6 +53,7 @@ SourceList AddressBookAdaptor::availableSources(const QDBusMessage &message)
 
 Source AddressBookAdaptor::source(const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "source",
                               Qt::QueuedConnection,
@@ -59,6 +63,7 @@ Source AddressBookAdaptor::source(const QDBusMessage &message)
 
 Source AddressBookAdaptor::createSource(const QString &sourceName, bool setAsPrimary, const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD(message, sourceName << setAsPrimary);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "createSource",
                               Qt::QueuedConnection,
@@ -74,6 +79,7 @@ Source AddressBookAdaptor::createSourceForAccount(const QString &sourceName,
                                                   bool setAsPrimary,
                                                   const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD(message, sourceName << accountId << setAsPrimary);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "createSource",
                               Qt::QueuedConnection,
@@ -86,6 +92,8 @@ Source AddressBookAdaptor::createSourceForAccount(const QString &sourceName,
 
 SourceList AddressBookAdaptor::updateSources(const SourceList &sources, const QDBusMessage &message)
 {
+    // the sources are not recorded, the call can not be replayed
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "updateSources",
                               Qt::QueuedConnection,
@@ -96,6 +104,7 @@ SourceList AddressBookAdaptor::updateSources(const SourceList &sources, const QD
 
 bool AddressBookAdaptor::removeSource(const QString &sourceId, const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD(message, sourceId);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "removeSource",
                               Qt::QueuedConnection,
@@ -107,6 +116,7 @@ bool AddressBookAdaptor::removeSource(const QString &sourceId, const QDBusMessag
 
 QString AddressBookAdaptor::createContact(const QString &contact, const QString &source, const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD(message, contact << source);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "createContact",
                               Qt::QueuedConnection,
@@ -116,15 +126,69 @@ QString AddressBookAdaptor::createContact(const QString &contact, const QString
     return QString();
 }
 
-QDBusObjectPath AddressBookAdaptor::query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources)
+QDBusObjectPath AddressBookAdaptor::query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources,
+                                          const QDBusMessage &message)
 {
-    View *v = m_addressBook->query(clause, sort, maxCount, showInvisible, sources);
+    GALERA_STATS_SCOPE("AddressBook.query");
+    GALERA_WORKLOAD_RECORD(message, clause << sort << maxCount << showInvisible << sources);
+    View *v = m_addressBook->query(clause, sort, maxCount, showInvisible, sources, message.service());
     v->registerObject(m_connection);
+    GALERA_WORKLOAD_RESULT(v->dynamicObjectPath());
     return QDBusObjectPath(v->dynamicObjectPath());
 }
 
+QDBusObjectPath AddressBookAdaptor::queryFirstPage(const QString &clause, const QString &sort, int maxCount, bool showInvisible,
+                                                   const QStringList &sources, const QStringList &fields, int pageSize,
+                                                   const QDBusMessage &message, QStringList &vcards)
+{
+    GALERA_STATS_SCOPE("AddressBook.queryFirstPage");
+    GALERA_WORKLOAD_RECORD(message, clause << sort << maxCount << showInvisible << sources << fields << pageSize);
+    Q_UNUSED(vcards);
+    message.setDelayedReply(true);
+    View *v = m_addressBook->queryFirstPage(clause, sort, maxCount, showInvisible, sources, fields, pageSize, message);
+    v->registerObject(m_connection);
+    GALERA_WORKLOAD_RESULT(v->dynamicObjectPath());
+    return QDBusObjectPath(v->dynamicObjectPath());
+}
+
+QStringList AddressBookAdaptor::contactsByIds(const QStringList &ids, const QStringList &fields, const QDBusMessage &message)
+{
+    GALERA_STATS_SCOPE("AddressBook.contactsByIds");
+    GALERA_WORKLOAD_RECORD(message, ids << fields);
+    message.setDelayedReply(true);
+    m_addressBook->contactsByIds(ids, fields, message);
+    return QStringList();
+}
+
+QStringList AddressBookAdaptor::lookupPhone(const QString &phone, const QStringList &fields, const QDBusMessage &message)
+{
+    GALERA_STATS_SCOPE("AddressBook.lookupPhone");
+    GALERA_WORKLOAD_RECORD(message, phone << fields);
+    message.setDelayedReply(true);
+    m_addressBook->lookupPhone(phone, fields, message);
+    return QStringList();
+}
+
+QStringList AddressBookAdaptor::smartDial(const QString &digits, int max, const QDBusMessage &message)
+{
+    GALERA_STATS_SCOPE("AddressBook.smartDial");
+    GALERA_WORKLOAD_RECORD(message, digits << max);
+    return m_addressBook->smartDial(digits, max);
+}
+
+QStringList AddressBookAdaptor::queryIds(const QString &clause, const QString &sort, int maxCount, bool showInvisible,
+                                         const QStringList &sources, const QDBusMessage &message)
+{
+    GALERA_STATS_SCOPE("AddressBook.queryIds");
+    GALERA_WORKLOAD_RECORD(message, clause << sort << maxCount << showInvisible << sources);
+    message.setDelayedReply(true);
+    m_addressBook->queryIds(clause, sort, maxCount, showInvisible, sources, message);
+    return QStringList();
+}
+
 int AddressBookAdaptor::removeContacts(const QStringList &contactIds, const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD(message, contactIds);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "removeContacts",
                               Qt::QueuedConnection,
@@ -133,23 +197,30 @@ int AddressBookAdaptor::removeContacts(const QStringList &contactIds, const QDBu
     return 0;
 }
 
-QStringList AddressBookAdaptor::sortFields()
+QStringList AddressBookAdaptor::sortFields(const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBook.sortFields");
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
     return m_addressBook->sortFields();
 }
 
-QString AddressBookAdaptor::linkContacts(const QStringList &contactsIds)
+QString AddressBookAdaptor::linkContacts(const QStringList &contactsIds, const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBook.linkContacts");
+    GALERA_WORKLOAD_RECORD(message, contactsIds);
     return m_addressBook->linkContacts(contactsIds);
 }
 
-bool AddressBookAdaptor::unlinkContacts(const QString &parentId, const QStringList &contactsIds)
+bool AddressBookAdaptor::unlinkContacts(const QString &parentId, const QStringList &contactsIds, const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBook.unlinkContacts");
+    GALERA_WORKLOAD_RECORD(message, parentId << contactsIds);
     return m_addressBook->unlinkContacts(parentId, contactsIds);
 }
 
 QStringList AddressBookAdaptor::updateContacts(const QStringList &contacts, const QDBusMessage &message)
 {
+    GALERA_WORKLOAD_RECORD(message, contacts);
     message.setDelayedReply(true);
     QMetaObject::invokeMethod(m_addressBook, "updateContacts",
                               Qt::QueuedConnection,
@@ -163,13 +234,17 @@ bool AddressBookAdaptor::isReady()
     return m_addressBook->isReady();
 }
 
-bool AddressBookAdaptor::ping()
+bool AddressBookAdaptor::ping(const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBook.ping");
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
     return true;
 }
 
 void AddressBookAdaptor::purgeContacts(const QString &since, const QString &sourceId, const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBook.purgeContacts");
+    GALERA_WORKLOAD_RECORD(message, since << sourceId);
     QDateTime sinceDate;
     if (since.isEmpty()) {
         sinceDate = QDateTime::fromTime_t(0);
@@ -179,8 +254,49 @@ void AddressBookAdaptor::purgeContacts(const QString &since, const QString &sour
     m_addressBook->purgeContacts(sinceDate, sourceId, message);
 }
 
+void AddressBookAdaptor::registerChangesListener(const QStringList &fields,
+                                                 bool includeContacts,
+                                                 const QDBusMessage &message)
+{
+    GALERA_STATS_SCOPE("AddressBook.registerChangesListener");
+    GALERA_WORKLOAD_RECORD(message, fields << includeContacts);
+    m_addressBook->registerChangesListener(message.service(), fields, includeContacts);
+}
+
+void AddressBookAdaptor::unregisterChangesListener(const QDBusMessage &message)
+{
+    GALERA_STATS_SCOPE("AddressBook.unregisterChangesListener");
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
+    m_addressBook->unregisterChangesListener(message.service());
+}
+
+QVariantMap AddressBookAdaptor::notificationStatistics() const
+{
+    GALERA_STATS_SCOPE("AddressBook.notificationStatistics");
+    return m_addressBook->notificationStatistics();
+}
+
+void AddressBookAdaptor::notifyListener(const QString &service,
+                                        const QString &signalName,
+                                        const QVariantList &arguments)
+{
+    // send the signal only for the client that asked for it
+    QDBusMessage signal = QDBusMessage::createTargetedSignal(service,
+                                                             CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                             CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                             signalName);
+    signal.setArguments(arguments);
+    m_connection.send(signal);
+}
+
+QDBusConnection AddressBookAdaptor::connection() const
+{
+    return m_connection;
+}
+
 void AddressBookAdaptor::shutDown() const
 {
+    GALERA_STATS_SCOPE("AddressBook.shutDown");
     m_addressBook->shutdown();
 }
 
@@ -48,6 +48,15 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "    <signal name=\"contactsAdded\">\n"
 "      <arg direction=\"out\" type=\"as\" name=\"ids\"/>\n"
 "    </signal>\n"
+"    <signal name=\"contactsUpdatedDetailed\">\n"
+"      <arg direction=\"out\" type=\"as\" name=\"ids\"/>\n"
+"      <arg direction=\"out\" type=\"ai\" name=\"detailTypes\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"vcards\"/>\n"
+"    </signal>\n"
+"    <signal name=\"contactsAddedDetailed\">\n"
+"      <arg direction=\"out\" type=\"as\" name=\"ids\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"vcards\"/>\n"
+"    </signal>\n"
 "    <signal name=\"asyncOperationResult\">\n"
 "      <arg direction=\"out\" type=\"a(ss)\" name=\"errorMap\"/>\n"
 "    </signal>\n"
@@ -99,6 +108,40 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"as\" name=\"sources\"/>\n"
 "      <arg direction=\"out\" type=\"o\"/>\n"
 "    </method>\n"
+"    <method name=\"queryFirstPage\">\n"
+"      <arg direction=\"in\" type=\"s\" name=\"clause\"/>\n"
+"      <arg direction=\"in\" type=\"s\" name=\"sort\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"maxCount\"/>\n"
+"      <arg direction=\"in\" type=\"b\" name=\"showInvisible\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"sources\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"pageSize\"/>\n"
+"      <arg direction=\"out\" type=\"o\" name=\"view\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"vcards\"/>\n"
+"    </method>\n"
+"    <method name=\"contactsByIds\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"ids\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"vcards\"/>\n"
+"    </method>\n"
+"    <method name=\"lookupPhone\">\n"
+"      <arg direction=\"in\" type=\"s\" name=\"phone\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"vcards\"/>\n"
+"    </method>\n"
+"    <method name=\"smartDial\">\n"
+"      <arg direction=\"in\" type=\"s\" name=\"digits\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"max\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"ids\"/>\n"
+"    </method>\n"
+"    <method name=\"queryIds\">\n"
+"      <arg direction=\"in\" type=\"s\" name=\"clause\"/>\n"
+"      <arg direction=\"in\" type=\"s\" name=\"sort\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"maxCount\"/>\n"
+"      <arg direction=\"in\" type=\"b\" name=\"showInvisible\"/>\n"
+"      <arg direction=\"in\" type=\"as\" name=\"sources\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"ids\"/>\n"
+"    </method>\n"
 "    <method name=\"removeContacts\">\n"
 "      <arg direction=\"out\" type=\"i\"/>\n"
 "      <arg direction=\"in\" type=\"as\" name=\"contactIds\"/>\n"
@@ -125,6 +168,14 @@ class AddressBookAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"s\"/>\n"
 "      <arg direction=\"in\" type=\"s\"/>\n"
 "    </method>\n"
+"    <method name=\"registerChangesListener\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
+"      <arg direction=\"in\" type=\"b\" name=\"includeContacts\"/>\n"
+"    </method>\n"
+"    <method name=\"unregisterChangesListener\"/>\n"
+"    <method name=\"notificationStatistics\">\n"
+"      <arg direction=\"out\" type=\"a{sv}\"/>\n"
+"    </method>\n"
 "    <method name=\"shutDown\"/>\n"
 "  </interface>\n"
         "")
@@ -136,6 +187,8 @@ public:
     virtual ~AddressBookAdaptor();
 
     void setSafeMode(bool flag);
+    QDBusConnection connection() const;
+    void notifyListener(const QString &service, const QString &signalName, const QVariantList &arguments);
 
 public Q_SLOTS:
     SourceList availableSources(const QDBusMessage &message);
@@ -147,17 +200,27 @@ public Q_SLOTS:
                                   const QDBusMessage &message);
     SourceList updateSources(const SourceList &sources, const QDBusMessage &message);
     bool removeSource(const QString &sourceId, const QDBusMessage &message);
-    QStringList sortFields();
-    QDBusObjectPath query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources);
+    QStringList sortFields(const QDBusMessage &message);
+    QDBusObjectPath query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources,
+                          const QDBusMessage &message);
+    QDBusObjectPath queryFirstPage(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources,
+                                   const QStringList &fields, int pageSize, const QDBusMessage &message, QStringList &vcards);
+    QStringList contactsByIds(const QStringList &ids, const QStringList &fields, const QDBusMessage &message);
+    QStringList lookupPhone(const QString &phone, const QStringList &fields, const QDBusMessage &message);
+    QStringList smartDial(const QString &digits, int max, const QDBusMessage &message);
+    QStringList queryIds(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources, const QDBusMessage &message);
     int removeContacts(const QStringList &contactIds, const QDBusMessage &message);
     QString createContact(const QString &contact, const QString &source, const QDBusMessage &message);
     QStringList updateContacts(const QStringList &contacts, const QDBusMessage &message);
-    QString linkContacts(const QStringList &contacts);
-    bool unlinkContacts(const QString &parentId, const QStringList &contactsIds);
+    QString linkContacts(const QStringList &contacts, const QDBusMessage &message);
+    bool unlinkContacts(const QString &parentId, const QStringList &contactsIds, const QDBusMessage &message);
     bool isReady();
     bool safeMode() const;
-    bool ping();
+    bool ping(const QDBusMessage &message);
     void purgeContacts(const QString &since, const QString &sourceId, const QDBusMessage &message);
+    void registerChangesListener(const QStringList &fields, bool includeContacts, const QDBusMessage &message);
+    void unregisterChangesListener(const QDBusMessage &message);
+    QVariantMap notificationStatistics() const;
     void shutDown() const;
 
 
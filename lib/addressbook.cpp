@@ -19,16 +19,28 @@
 #include "config.h"
 #include "addressbook.h"
 #include "addressbook-adaptor.h"
+#include "avatar-store.h"
+#include "avatar-thumbnailer.h"
 #include "view.h"
+#include "filter-thread.h"
 #include "contacts-map.h"
 #include "qindividual.h"
 #include "dirtycontact-notify.h"
+#include "memory-usage.h"
+#include "stats.h"
+#include "stats-adaptor.h"
+#include "startup-timeline.h"
+#include "trace.h"
+#include "workload-recorder.h"
 #include "e-source-ubuntu.h"
 
 #include "common/vcard-parser.h"
+#include "common/fetch-hint.h"
 
 #include <QtCore/QPair>
 #include <QtCore/QUuid>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 
 #include <QtContacts/QContactExtendedDetail>
 
@@ -47,6 +59,16 @@ namespace C {
 }
 
 #define MESSAGING_MENU_SOURCE_ID "address-book-service"
+// interval between the memory budget checks in ms
+#define MEMORY_BUDGET_CHECK_INTERVAL    30000
+// views without calls for this time (in seconds) can be closed to keep the memory budget
+#define MEMORY_BUDGET_VIEW_IDLE_TIME    300
+// interval between the checks for idle views in ms
+#define VIEW_REAP_INTERVAL              60000
+// views without calls for this time (in seconds) are closed
+#define VIEW_IDLE_TIMEOUT               1800
+// max number of open views of each client, the least recently used is closed to open a new one
+#define VIEW_CLIENT_LIMIT               32
 
 using namespace QtContacts;
 
@@ -59,6 +81,7 @@ public:
     QDBusMessage m_message;
     QContact m_contact;
     galera::AddressBook *m_addressbook;
+    qint64 m_start;
 };
 
 class UpdateContactsData
@@ -80,6 +103,7 @@ public:
     QDBusMessage m_message;
     int m_sucessCount;
     bool m_softRemoval;
+    qint64 m_start;
 };
 
 class CreateSourceData
@@ -154,13 +178,17 @@ ESource* create_esource_from_data(CreateSourceData &data, ESourceRegistry **regi
 namespace galera
 {
 int AddressBook::m_sigQuitFd[2] = {0, 0};
+int AddressBook::m_sigTraceFd[2] = {0, 0};
 QSettings AddressBook::m_settings(SETTINGS_ORG, SETTINGS_APPLICATION);
 
 AddressBook::AddressBook(QObject *parent)
     : QObject(parent),
       m_individualAggregator(0),
       m_contacts(0),
+      m_clientWatcher(0),
       m_adaptor(0),
+      m_statsAdaptor(0),
+      m_startupTimeline(new StartupTimeline),
       m_notifyContactUpdate(0),
       m_edsIsLive(false),
       m_ready(false),
@@ -169,6 +197,7 @@ AddressBook::AddressBook(QObject *parent)
       m_individualsChangedDetailedId(0),
       m_notifyIsQuiescentHandlerId(0),
       m_connection(QDBusConnection::sessionBus()),
+      m_updateCommandStart(0),
       m_messagingMenu(0),
       m_messagingMenuMessage(0),
       m_sourceRegistryListener(0)
@@ -180,9 +209,32 @@ AddressBook::AddressBook(QObject *parent)
         m_serviceName = CPIM_SERVICE_NAME;
     }
     prepareUnixSignals();
+    m_startupTimeline->mark("connectWithEDS");
     connectWithEDS();
+    QVariantMap edsDetails;
+    edsDetails.insert("edsIsLive", m_edsIsLive);
+    m_startupTimeline->mark("edsConnected", edsDetails);
     connect(this, SIGNAL(readyChanged()), SLOT(checkCompatibility()));
     connect(this, SIGNAL(safeModeChanged()), SLOT(onSafeModeChanged()));
+
+    if (memoryBudget() > 0) {
+        m_memoryBudgetTimer.setInterval(MEMORY_BUDGET_CHECK_INTERVAL);
+        connect(&m_memoryBudgetTimer, SIGNAL(timeout()), SLOT(checkMemoryBudget()));
+        m_memoryBudgetTimer.start();
+    }
+
+    m_clientWatcher = new QDBusServiceWatcher(this);
+    m_clientWatcher->setConnection(m_connection);
+    m_clientWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(m_clientWatcher, SIGNAL(serviceUnregistered(QString)), SLOT(onClientUnregistered(QString)));
+
+    AvatarStore::instance();
+    connect(AvatarThumbnailer::instance(), SIGNAL(thumbnailsReady(QStringList)),
+            SLOT(onAvatarThumbnailsReady(QStringList)));
+
+    m_reapViewsTimer.setInterval(VIEW_REAP_INTERVAL);
+    connect(&m_reapViewsTimer, SIGNAL(timeout()), SLOT(reapViews()));
+    m_reapViewsTimer.start();
 }
 
 AddressBook::~AddressBook()
@@ -214,6 +266,8 @@ AddressBook::~AddressBook()
         delete m_notifyContactUpdate;
         m_notifyContactUpdate = 0;
     }
+
+    delete m_startupTimeline;
 }
 
 QString AddressBook::objectPath()
@@ -233,11 +287,14 @@ bool AddressBook::registerObject(QDBusConnection &connection)
 
     if (!m_adaptor) {
         m_adaptor = new AddressBookAdaptor(connection, this);
+        m_statsAdaptor = new StatsAdaptor(this);
         if (!connection.registerObject(galera::AddressBook::objectPath(), this))
         {
             qWarning() << "Could not register object!" << objectPath();
             delete m_adaptor;
             m_adaptor = 0;
+            delete m_statsAdaptor;
+            m_statsAdaptor = 0;
             if (m_notifyContactUpdate) {
                 delete m_notifyContactUpdate;
                 m_notifyContactUpdate = 0;
@@ -245,15 +302,21 @@ bool AddressBook::registerObject(QDBusConnection &connection)
         }
     }
     if (m_adaptor) {
-        m_notifyContactUpdate = new DirtyContactsNotify(m_adaptor);
+        m_notifyContactUpdate = new DirtyContactsNotify(this, m_adaptor);
+        if (qEnvironmentVariableIsSet(ADDRESS_BOOK_RECORD_WORKLOAD)) {
+            WorkloadRecorder::start(QString::fromLocal8Bit(qgetenv(ADDRESS_BOOK_RECORD_WORKLOAD)));
+        }
     }
     return (m_adaptor != 0);
 }
 
 bool AddressBook::start(QDBusConnection connection)
 {
+    m_startupTimeline->mark("start");
     if (registerObject(connection)) {
+        m_startupTimeline->mark("registered");
         m_connection = connection;
+        m_clientWatcher->setConnection(m_connection);
         prepareFolks();
         return true;
     }
@@ -275,11 +338,15 @@ void AddressBook::unprepareFolks()
     m_notifyContactUpdate->flush();
 
     setIsReady(false);
+    m_startupTimeline->mark("unprepareFolks");
 
     Q_FOREACH(View* view, m_views) {
         view->close();
     }
     m_views.clear();
+    m_clientViews.clear();
+    m_clientWatcher->setWatchedServices(QStringList());
+    m_filterThreads.clear();
 
     if (m_contacts) {
         delete m_contacts;
@@ -366,8 +433,13 @@ void AddressBook::continueShutdown()
             }
         }
 
+        WorkloadRecorder::stop();
+        AvatarStore::instance()->flush();
+        AvatarThumbnailer::instance()->flush();
         delete m_adaptor;
         m_adaptor = 0;
+        delete m_statsAdaptor;
+        m_statsAdaptor = 0;
         Q_EMIT stopped();
     }
 }
@@ -376,6 +448,13 @@ void AddressBook::setIsReady(bool isReady)
 {
     if (isReady != m_ready) {
         m_ready = isReady;
+        if (m_ready) {
+            m_startupTimeline->ready(m_contacts ? m_contacts->size() : 0);
+            // the contacts removed while the service was not running
+            if (m_contacts) {
+                AvatarStore::instance()->prune(m_contacts->keys());
+            }
+        }
         if (m_adaptor) {
             Q_EMIT readyChanged();
         }
@@ -385,6 +464,8 @@ void AddressBook::setIsReady(bool isReady)
 void AddressBook::prepareFolks()
 {
     qDebug() << "Initialize folks";
+    m_startupTimeline->mark("prepareFolks");
+    m_startupTimeline->watchFolks();
     m_contacts = new ContactsMap;
     m_individualAggregator = folks_individual_aggregator_dup();
     gboolean ready;
@@ -784,6 +865,7 @@ void AddressBook::edsPrepared(GObject *source, GAsyncResult *res, void *data)
     }
     // remove reference created by parent function
     g_object_unref(source);
+    self->m_startupTimeline->mark("edsPrepared");
     // will start folks again
     self->prepareFolks();
 }
@@ -866,6 +948,7 @@ void AddressBook::setSafeMode(bool flag)
                 QIndividual *i = entry->individual();
                 if (!i->isVisible()) {
                     i->setVisible(true);
+                    m_contacts->updateIndexes(entry);
                 }
             }
             // clear invisible sources list
@@ -1066,7 +1149,11 @@ QString AddressBook::createContact(const QString &contact, const QString &source
     if (entry) {
         qWarning() << "Contact exists";
     } else {
-        QContact qcontact = VCardParser::vcardToContact(contact);
+        QContact qcontact;
+        {
+            GALERA_STATS_SCOPE("VCardParser.vcardToContact");
+            qcontact = VCardParser::vcardToContact(contact);
+        }
         if (!qcontact.isEmpty()) {
             GHashTable *details = QIndividual::parseDetails(qcontact);
             Q_ASSERT(details);
@@ -1074,6 +1161,7 @@ QString AddressBook::createContact(const QString &contact, const QString &source
             data->m_message = message;
             data->m_addressbook = this;
             data->m_contact = qcontact;
+            data->m_start = Stats::now();
             FolksPersonaStore *store = getFolksStore(source);
             folks_individual_aggregator_add_persona_from_details(m_individualAggregator,
                                                                  NULL, //parent
@@ -1159,23 +1247,391 @@ QString AddressBook::linkContacts(const QStringList &contacts)
     return "";
 }
 
-View *AddressBook::query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources)
+QSharedPointer<FilterThread> AddressBook::sharedFilter(const QString &clause, const QString &sort, int maxCount,
+                                                       bool showInvisible, const QStringList &sources)
+{
+    if (!m_ready) {
+        return QSharedPointer<FilterThread>(new FilterThread(clause, sort, maxCount, showInvisible, 0));
+    }
+
+    // views with the same query share the result while the contacts do not change, the
+    // results are snapshots (see FilterThread) and any change on the contacts map, including
+    // the index updates of a sync, starts a new one
+    QString key = FilterThread::key(clause, sort, maxCount, showInvisible, sources);
+    QSharedPointer<FilterThread> filter = m_filterThreads.value(key).toStrongRef();
+    if (filter && (filter->generation() == m_contacts->generation())) {
+        return filter;
+    }
+
+    QHash<QString, QWeakPointer<FilterThread> >::iterator it = m_filterThreads.begin();
+    while (it != m_filterThreads.end()) {
+        if (it.value().isNull()) {
+            it = m_filterThreads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    filter = QSharedPointer<FilterThread>(new FilterThread(clause, sort, maxCount, showInvisible, m_contacts));
+    m_filterThreads.insert(key, filter);
+    QThreadPool::globalInstance()->start(filter.data());
+    return filter;
+}
+
+View *AddressBook::query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources,
+                         const QString &client)
 {
-    View *view = new View(clause, sort, maxCount, showInvisible, sources, m_ready ? m_contacts : 0, this);
+    m_startupTimeline->queryServed();
+    if (!client.isEmpty()) {
+        QList<View*> clientViews = m_clientViews.values(client);
+        if (clientViews.isEmpty()) {
+            m_clientWatcher->addWatchedService(client);
+        } else if (clientViews.size() >= VIEW_CLIENT_LIMIT) {
+            // close the least recently used view of the client
+            View *oldest = clientViews.first();
+            Q_FOREACH(View *clientView, clientViews) {
+                if (clientView->lastAccess() < oldest->lastAccess()) {
+                    oldest = clientView;
+                }
+            }
+            qWarning() << "Client" << client << "has too many open views, closing" << oldest->dynamicObjectPath();
+            oldest->close();
+            GALERA_STATS_COUNT("Views.reapedLimit", 1);
+        }
+    }
+
+    View *view = new View(sharedFilter(clause, sort, maxCount, showInvisible, sources), sources, this);
+    view->setProperty("CLIENT", client);
     m_views << view;
+    if (!client.isEmpty()) {
+        m_clientViews.insert(client, view);
+    }
     connect(view, SIGNAL(closed()), this, SLOT(viewClosed()));
     return view;
 }
 
+void AddressBook::queryIds(const QString &clause, const QString &sort, int maxCount, bool showInvisible,
+                           const QStringList &sources, const QDBusMessage &message)
+{
+    if (!m_ready) {
+        QDBusMessage reply = message.createReply(QStringList());
+        QDBusConnection::sessionBus().send(reply);
+        return;
+    }
+
+    m_startupTimeline->queryServed();
+    // the view is only used to filter the contacts, it is not registered on the bus
+    View *view = new View(sharedFilter(clause, sort, maxCount, showInvisible, sources), sources, this);
+    view->setProperty("DATA", QVariant::fromValue<QDBusMessage>(message));
+    view->setProperty("STATS_START", Stats::now());
+    GALERA_TRACE_ASYNC_BEGIN("dbus", "AddressBook.queryIds.reply", view);
+    connect(view, SIGNAL(filterDone()), this, SLOT(queryIdsDone()));
+}
+
+void AddressBook::queryIdsDone()
+{
+    View *view = qobject_cast<View*>(QObject::sender());
+    QDBusMessage reply = view->property("DATA").value<QDBusMessage>().createReply(view->contactsIds());
+    QDBusConnection::sessionBus().send(reply);
+    GALERA_STATS_RECORD("AddressBook.queryIds.reply", Stats::now() - view->property("STATS_START").toLongLong());
+    GALERA_TRACE_ASYNC_END("dbus", "AddressBook.queryIds.reply", view);
+    view->deleteLater();
+}
+
+View *AddressBook::queryFirstPage(const QString &clause, const QString &sort, int maxCount, bool showInvisible,
+                                  const QStringList &sources, const QStringList &fields, int pageSize,
+                                  const QDBusMessage &message)
+{
+    View *view = query(clause, sort, maxCount, showInvisible, sources, message.service());
+    if (m_ready) {
+        view->firstPageDetails(fields, pageSize, message);
+    } else {
+        QDBusMessage reply = message.createReply(QVariantList() << QVariant::fromValue(QDBusObjectPath(view->dynamicObjectPath()))
+                                                                << QStringList());
+        QDBusConnection::sessionBus().send(reply);
+    }
+    return view;
+}
+
+void AddressBook::contactsByIds(const QStringList &ids, const QStringList &fields, const QDBusMessage &message)
+{
+    // same result as a query by id, but without create a view
+    m_startupTimeline->queryServed();
+    QList<QContact> contacts;
+    if (m_ready) {
+        QList<QContactDetail::DetailType> detailTypes = FetchHint::parseFieldNames(fields);
+        Q_FOREACH(ContactEntry *entry, m_contacts->values(ids)) {
+            QIndividual *individual = entry->individual();
+            if (individual->isVisible() && !individual->deletedAt().isValid()) {
+                contacts << QIndividual::copy(individual->contact(), detailTypes);
+            }
+        }
+    }
+
+    if (contacts.isEmpty()) {
+        QDBusMessage reply = message.createReply(QStringList());
+        QDBusConnection::sessionBus().send(reply);
+        return;
+    }
+
+    VCardParser *parser = new VCardParser(this);
+    parser->setProperty("DATA", QVariant::fromValue<QDBusMessage>(message));
+    parser->setProperty("STATS_START", Stats::now());
+    parser->setProperty("CONTACTS", contacts.size());
+    GALERA_TRACE_ASYNC_BEGIN("dbus", "AddressBook.contactsByIds.reply", parser);
+    connect(parser, &VCardParser::vcardParsed,
+            this, &AddressBook::contactsByIdsDone);
+    parser->contactToVcard(contacts);
+}
+
+void AddressBook::lookupPhone(const QString &phone, const QStringList &fields, const QDBusMessage &message)
+{
+    QStringList ids;
+    if (m_ready) {
+        QString id = m_contacts->lookupPhone(phone);
+        if (!id.isEmpty()) {
+            ids << id;
+        }
+    }
+    contactsByIds(ids, fields, message);
+}
+
+QStringList AddressBook::smartDial(const QString &digits, int maxCount)
+{
+    if (!m_ready) {
+        return QStringList();
+    }
+    return m_contacts->smartDial(digits, maxCount);
+}
+
+void AddressBook::contactsByIdsDone(const QStringList &vcards)
+{
+    QObject *sender = QObject::sender();
+    QDBusMessage message = sender->property("DATA").value<QDBusMessage>();
+    QDBusConnection::sessionBus().send(message.createReply(vcards));
+
+    // contactsByIds and lookupPhone use the same reply
+    qint64 elapsed = Stats::now() - sender->property("STATS_START").toLongLong();
+    GALERA_STATS_RECORD("VCardParser.contactToVcard", elapsed);
+    if (message.member() == QLatin1String("lookupPhone")) {
+        GALERA_STATS_RECORD("AddressBook.lookupPhone.reply", elapsed);
+    } else {
+        GALERA_STATS_RECORD("AddressBook.contactsByIds.reply", elapsed);
+    }
+    GALERA_TRACE_ASYNC_END("dbus", "AddressBook.contactsByIds.reply", sender);
+    sender->deleteLater();
+}
+
 void AddressBook::viewClosed()
 {
-    m_views.remove(qobject_cast<View*>(QObject::sender()));
+    View *view = qobject_cast<View*>(QObject::sender());
+    m_views.remove(view);
+    m_closedViews << view;
+
+    QString client = view->property("CLIENT").toString();
+    if (!client.isEmpty()) {
+        m_clientViews.remove(client, view);
+        if (!m_clientViews.contains(client)) {
+            m_clientWatcher->removeWatchedService(client);
+        }
+    }
+}
+
+void AddressBook::onClientUnregistered(const QString &client)
+{
+    QList<View*> clientViews = m_clientViews.values(client);
+    if (!clientViews.isEmpty()) {
+        qDebug() << "Client" << client << "left the bus, closing" << clientViews.size() << "views";
+    }
+    Q_FOREACH(View *view, clientViews) {
+        view->close();
+        GALERA_STATS_COUNT("Views.reapedDisconnected", 1);
+    }
+    m_clientViews.remove(client);
+    m_clientWatcher->removeWatchedService(client);
+}
+
+void AddressBook::reapViews()
+{
+    // the views can be in use by the functions waiting on a nested event loop
+    if (QThread::currentThread()->loopLevel() > 1) {
+        return;
+    }
+
+    qint64 idleSince = Stats::now() - (qint64(VIEW_IDLE_TIMEOUT) * 1000000);
+    Q_FOREACH(View *view, m_views) {
+        if (view->lastAccess() < idleSince) {
+            qDebug() << "Closing idle view" << view->dynamicObjectPath();
+            view->close();
+            GALERA_STATS_COUNT("Views.reapedIdle", 1);
+        }
+    }
+
+    // a closed view still replies the pages being parsed
+    Q_FOREACH(View *view, m_closedViews) {
+        if (view->findChildren<VCardParser*>().isEmpty()) {
+            m_closedViews.remove(view);
+            view->deleteLater();
+        }
+    }
+}
+
+void AddressBook::registerChangesListener(const QString &service, const QStringList &fields, bool includeContacts)
+{
+    if (m_notifyContactUpdate) {
+        m_notifyContactUpdate->addListener(service, fields, includeContacts);
+    }
+}
+
+void AddressBook::unregisterChangesListener(const QString &service)
+{
+    if (m_notifyContactUpdate) {
+        m_notifyContactUpdate->removeListener(service);
+    }
+}
+
+QVariantMap AddressBook::notificationStatistics() const
+{
+    if (m_notifyContactUpdate) {
+        return m_notifyContactUpdate->statistics();
+    }
+    return QVariantMap();
+}
+
+QVariantList AddressBook::startupTimeline() const
+{
+    return m_startupTimeline->toList();
+}
+
+QVariantMap AddressBook::memoryUsage()
+{
+    QVariantMap usage;
+    if (m_contacts) {
+        usage = m_contacts->memoryUsage();
+    }
+    usage.insert("cachedContacts", QIndividual::cachedContacts());
+    usage.insert("contacts", QIndividual::cachedContactsMemory());
+
+    qint64 views = 0;
+    Q_FOREACH(View *view, m_views) {
+        views += view->memoryUsage();
+    }
+    usage.insert("openViews", m_views.size());
+    usage.insert("views", views);
+
+    // the parsers keep a copy of the contacts and the vcards being created
+    int parserContacts = 0;
+    QList<VCardParser*> parsers = findChildren<VCardParser*>();
+    Q_FOREACH(VCardParser *parser, parsers) {
+        parserContacts += parser->property("CONTACTS").toInt();
+    }
+    qint64 averageContact = QIndividual::cachedContactsMemory() / qMax(1, QIndividual::cachedContacts());
+    usage.insert("pendingParsers", parsers.size());
+    usage.insert("parsers", parserContacts * averageContact * 2);
+
+    qint64 total = 0;
+    static const QStringList countKeys = QStringList() << "cachedContacts" << "openViews" << "pendingParsers";
+    QVariantMap::const_iterator i = usage.constBegin();
+    for(; i != usage.constEnd(); i++) {
+        if (!countKeys.contains(i.key())) {
+            total += i.value().toLongLong();
+        }
+    }
+    usage.insert("total", total);
+    usage.insert("budget", memoryBudget());
+    return usage;
+}
+
+qint64 AddressBook::memoryBudget()
+{
+    QByteArray envBudget = qgetenv(ADDRESS_BOOK_MEMORY_BUDGET);
+    if (!envBudget.isEmpty()) {
+        return envBudget.toLongLong() * 1024;
+    } else {
+        return m_settings.value(SETTINGS_MEMORY_BUDGET_KEY, 0).toLongLong() * 1024;
+    }
+}
+
+void AddressBook::checkMemoryBudget()
+{
+    // contacts can be in use by the functions waiting on a nested event loop
+    if (!m_ready || (QThread::currentThread()->loopLevel() > 1)) {
+        return;
+    }
+
+    qint64 budget = memoryBudget();
+    QVariantMap usage = memoryUsage();
+    qint64 total = usage.value("total").toLongLong();
+    if ((budget <= 0) || (total <= budget)) {
+        return;
+    }
+
+    qWarning() << "Memory budget exceeded:" << (total / 1024) << "KiB of" << (budget / 1024) << "KiB";
+    GALERA_STATS_COUNT("MemoryBudget.exceeded", 1);
+
+    // cached query results can be computed again
+    qint64 caches = usage.value("queryCache").toLongLong() + usage.value("phoneLookupCache").toLongLong();
+    m_contacts->releaseCaches();
+    total -= caches;
+    qWarning() << "Released query and phone lookup caches:" << (caches / 1024) << "KiB";
+
+    // close the idle views, the oldest first
+    qint64 idleSince = Stats::now() - (qint64(MEMORY_BUDGET_VIEW_IDLE_TIME) * 1000000);
+    QList<QPair<qint64, View*> > idleViews;
+    Q_FOREACH(View *view, m_views) {
+        if (view->lastAccess() < idleSince) {
+            idleViews << qMakePair(view->lastAccess(), view);
+        }
+    }
+    qSort(idleViews);
+    for(int i = 0; (i < idleViews.size()) && (total > budget); i++) {
+        View *view = idleViews.at(i).second;
+        qint64 viewMemory = view->memoryUsage();
+        qWarning() << "Closing idle view" << view->dynamicObjectPath() << ":" << (viewMemory / 1024) << "KiB";
+        total -= viewMemory;
+        view->close();
+        GALERA_STATS_COUNT("MemoryBudget.viewsClosed", 1);
+    }
+
+    // the contacts will be loaded again from folks when necessary
+    if (total > budget) {
+        qint64 contacts = QIndividual::cachedContactsMemory();
+        int released = m_contacts->releaseContacts();
+        qWarning() << "Released" << released << "cached contacts:"
+                   << ((contacts - QIndividual::cachedContactsMemory()) / 1024) << "KiB";
+        GALERA_STATS_COUNT("MemoryBudget.contactsReleased", released);
+    }
+}
+
+void AddressBook::onAvatarThumbnailsReady(const QStringList &contactIds)
+{
+    if (!m_contacts) {
+        return;
+    }
+
+    // no client fetched the contacts before the service is ready, the contacts are only
+    // rebuilt with the new thumbnails
+    Q_FOREACH(const QString &contactId, contactIds) {
+        ContactEntry *entry = m_contacts->value(contactId);
+        if (entry) {
+            entry->individual()->avatarThumbnailsChanged(m_ready);
+        }
+    }
 }
 
 void AddressBook::individualChanged(QIndividual *individual)
 {
+    // keep the phone and smart dial indexes up to date
+    ContactEntry *entry = m_contacts->value(individual->id());
+    if (entry) {
+        m_contacts->updateIndexes(entry);
+    }
+
     if (individual->isVisible()) {
         m_notifyContactUpdate->insertChangedContacts(QSet<QString>() << individual->id());
+    } else {
+        // the change is not reported, the changed details must not be sent with the next one
+        individual->takeChangedDetailTypes();
     }
 }
 
@@ -1236,6 +1692,7 @@ int AddressBook::removeContacts(const QStringList &contactIds, const QDBusMessag
     data->m_request = contactIds;
     data->m_sucessCount = 0;
     data->m_softRemoval = true;
+    data->m_start = Stats::now();
     removeContactDone(0, 0, data);
     return 0;
 }
@@ -1263,6 +1720,8 @@ void AddressBook::removeContactDone(FolksIndividualAggregator *individualAggrega
         ContactEntry *entry = removeData->m_addressbook->m_contacts->value(contactId);
         if (entry) {
             if (removeData->m_softRemoval && entry->individual()->markAsDeleted()) {
+                // deleted contacts are not returned by the phone lookup
+                removeData->m_addressbook->m_contacts->updateIndexes(entry);
                 removeContactDone(individualAggregator, 0, data);
                 // since this will not be removed we need to send a removal singal
                 removeData->m_addressbook->m_notifyContactUpdate->insertRemovedContacts(QSet<QString>() << entry->individual()->id());
@@ -1278,6 +1737,7 @@ void AddressBook::removeContactDone(FolksIndividualAggregator *individualAggrega
     } else {
         QDBusMessage reply = removeData->m_message.createReply(removeData->m_sucessCount);
         QDBusConnection::sessionBus().send(reply);
+        GALERA_STATS_RECORD("AddressBook.removeContacts.reply", Stats::now() - removeData->m_start);
         delete removeData;
     }
 }
@@ -1310,6 +1770,7 @@ QStringList AddressBook::updateContacts(const QStringList &contacts, const QDBus
     }
 
     m_updatedIds.clear();
+    m_updateCommandStart = Stats::now();
     m_updateCommandReplyMessage = message;
     m_updateCommandResult = contacts;
     m_updateCommandPendingContacts = contacts;
@@ -1382,6 +1843,7 @@ void AddressBook::updateContactsDone(const QString &contactId,
     } else {
         QDBusMessage reply = m_updateCommandReplyMessage.createReply(m_updateCommandResult);
         QDBusConnection::sessionBus().send(reply);
+        GALERA_STATS_RECORD("AddressBook.updateContacts.reply", Stats::now() - m_updateCommandStart);
 
         // notify about the changes
         m_notifyContactUpdate->insertChangedContacts(m_updatedIds.toSet());
@@ -1400,6 +1862,7 @@ QString AddressBook::removeContact(FolksIndividual *individual, bool *visible)
     ContactEntry *ci = m_contacts->take(contactId);
     if (ci) {
         *visible = ci->individual()->isVisible();
+        AvatarStore::instance()->release(contactId);
         delete ci;
         return contactId;
     }
@@ -1432,11 +1895,13 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
                                        AddressBook *self)
 {
     Q_UNUSED(individualAggregator);
+    GALERA_STATS_SCOPE("Folks.individualsChanged");
 
     QSet<QString> removedIds;
     QSet<QString> addedIds;
     QSet<QString> updatedIds;
     QStringList invisibleSources;
+    int batchSize = 0;
 
     if (isSafeMode()) {
         invisibleSources = self->m_settings.value(SETTINGS_INVISIBLE_SOURCES).toStringList();
@@ -1449,6 +1914,7 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
         if (!individual) {
             continue;
         }
+        batchSize++;
 
         bool visible = true;
         QString cId = self->removeContact(individual, &visible);
@@ -1467,6 +1933,7 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
         if (!individual) {
             continue;
         }
+        batchSize++;
 
         QString id = QString::fromUtf8(folks_individual_get_id(individual));
         if (addedIds.contains(id)) {
@@ -1502,6 +1969,9 @@ void AddressBook::individualsChangedCb(FolksIndividualAggregator *individualAggr
     g_object_unref(removed);
     g_object_unref(added);
 
+    GALERA_STATS_RECORD("Folks.individualsChanged.size", batchSize);
+    self->m_startupTimeline->individualsBatch(batchSize);
+
     if (!removedIds.isEmpty()) {
         self->m_notifyContactUpdate->insertRemovedContacts(removedIds);
     }
@@ -1521,7 +1991,7 @@ void AddressBook::prepareFolksDone(GObject *source,
 {
     Q_UNUSED(source);
     Q_UNUSED(res);
-    Q_UNUSED(self);
+    self->m_startupTimeline->mark("aggregatorPrepared");
 }
 
 void AddressBook::createContactDone(FolksIndividualAggregator *individualAggregator,
@@ -1561,6 +2031,7 @@ void AddressBook::createContactDone(FolksIndividualAggregator *individualAggrega
     //TODO: use dbus connection
     if (createData->m_message.type() != QDBusMessage::InvalidMessage) {
         QDBusConnection::sessionBus().send(reply);
+        GALERA_STATS_RECORD("AddressBook.createContact.reply", Stats::now() - createData->m_start);
     }
     delete createData;
 }
@@ -1568,6 +2039,7 @@ void AddressBook::createContactDone(FolksIndividualAggregator *individualAggrega
 void AddressBook::isQuiescentChanged(GObject *source, GParamSpec *param, AddressBook *self)
 {
     Q_UNUSED(param);
+    GALERA_TRACE_SPAN("folks", "AddressBook::isQuiescentChanged");
     gboolean ready = false;
     g_object_get(source, "is-quiescent", &ready, NULL);
     if (self) {
@@ -1581,6 +2053,12 @@ void AddressBook::quitSignalHandler(int)
      ::write(m_sigQuitFd[0], &a, sizeof(a));
 }
 
+void AddressBook::traceSignalHandler(int)
+{
+    char a = 1;
+    ::write(m_sigTraceFd[0], &a, sizeof(a));
+}
+
 bool AddressBook::processUpdates()
 {
     int timeout = 10;
@@ -1606,6 +2084,15 @@ int AddressBook::init()
     if (sigaction(SIGQUIT, &quit, 0) > 0)
         return 1;
 
+    // dump the trace buffer
+    struct sigaction trace = { { 0 } };
+    trace.sa_handler = AddressBook::traceSignalHandler;
+    sigemptyset(&trace.sa_mask);
+    trace.sa_flags |= SA_RESTART;
+
+    if (sigaction(SIGUSR1, &trace, 0) > 0)
+        return 1;
+
     return 0;
 }
 
@@ -1617,6 +2104,13 @@ void AddressBook::prepareUnixSignals()
 
     m_snQuit = new QSocketNotifier(m_sigQuitFd[1], QSocketNotifier::Read, this);
     connect(m_snQuit, SIGNAL(activated(int)), this, SLOT(handleSigQuit()));
+
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, m_sigTraceFd)) {
+       qFatal("Couldn't create USR1 socketpair");
+    }
+
+    m_snTrace = new QSocketNotifier(m_sigTraceFd[1], QSocketNotifier::Read, this);
+    connect(m_snTrace, SIGNAL(activated(int)), this, SLOT(handleSigTrace()));
 }
 
 void AddressBook::handleSigQuit()
@@ -1630,6 +2124,20 @@ void AddressBook::handleSigQuit()
     m_snQuit->setEnabled(true);
 }
 
+void AddressBook::handleSigTrace()
+{
+    m_snTrace->setEnabled(false);
+    char tmp;
+    ::read(m_sigTraceFd[1], &tmp, sizeof(tmp));
+
+    if (!Trace::isEnabled()) {
+        qWarning() << "Tracing disabled, build the service with ENABLE_TRACING";
+    }
+    qDebug() << "Trace saved on" << Trace::dumpToFile();
+
+    m_snTrace->setEnabled(true);
+}
+
 // WORKAROUND: For some strange reason sometimes EDS does not start with the service request
 // we will try to reload folks if this happen
 void AddressBook::checkForEds()
@@ -1643,6 +2151,10 @@ void AddressBook::checkForEds()
     static int retryCount = 0;
 
     qDebug() << "Check for EDS attempt number " << retryCount;
+    QVariantMap details;
+    details.insert("attempt", retryCount);
+    details.insert("edsIsLive", m_edsIsLive);
+    m_startupTimeline->mark("checkForEds", details);
     if (retryCount >= maxRetry) {
         // abort when reach the maxRetry
         qWarning() << QDateTime::currentDateTime().toString() << "Fail to start EDS the service will abort";
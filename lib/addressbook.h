@@ -25,7 +25,11 @@
 #include <QtCore/QSet>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
+#include <QtCore/QHash>
 #include <QtCore/QSettings>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QTimer>
+#include <QtCore/QWeakPointer>
 
 #include <QtDBus/QtDBus>
 
@@ -43,8 +47,11 @@ typedef struct _ESourceRegistry ESourceRegistry;
 namespace galera
 {
 class View;
+class FilterThread;
 class ContactsMap;
 class AddressBookAdaptor;
+class StatsAdaptor;
+class StartupTimeline;
 class QIndividual;
 class DirtyContactsNotify;
 
@@ -60,13 +67,29 @@ public:
 
     // Adaptor
     QString linkContacts(const QStringList &contacts);
-    View *query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources);
+    // views created for a client are closed when it leaves the bus
+    View *query(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources,
+                const QString &client = QString());
+    void queryIds(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources, const QDBusMessage &message);
+    View *queryFirstPage(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources,
+                         const QStringList &fields, int pageSize, const QDBusMessage &message);
+    void contactsByIds(const QStringList &ids, const QStringList &fields, const QDBusMessage &message);
+    void lookupPhone(const QString &phone, const QStringList &fields, const QDBusMessage &message);
+    QStringList smartDial(const QString &digits, int maxCount);
     QStringList sortFields();
     bool unlinkContacts(const QString &parent, const QStringList &contacts);
     bool isReady() const;
     void setSafeMode(bool flag);
+    void registerChangesListener(const QString &service, const QStringList &fields, bool includeContacts);
+    void unregisterChangesListener(const QString &service);
+    QVariantMap notificationStatistics() const;
+    QVariantList startupTimeline() const;
+    // estimated memory used by each structure in bytes
+    QVariantMap memoryUsage();
 
     static bool isSafeMode();
+    // memory budget in bytes, 0 if disabled
+    static qint64 memoryBudget();
     static int init();
 
 Q_SIGNALS:
@@ -91,12 +114,21 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void viewClosed();
+    void queryIdsDone();
+    void contactsByIdsDone(const QStringList &vcards);
     void individualChanged(QIndividual *individual);
     void onEdsServiceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner);
     void onSafeModeChanged();
+    // release caches and idle views if the memory budget is exceeded
+    void checkMemoryBudget();
+    // close the views idle for too long and release the closed ones
+    void reapViews();
+    void onClientUnregistered(const QString &client);
+    void onAvatarThumbnailsReady(const QStringList &contactIds);
 
     // Unix signal handlers.
     void handleSigQuit();
+    void handleSigTrace();
 
     // WORKAROUND: Check if EDS was running when the service started
     void checkForEds();
@@ -105,11 +137,25 @@ private Q_SLOTS:
     // check compatibility and if the safe mode should be enabled
     void checkCompatibility();
 
+    QSharedPointer<FilterThread> sharedFilter(const QString &clause, const QString &sort, int maxCount,
+                                              bool showInvisible, const QStringList &sources);
+
 private:
     FolksIndividualAggregator *m_individualAggregator;
     ContactsMap *m_contacts;
     QSet<View*> m_views;
+    // open views of each D-Bus client
+    QMultiHash<QString, View*> m_clientViews;
+    // closed views waiting to be released
+    QSet<View*> m_closedViews;
+    QDBusServiceWatcher *m_clientWatcher;
+    QTimer m_reapViewsTimer;
+    // filter results shared by the views with the same query
+    QHash<QString, QWeakPointer<FilterThread> > m_filterThreads;
     AddressBookAdaptor *m_adaptor;
+    StatsAdaptor *m_statsAdaptor;
+    StartupTimeline *m_startupTimeline;
+    QTimer m_memoryBudgetTimer;
     // timer to avoid send several updates at the same time
     DirtyContactsNotify *m_notifyContactUpdate;
     QDBusServiceWatcher *m_edsWatcher;
@@ -129,6 +175,7 @@ private:
     // Update command
     QMutex m_updateLock;
     QDBusMessage m_updateCommandReplyMessage;
+    qint64 m_updateCommandStart;
     QStringList m_updateCommandResult;
     QStringList m_updatedIds;
     QStringList m_updateCommandPendingContacts;
@@ -136,6 +183,8 @@ private:
     // Unix signals
     static int m_sigQuitFd[2];
     QSocketNotifier *m_snQuit;
+    static int m_sigTraceFd[2];
+    QSocketNotifier *m_snTrace;
 
     // dbus service name
     QString m_serviceName;
@@ -150,6 +199,7 @@ private:
     // Unix signal handlers.
     void prepareUnixSignals();
     static void quitSignalHandler(int unused);
+    static void traceSignalHandler(int unused);
 
     bool processUpdates();
     void prepareFolks();
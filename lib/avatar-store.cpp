@@ -0,0 +1,332 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avatar-store.h"
+#include "stats.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+
+// "GAVS"
+#define AVATAR_INDEX_MAGIC          0x47415653
+#define AVATAR_INDEX_VERSION        1
+#define AVATAR_INDEX_FILE           "index"
+// delay in ms to save the index after a change, the changes usually come in batches
+#define AVATAR_INDEX_SAVE_DELAY     5000
+// delay in ms to remove the avatars without contacts, a contact being linked or
+// moved is removed and added again
+#define AVATAR_COLLECT_DELAY        60000
+// block size used to read the avatar files
+#define AVATAR_READ_BLOCK_SIZE      65536
+
+namespace galera
+{
+
+AvatarStore::AvatarStore()
+    : m_dirty(false)
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(AVATAR_INDEX_SAVE_DELAY);
+    connect(&m_saveTimer, SIGNAL(timeout()), SLOT(save()));
+
+    m_collectTimer.setSingleShot(true);
+    m_collectTimer.setInterval(AVATAR_COLLECT_DELAY);
+    connect(&m_collectTimer, SIGNAL(timeout()), SLOT(collect()));
+
+    load();
+}
+
+AvatarStore::~AvatarStore()
+{
+    Q_FOREACH(const ContactAvatar &avatar, m_contacts) {
+        if (avatar.bytes) {
+            g_bytes_unref(avatar.bytes);
+        }
+    }
+}
+
+AvatarStore *AvatarStore::instance()
+{
+    static AvatarStore *self = new AvatarStore;
+    return self;
+}
+
+QString AvatarStore::storeDir()
+{
+    return QString("%1/address-book-service/avatars/store")
+            .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation));
+}
+
+QString AvatarStore::fileName(const QString &hash)
+{
+    return QString("%1/%2").arg(storeDir()).arg(hash);
+}
+
+QString AvatarStore::store(const QString &contactId, GBytes *avatar)
+{
+    QMutexLocker locker(&m_lock);
+    QHash<QString, ContactAvatar>::iterator i = m_contacts.find(contactId);
+    // the same avatar of the last call, nothing to check
+    if ((i != m_contacts.end()) && (i->bytes == avatar)) {
+        return QUrl::fromLocalFile(fileName(i->hash)).toString();
+    }
+
+    gsize size = 0;
+    const char *data = static_cast<const char*>(g_bytes_get_data(avatar, &size));
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(QByteArray::fromRawData(data, size),
+                                                                QCryptographicHash::Sha1).toHex());
+    // a new persona with the same photo, Eg. after a sync
+    if ((i != m_contacts.end()) && (i->hash == hash)) {
+        // the contacts loaded from the index do not have the bytes yet
+        if (i->bytes) {
+            g_bytes_unref(i->bytes);
+        }
+        i->bytes = g_bytes_ref(avatar);
+        GALERA_STATS_COUNT("AvatarStore.unchanged", 1);
+        return QUrl::fromLocalFile(fileName(hash)).toString();
+    }
+
+    QString avatarFile = fileName(hash);
+    if (m_refs.value(hash, 0) > 0 || QFile::exists(avatarFile)) {
+        GALERA_STATS_COUNT("AvatarStore.deduplicated", 1);
+    } else {
+        QDir().mkpath(storeDir());
+        QSaveFile file(avatarFile);
+        if (!file.open(QIODevice::WriteOnly) ||
+            (file.write(data, size) != qint64(size)) ||
+            !file.commit()) {
+            // the bytes are not kept, the next call with the same avatar tries again
+            qWarning() << "Fail to store avatar" << avatarFile << file.errorString();
+            return QString();
+        }
+        GALERA_STATS_COUNT("AvatarStore.written", 1);
+    }
+
+    if (i == m_contacts.end()) {
+        i = m_contacts.insert(contactId, ContactAvatar());
+    }
+    if (i->bytes) {
+        g_bytes_unref(i->bytes);
+    }
+    i->bytes = g_bytes_ref(avatar);
+    if (!i->hash.isEmpty()) {
+        unref(i->hash);
+    }
+    i->hash = hash;
+    m_refs[hash]++;
+    m_garbage.remove(hash);
+    m_dirty = true;
+    QMetaObject::invokeMethod(this, "scheduleSave");
+    return QUrl::fromLocalFile(avatarFile).toString();
+}
+
+void AvatarStore::release(const QString &contactId)
+{
+    QMutexLocker locker(&m_lock);
+    ContactAvatar avatar = m_contacts.take(contactId);
+    if (avatar.bytes) {
+        g_bytes_unref(avatar.bytes);
+    }
+    if (!avatar.hash.isEmpty()) {
+        unref(avatar.hash);
+        m_dirty = true;
+        QMetaObject::invokeMethod(this, "scheduleSave");
+    }
+}
+
+void AvatarStore::prune(const QStringList &contactIds)
+{
+    QSet<QString> removed;
+    {
+        QMutexLocker locker(&m_lock);
+        removed = m_contacts.keys().toSet().subtract(contactIds.toSet());
+    }
+    Q_FOREACH(const QString &contactId, removed) {
+        release(contactId);
+    }
+}
+
+void AvatarStore::unref(const QString &hash)
+{
+    QHash<QString, int>::iterator i = m_refs.find(hash);
+    if (i == m_refs.end()) {
+        return;
+    }
+    if (--i.value() <= 0) {
+        m_refs.erase(i);
+        m_garbage << hash;
+        QMetaObject::invokeMethod(this, "scheduleCollect");
+    }
+}
+
+bool AvatarStore::sameContent(const QUrl &fileA, const QUrl &fileB)
+{
+    if (!fileA.isLocalFile() || !fileB.isLocalFile()) {
+        return false;
+    }
+
+    QFileInfo infoA(fileA.toLocalFile());
+    QFileInfo infoB(fileB.toLocalFile());
+    if (!infoA.isFile() || !infoB.isFile() || (infoA.size() != infoB.size())) {
+        return false;
+    }
+
+    // the stored avatars are named by the hash of their content, only the other file is read
+    QString dir = QDir(storeDir()).absolutePath();
+    if (infoA.absolutePath() == dir) {
+        return (fileHash(infoB.absoluteFilePath()) == infoA.fileName());
+    }
+    if (infoB.absolutePath() == dir) {
+        return (fileHash(infoA.absoluteFilePath()) == infoB.fileName());
+    }
+
+    QFile a(infoA.absoluteFilePath());
+    QFile b(infoB.absoluteFilePath());
+    if (!a.open(QIODevice::ReadOnly) || !b.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // compare by blocks, this stops on the first difference and does not load the whole photos
+    while (!a.atEnd()) {
+        if (a.read(AVATAR_READ_BLOCK_SIZE) != b.read(AVATAR_READ_BLOCK_SIZE)) {
+            return false;
+        }
+    }
+    return b.atEnd();
+}
+
+QString AvatarStore::fileHash(const QString &fileName)
+{
+    QFile file(fileName);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    while (!file.atEnd()) {
+        hash.addData(file.read(AVATAR_READ_BLOCK_SIZE));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+void AvatarStore::scheduleSave()
+{
+    if (!m_saveTimer.isActive()) {
+        m_saveTimer.start();
+    }
+}
+
+void AvatarStore::scheduleCollect()
+{
+    if (!m_collectTimer.isActive()) {
+        m_collectTimer.start();
+    }
+}
+
+void AvatarStore::flush()
+{
+    m_saveTimer.stop();
+    save();
+}
+
+void AvatarStore::load()
+{
+    QFile file(fileName(AVATAR_INDEX_FILE));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    qint32 version = 0;
+    stream >> magic >> version;
+    if ((magic != AVATAR_INDEX_MAGIC) || (version != AVATAR_INDEX_VERSION)) {
+        qWarning() << "Invalid avatar store index" << file.fileName();
+        return;
+    }
+
+    QHash<QString, QString> index;
+    stream >> index;
+    QHash<QString, QString>::const_iterator i = index.constBegin();
+    for(; i != index.constEnd(); i++) {
+        ContactAvatar avatar;
+        avatar.hash = i.value();
+        m_contacts.insert(i.key(), avatar);
+        m_refs[i.value()]++;
+    }
+
+    // remove the avatars left by a previous session without contacts
+    QDir dir(storeDir());
+    Q_FOREACH(const QString &hash, dir.entryList(QDir::Files)) {
+        if ((hash != AVATAR_INDEX_FILE) && !m_refs.contains(hash)) {
+            dir.remove(hash);
+        }
+    }
+}
+
+void AvatarStore::save()
+{
+    QHash<QString, QString> index;
+    {
+        QMutexLocker locker(&m_lock);
+        if (!m_dirty) {
+            return;
+        }
+        QHash<QString, ContactAvatar>::const_iterator i = m_contacts.constBegin();
+        for(; i != m_contacts.constEnd(); i++) {
+            index.insert(i.key(), i->hash);
+        }
+        m_dirty = false;
+    }
+
+    QDir().mkpath(storeDir());
+    QSaveFile file(fileName(AVATAR_INDEX_FILE));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Fail to save avatar store index" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint32(AVATAR_INDEX_MAGIC) << qint32(AVATAR_INDEX_VERSION) << index;
+    if (!file.commit()) {
+        qWarning() << "Fail to save avatar store index" << file.fileName() << file.errorString();
+    }
+}
+
+void AvatarStore::collect()
+{
+    QMutexLocker locker(&m_lock);
+    Q_FOREACH(const QString &hash, m_garbage) {
+        // used again since it was released
+        if (m_refs.contains(hash)) {
+            continue;
+        }
+        if (QFile::remove(fileName(hash))) {
+            GALERA_STATS_COUNT("AvatarStore.collected", 1);
+        }
+    }
+    m_garbage.clear();
+}
+
+}
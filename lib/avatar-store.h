@@ -0,0 +1,97 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_AVATAR_STORE_H__
+#define __GALERA_AVATAR_STORE_H__
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+
+#include <glib.h>
+
+namespace galera
+{
+
+// Content addressed storage of the avatars that are not files (Eg. photos inlined on the vcard).
+// Each avatar is saved once, named by the hash of its content, and shared by all contacts
+// with the same photo. The contacts using each avatar are saved on an index file, the avatars
+// are removed when the last contact using them is removed.
+// Must be created on the main thread, the other functions are thread safe.
+class AvatarStore : public QObject
+{
+    Q_OBJECT
+public:
+    static AvatarStore *instance();
+    static QString storeDir();
+
+    // url of the stored avatar, the content is only written if it is not in the store yet;
+    // returns an empty string if the avatar can not be saved
+    QString store(const QString &contactId, GBytes *avatar);
+    // the contact was removed, its avatar is removed if no other contact uses it
+    void release(const QString &contactId);
+    // release the contacts that do not exist anymore
+    void prune(const QStringList &contactIds);
+    // save the index now
+    void flush();
+
+    // compare the content of two local files, a stored avatar is compared by its hash
+    static bool sameContent(const QUrl &fileA, const QUrl &fileB);
+
+private Q_SLOTS:
+    void scheduleSave();
+    void scheduleCollect();
+    void save();
+    void collect();
+
+private:
+    struct ContactAvatar {
+        ContactAvatar() : bytes(0) {}
+
+        // last content stored by the contact, used to skip the unchanged avatars
+        GBytes *bytes;
+        QString hash;
+    };
+
+    QMutex m_lock;
+    QHash<QString, ContactAvatar> m_contacts;
+    // number of contacts using each avatar
+    QHash<QString, int> m_refs;
+    // avatars without contacts, removed by collect
+    QSet<QString> m_garbage;
+    QTimer m_saveTimer;
+    QTimer m_collectTimer;
+    bool m_dirty;
+
+    AvatarStore();
+    ~AvatarStore();
+
+    void load();
+    void unref(const QString &hash);
+    static QString fileName(const QString &hash);
+    static QString fileHash(const QString &fileName);
+};
+
+}
+
+#endif
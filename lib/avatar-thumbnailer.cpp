@@ -0,0 +1,359 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "avatar-thumbnailer.h"
+#include "stats.h"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QThreadPool>
+#include <QtCore/QUrl>
+
+#include <QtGui/QImage>
+#include <QtGui/QImageReader>
+
+#define AVATAR_THUMBNAILS_INDEX_MAGIC       0x47415448
+#define AVATAR_THUMBNAILS_INDEX_VERSION     1
+#define AVATAR_THUMBNAILS_INDEX_FILE        "index"
+// save the index some time after the last change, the renditions are generated in bursts
+#define AVATAR_THUMBNAILS_SAVE_DELAY        5000
+
+namespace
+{
+
+// private pool with a single thread, the thumbnails should not compete with the filter threads
+Q_GLOBAL_STATIC(QThreadPool, thumbnailerPool)
+
+class AvatarThumbnailJob : public QRunnable
+{
+public:
+    // source is the avatar file info of the previous generation (see AvatarThumbnailer::m_sources)
+    AvatarThumbnailJob(const QString &avatarUrl, const QVariantMap &source)
+        : m_avatarUrl(avatarUrl),
+          m_source(source)
+    {
+    }
+
+    void run()
+    {
+        QVariantMap thumbnails = generate();
+        QMetaObject::invokeMethod(galera::AvatarThumbnailer::instance(), "onThumbnailsDone", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_avatarUrl),
+                                  Q_ARG(QVariantMap, thumbnails),
+                                  Q_ARG(QVariantMap, m_source));
+    }
+
+private:
+    QString m_avatarUrl;
+    QVariantMap m_source;
+
+    // renditions keyed by size, empty if the avatar file does not exist yet or can not be decoded
+    QVariantMap generate()
+    {
+        GALERA_STATS_SCOPE("AvatarThumbnailer.generate");
+
+        QFileInfo info(QUrl(m_avatarUrl).toLocalFile());
+        if (info.filePath().isEmpty() || !info.exists()) {
+            m_source.clear();
+            return QVariantMap();
+        }
+
+        // the file did not change since the renditions were generated
+        qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        if ((m_source.value("size").toLongLong() == info.size()) &&
+            (m_source.value("modified").toLongLong() == modified)) {
+            QVariantMap thumbnails = galera::AvatarThumbnailer::thumbnailsFromHash(m_source.value("hash").toString());
+            bool complete = true;
+            Q_FOREACH(const QVariant &thumbnail, thumbnails) {
+                complete &= QFile::exists(QUrl(thumbnail.toString()).toLocalFile());
+            }
+            if (complete) {
+                GALERA_STATS_COUNT("AvatarThumbnailer.unchanged", 1);
+                return thumbnails;
+            }
+        }
+
+        QFile file(info.filePath());
+        QVariantMap thumbnails;
+        m_source.clear();
+        if (!file.open(QIODevice::ReadOnly)) {
+            return thumbnails;
+        }
+        QByteArray data = file.readAll();
+        file.close();
+
+        QDir dir(galera::AvatarThumbnailer::cacheDir());
+        if (!dir.mkpath(".")) {
+            qWarning() << "Fail to create avatar thumbnails dir" << dir.path();
+            return thumbnails;
+        }
+
+        QString hash = QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+        QList<int> sizes = galera::AvatarThumbnailer::sizes();
+        QImage image;
+        // from the biggest to the smallest, this way the avatar is only decoded once
+        for(int i = sizes.size() - 1; i >= 0; i--) {
+            int size = sizes.at(i);
+            QString fileName = dir.filePath(QString("%1-%2.png").arg(hash).arg(size));
+            if (!QFile::exists(fileName)) {
+                if (image.isNull()) {
+                    QBuffer buffer(&data);
+                    QImageReader reader(&buffer);
+                    QSize imageSize = reader.size();
+                    // some formats (Eg. jpeg) can decode a scaled image faster than the full image
+                    if (imageSize.isValid() && (qMin(imageSize.width(), imageSize.height()) > size)) {
+                        reader.setScaledSize(imageSize.scaled(size, size, Qt::KeepAspectRatioByExpanding));
+                    }
+                    image = reader.read();
+                    if (image.isNull()) {
+                        qWarning() << "Fail to decode avatar" << m_avatarUrl << reader.errorString();
+                        return QVariantMap();
+                    }
+                }
+
+                // fill the whole square, the avatars are usually cropped in a circle
+                if (qMin(image.width(), image.height()) > size) {
+                    image = image.scaled(size, size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+                }
+                QSaveFile thumbnail(fileName);
+                if (!thumbnail.open(QIODevice::WriteOnly) ||
+                    !image.save(&thumbnail, "PNG") ||
+                    !thumbnail.commit()) {
+                    qWarning() << "Fail to save avatar thumbnail" << fileName;
+                    continue;
+                }
+                GALERA_STATS_COUNT("AvatarThumbnailer.renditions", 1);
+            }
+            thumbnails.insert(QString::number(size), QUrl::fromLocalFile(fileName).toString());
+        }
+
+        if (!thumbnails.isEmpty()) {
+            m_source.insert("hash", hash);
+            m_source.insert("size", info.size());
+            m_source.insert("modified", modified);
+        }
+        return thumbnails;
+    }
+};
+
+}
+
+namespace galera
+{
+
+AvatarThumbnailer::AvatarThumbnailer()
+    : m_dirty(false)
+{
+    thumbnailerPool()->setMaxThreadCount(1);
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(AVATAR_THUMBNAILS_SAVE_DELAY);
+    connect(&m_saveTimer, SIGNAL(timeout()), SLOT(save()));
+
+    load();
+}
+
+AvatarThumbnailer *AvatarThumbnailer::instance()
+{
+    static AvatarThumbnailer *self = new AvatarThumbnailer;
+    return self;
+}
+
+QList<int> AvatarThumbnailer::sizes()
+{
+    static const QList<int> thumbnailSizes = QList<int>() << 48 << 96 << 256;
+    return thumbnailSizes;
+}
+
+QString AvatarThumbnailer::cacheDir()
+{
+    return QString("%1/address-book-service/avatars/thumbnails")
+            .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation));
+}
+
+QVariantMap AvatarThumbnailer::thumbnails(const QString &avatarUrl, const QString &contactId)
+{
+    QMutexLocker locker(&m_lock);
+    QHash<QString, Avatar>::iterator i = m_avatars.find(avatarUrl);
+    if (i == m_avatars.end()) {
+        // use the renditions of the previous session, the job only checks if they are still valid
+        Avatar avatar;
+        avatar.thumbnails = thumbnailsFromHash(m_sources.value(avatarUrl).value("hash").toString());
+        i = m_avatars.insert(avatarUrl, avatar);
+        start(avatarUrl);
+    }
+    if (!i->contacts.contains(contactId)) {
+        i->contacts << contactId;
+        m_contactAvatars.insert(contactId, avatarUrl);
+    }
+    return i->thumbnails;
+}
+
+void AvatarThumbnailer::invalidateContact(const QString &contactId)
+{
+    QMutexLocker locker(&m_lock);
+    Q_FOREACH(const QString &avatarUrl, m_contactAvatars.values(contactId)) {
+        QHash<QString, Avatar>::iterator i = m_avatars.find(avatarUrl);
+        if (i == m_avatars.end()) {
+            continue;
+        }
+        // the contact will request the avatar again when rebuilt
+        i->contacts.remove(contactId);
+        if (i->contacts.isEmpty()) {
+            m_avatars.erase(i);
+        } else {
+            start(avatarUrl);
+        }
+    }
+    m_contactAvatars.remove(contactId);
+}
+
+void AvatarThumbnailer::refresh(const QString &avatarUrl)
+{
+    QMutexLocker locker(&m_lock);
+    QHash<QString, Avatar>::iterator i = m_avatars.find(avatarUrl);
+    if (i != m_avatars.end()) {
+        start(avatarUrl);
+    }
+}
+
+void AvatarThumbnailer::start(const QString &avatarUrl)
+{
+    thumbnailerPool()->start(new AvatarThumbnailJob(avatarUrl, m_sources.value(avatarUrl)));
+}
+
+void AvatarThumbnailer::onThumbnailsDone(const QString &avatarUrl, const QVariantMap &thumbnails, const QVariantMap &source)
+{
+    QStringList contacts;
+    {
+        QMutexLocker locker(&m_lock);
+        if (m_sources.value(avatarUrl) != source) {
+            if (source.isEmpty()) {
+                m_sources.remove(avatarUrl);
+            } else {
+                m_sources.insert(avatarUrl, source);
+            }
+            m_dirty = true;
+            if (!m_saveTimer.isActive()) {
+                m_saveTimer.start();
+            }
+        }
+
+        QHash<QString, Avatar>::iterator i = m_avatars.find(avatarUrl);
+        // invalidated while the renditions were being generated
+        if (i == m_avatars.end()) {
+            return;
+        }
+
+        if (i->thumbnails != thumbnails) {
+            i->thumbnails = thumbnails;
+            contacts = i->contacts.toList();
+        }
+    }
+
+    if (!contacts.isEmpty()) {
+        Q_EMIT thumbnailsReady(contacts);
+    }
+}
+
+void AvatarThumbnailer::flush()
+{
+    m_saveTimer.stop();
+    save();
+}
+
+QVariantMap AvatarThumbnailer::thumbnailsFromHash(const QString &hash)
+{
+    QVariantMap thumbnails;
+    if (hash.isEmpty()) {
+        return thumbnails;
+    }
+
+    QDir dir(cacheDir());
+    Q_FOREACH(int size, sizes()) {
+        QString fileName = dir.filePath(QString("%1-%2.png").arg(hash).arg(size));
+        thumbnails.insert(QString::number(size), QUrl::fromLocalFile(fileName).toString());
+    }
+    return thumbnails;
+}
+
+QString AvatarThumbnailer::indexFileName()
+{
+    return QDir(cacheDir()).filePath(AVATAR_THUMBNAILS_INDEX_FILE);
+}
+
+void AvatarThumbnailer::load()
+{
+    QFile file(indexFileName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    qint32 version = 0;
+    stream >> magic >> version;
+    if ((magic != AVATAR_THUMBNAILS_INDEX_MAGIC) || (version != AVATAR_THUMBNAILS_INDEX_VERSION)) {
+        qWarning() << "Invalid avatar thumbnails index" << file.fileName();
+        return;
+    }
+    stream >> m_sources;
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Invalid avatar thumbnails index" << file.fileName();
+        m_sources.clear();
+    }
+}
+
+void AvatarThumbnailer::save()
+{
+    QHash<QString, QVariantMap> index;
+    {
+        QMutexLocker locker(&m_lock);
+        if (!m_dirty) {
+            return;
+        }
+        index = m_sources;
+        m_dirty = false;
+    }
+
+    QDir().mkpath(cacheDir());
+    QSaveFile file(indexFileName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Fail to save avatar thumbnails index" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << quint32(AVATAR_THUMBNAILS_INDEX_MAGIC) << qint32(AVATAR_THUMBNAILS_INDEX_VERSION) << index;
+    if (!file.commit()) {
+        qWarning() << "Fail to save avatar thumbnails index" << file.fileName() << file.errorString();
+    }
+}
+
+}
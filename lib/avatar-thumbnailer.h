@@ -0,0 +1,95 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_AVATAR_THUMBNAILER_H__
+#define __GALERA_AVATAR_THUMBNAILER_H__
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <QtCore/QVariantMap>
+
+namespace galera
+{
+
+// Generates downscaled renditions of the contact avatars on a background thread.
+// The renditions are saved on the cache dir named by the hash of the avatar content,
+// this way the avatars shared by several contacts are only scaled once.
+// The hash, size and modification time of each avatar are saved on an index file, the
+// renditions of a previous session are returned right away and only validated by the
+// background thread. The file system is only checked by the background thread.
+// Must be created on the main thread, the other functions are thread safe.
+class AvatarThumbnailer : public QObject
+{
+    Q_OBJECT
+public:
+    // must be created on the main thread before any call to thumbnails
+    static AvatarThumbnailer *instance();
+    // sizes of the renditions in pixels
+    static QList<int> sizes();
+    static QString cacheDir();
+    // urls of the renditions of the avatar content with the given hash
+    static QVariantMap thumbnailsFromHash(const QString &hash);
+
+    // urls of the renditions of the avatar keyed by size, an empty map means that the
+    // renditions are not ready yet, thumbnailsReady is emitted when they get ready
+    QVariantMap thumbnails(const QString &avatarUrl, const QString &contactId);
+    // the avatars of the contact changed, the renditions will be generated again
+    void invalidateContact(const QString &contactId);
+    // the content of the avatar file was written, generate the renditions again
+    void refresh(const QString &avatarUrl);
+    // save the index now
+    void flush();
+
+Q_SIGNALS:
+    // renditions used by the contacts changed
+    void thumbnailsReady(const QStringList &contactIds);
+
+private Q_SLOTS:
+    void onThumbnailsDone(const QString &avatarUrl, const QVariantMap &thumbnails, const QVariantMap &source);
+    void save();
+
+private:
+    struct Avatar {
+        QVariantMap thumbnails;
+        // contacts using the avatar
+        QSet<QString> contacts;
+    };
+
+    QMutex m_lock;
+    QHash<QString, Avatar> m_avatars;
+    QMultiHash<QString, QString> m_contactAvatars;
+    // hash, size and modification time of the avatar files, saved on the index
+    QHash<QString, QVariantMap> m_sources;
+    QTimer m_saveTimer;
+    bool m_dirty;
+
+    AvatarThumbnailer();
+    void start(const QString &avatarUrl);
+    void load();
+    static QString indexFileName();
+};
+
+}
+
+#endif
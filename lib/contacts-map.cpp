@@ -19,9 +19,14 @@
 #include "contact-less-than.h"
 #include "contacts-map.h"
 #include "qindividual.h"
+#include "memory-usage.h"
+#include "stats.h"
+
+#include "common/filter.h"
 
 #include <QtCore/QDebug>
 
+#include <QtContacts/QContactManagerEngine>
 #include <QtContacts/QContactSortOrder>
 #include <QtContacts/QContactDisplayLabel>
 #include <QtContacts/QContactTag>
@@ -30,11 +35,71 @@
 #include <phonenumbers/phonenumberutil.h>
 #include <phonenumbers/region_code.h>
 
+#include <algorithm>
+
+// number of phone lookups memoized
+#define CONTACTS_MAP_PHONE_LOOKUP_CACHE_SIZE    128
+// number of query results kept to refine new queries
+#define CONTACTS_MAP_QUERY_CACHE_SIZE           4
+
 using namespace QtContacts;
 
 namespace galera
 {
 
+// QWriteLocker that keeps the time spent waiting for the lock
+class ContactsMapWriteLocker
+{
+public:
+    ContactsMapWriteLocker(QReadWriteLock *lock)
+        : m_lock(lock)
+    {
+        GALERA_STATS_SCOPE("ContactsMap.writeLockWait");
+        m_lock->lockForWrite();
+    }
+
+    ~ContactsMapWriteLocker()
+    {
+        m_lock->unlock();
+    }
+
+private:
+    QReadWriteLock *m_lock;
+};
+
+// order the smart dial matches by match position and then by the map sort clause
+typedef QPair<ContactEntry*, int> SmartDialMatch;
+
+class SmartDialLessThan
+{
+public:
+    SmartDialLessThan(const SortClause &sortClause)
+        : m_sortOrders(sortClause.toContactSortOrder())
+    {
+    }
+
+    bool operator()(const SmartDialMatch &matchA, const SmartDialMatch &matchB) const
+    {
+        if (matchA.second != matchB.second) {
+            return matchA.second < matchB.second;
+        }
+
+        QIndividual *individualA = matchA.first->individual();
+        QIndividual *individualB = matchB.first->individual();
+        int r = QContactManagerEngine::compareContact(individualA->contact(),
+                                                      individualB->contact(),
+                                                      m_sortOrders);
+        if (r != 0) {
+            return r < 0;
+        }
+        // keep the result stable for contacts with the same sort keys
+        return individualA->id() < individualB->id();
+    }
+
+private:
+    QList<QContactSortOrder> m_sortOrders;
+};
+
 //ContactInfo
 ContactEntry::ContactEntry(QIndividual *individual)
     : m_individual(individual)
@@ -54,7 +119,10 @@ QIndividual *ContactEntry::individual() const
 
 //ContactMap
 ContactsMap::ContactsMap()
-    : m_sortClause(defaultSort())
+    : m_sortClause(defaultSort()),
+      m_phoneLookupCache(CONTACTS_MAP_PHONE_LOOKUP_CACHE_SIZE),
+      m_queryCache(CONTACTS_MAP_QUERY_CACHE_SIZE),
+      m_generation(0)
 {
 }
 
@@ -77,6 +145,105 @@ QList<ContactEntry *> ContactsMap::valueByPhone(const QString &phone) const
     return m_phoneToEntry.values(minimalNumber(phone));
 }
 
+QString ContactsMap::lookupPhone(const QString &phone)
+{
+    QString number = Filter::normalizePhoneNumber(phone);
+    if (number.isEmpty()) {
+        return QString();
+    }
+
+    // keep writers out while the candidates are checked, otherwise a result computed
+    // before a change could be cached after it
+    QReadLocker locker(&m_mutex);
+    QMutexLocker cacheLocker(&m_phoneLookupLock);
+    QString *cached = m_phoneLookupCache.object(number);
+    if (cached) {
+        return *cached;
+    }
+
+    // the phone index returns all contacts with the same suffix, use libphonenumber to find the best match
+    QString bestId;
+    int bestMatch = i18n::phonenumbers::PhoneNumberUtil::NO_MATCH;
+    Q_FOREACH(ContactEntry *entry, valueByPhone(phone)) {
+        QIndividual *individual = entry->individual();
+        if (!individual->isVisible() || individual->deletedAt().isValid()) {
+            continue;
+        }
+
+        Q_FOREACH(const QString &contactNumber, individual->normalizedPhoneNumbers()) {
+            int match = i18n::phonenumbers::PhoneNumberUtil::NO_MATCH;
+            if (contactNumber == number) {
+                match = i18n::phonenumbers::PhoneNumberUtil::EXACT_MATCH;
+            } else if ((contactNumber.length() >= 6) && (number.length() >= 6)) {
+                // short numbers only match exactly, same rule used by the filter
+                match = Filter::matchPhoneNumbers(number, contactNumber);
+            }
+
+            if (match > bestMatch) {
+                bestMatch = match;
+                bestId = individual->id();
+            }
+        }
+
+        if (bestMatch == i18n::phonenumbers::PhoneNumberUtil::EXACT_MATCH) {
+            break;
+        }
+    }
+
+    // same key used by valueByPhone
+    QString key = number.right(7);
+    if (!m_phoneLookupKeys.contains(key, number)) {
+        m_phoneLookupKeys.insert(key, number);
+    }
+    m_phoneLookupCache.insert(number, new QString(bestId));
+    if (m_phoneLookupKeys.size() > (m_phoneLookupCache.maxCost() * 2)) {
+        // forget the numbers evicted from the cache
+        QMultiHash<QString, QString>::iterator it = m_phoneLookupKeys.begin();
+        while (it != m_phoneLookupKeys.end()) {
+            if (m_phoneLookupCache.contains(it.value())) {
+                ++it;
+            } else {
+                it = m_phoneLookupKeys.erase(it);
+            }
+        }
+    }
+    return bestId;
+}
+
+QStringList ContactsMap::smartDial(const QString &digits, int maxCount)
+{
+    QReadLocker locker(&m_mutex);
+    QHash<ContactEntry*, int> matches = m_smartDialIndex.match(digits);
+    if (matches.isEmpty()) {
+        return QStringList();
+    }
+
+    QList<SmartDialMatch> ranked;
+    QHash<ContactEntry*, int>::const_iterator it = matches.constBegin();
+    for (; it != matches.constEnd(); ++it) {
+        QIndividual *individual = it.key()->individual();
+        if (individual->isVisible() && !individual->deletedAt().isValid()) {
+            ranked << SmartDialMatch(it.key(), it.value());
+        }
+    }
+
+    // only the matched contacts are sorted, and only until the requested ones are known
+    SmartDialLessThan lessThan(m_sortClause);
+    int count = ranked.size();
+    if ((maxCount > 0) && (maxCount < count)) {
+        count = maxCount;
+        std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), lessThan);
+    } else {
+        std::sort(ranked.begin(), ranked.end(), lessThan);
+    }
+
+    QStringList result;
+    for (int i = 0; i < count; i++) {
+        result << ranked[i].first->individual()->id();
+    }
+    return result;
+}
+
 QList<ContactEntry *> ContactsMap::values(const QStringList &ids) const
 {
     QList<ContactEntry *> result;
@@ -97,7 +264,7 @@ ContactEntry *ContactsMap::take(FolksIndividual *individual)
 
 ContactEntry *ContactsMap::take(const QString &id)
 {
-    QWriteLocker locker(&m_mutex);
+    ContactsMapWriteLocker locker(&m_mutex);
     ContactEntry *entry = m_idToEntry.take(id);
     removeData(entry, false);
     return entry;
@@ -105,20 +272,20 @@ ContactEntry *ContactsMap::take(const QString &id)
 
 void ContactsMap::remove(const QString &id)
 {
-    QWriteLocker locker(&m_mutex);
+    ContactsMapWriteLocker locker(&m_mutex);
     ContactEntry *entry = m_idToEntry.take(id);
     removeData(entry, true);
 }
 
 void ContactsMap::insert(ContactEntry *entry)
 {
-    QWriteLocker locker(&m_mutex);
+    ContactsMapWriteLocker locker(&m_mutex);
     insertData(entry);
 }
 
 void ContactsMap::updatePosition(ContactEntry *entry)
 {
-    QWriteLocker locker(&m_mutex);
+    ContactsMapWriteLocker locker(&m_mutex);
     if (!m_sortClause.isEmpty()) {
         int oldPos = m_contacts.indexOf(entry);
 
@@ -136,10 +303,13 @@ void ContactsMap::updatePosition(ContactEntry *entry)
     }
 
     // update phone number map
-    Q_FOREACH(const QString &key, m_phoneToEntry.keys(entry)) {
-        m_phoneToEntry.remove(key, entry);
-    }
-    insertData(entry->individual()->contact().details<QContactPhoneNumber>(), entry);
+    updateIndexesData(entry);
+}
+
+void ContactsMap::updateIndexes(ContactEntry *entry)
+{
+    ContactsMapWriteLocker locker(&m_mutex);
+    updateIndexesData(entry);
 }
 
 int ContactsMap::size() const
@@ -149,16 +319,26 @@ int ContactsMap::size() const
 
 void ContactsMap::clear()
 {
-    QWriteLocker locker(&m_mutex);
+    ContactsMapWriteLocker locker(&m_mutex);
     QList<ContactEntry*> entries = m_idToEntry.values();
     m_idToEntry.clear();
     m_phoneToEntry.clear();
+    m_entryToPhone.clear();
+    m_smartDialIndex.clear();
+    m_sectionIndex.clear();
+    m_queryCache.clear();
+    m_generation++;
     m_contacts.clear();
+    m_phoneLookupLock.lock();
+    m_phoneLookupCache.clear();
+    m_phoneLookupKeys.clear();
+    m_phoneLookupLock.unlock();
     qDeleteAll(entries);
 }
 
 void ContactsMap::lockForRead()
 {
+    GALERA_STATS_SCOPE("ContactsMap.readLockWait");
     m_mutex.lockForRead();
 }
 
@@ -189,6 +369,7 @@ QStringList ContactsMap::keys() const
 void ContactsMap::sertSort(const SortClause &clause)
 {
     if (clause.toContactSortOrder() != m_sortClause.toContactSortOrder()) {
+        m_generation++;
         m_sortClause = clause;
         if (!m_sortClause.isEmpty()) {
             ContactEntryLessThan lessThan(m_sortClause);
@@ -202,6 +383,89 @@ SortClause ContactsMap::sort() const
     return m_sortClause;
 }
 
+qint64 ContactsMap::generation() const
+{
+    return m_generation;
+}
+
+bool ContactsMap::queryCandidates(const Filter &filter, bool showInvisible, QStringList *ids)
+{
+    return m_queryCache.candidates(filter, showInvisible, m_generation, ids);
+}
+
+void ContactsMap::insertQueryResult(const Filter &filter, bool showInvisible, const QStringList &ids)
+{
+    m_queryCache.insert(filter, showInvisible, ids, m_generation);
+}
+
+SectionIndex ContactsMap::sectionIndex() const
+{
+    return m_sectionIndex;
+}
+
+QVariantMap ContactsMap::memoryUsage()
+{
+    QReadLocker locker(&m_mutex);
+    QVariantMap usage;
+
+    qint64 individuals = m_contacts.size() * MemoryUsage::ListNodeSize;
+    QHash<QString, ContactEntry*>::const_iterator i = m_idToEntry.constBegin();
+    for(; i != m_idToEntry.constEnd(); i++) {
+        individuals += MemoryUsage::HashNodeSize + MemoryUsage::string(i.key()) +
+                       sizeof(ContactEntry) + i.value()->individual()->memoryUsage();
+    }
+    usage.insert("individuals", individuals);
+
+    qint64 phoneIndex = 0;
+    QMultiMap<QString, ContactEntry*>::const_iterator p = m_phoneToEntry.constBegin();
+    for(; p != m_phoneToEntry.constEnd(); p++) {
+        phoneIndex += MemoryUsage::MapNodeSize + MemoryUsage::string(p.key()) + sizeof(ContactEntry*);
+    }
+    phoneIndex += m_entryToPhone.size() * (MemoryUsage::HashNodeSize + sizeof(ContactEntry*) + sizeof(QString));
+    usage.insert("phoneIndex", phoneIndex);
+
+    usage.insert("smartDialIndex", m_smartDialIndex.memoryUsage());
+    usage.insert("sectionIndex", m_sectionIndex.memoryUsage());
+    usage.insert("queryCache", m_queryCache.memoryUsage());
+
+    qint64 phoneLookupCache = 0;
+    m_phoneLookupLock.lock();
+    Q_FOREACH(const QString &number, m_phoneLookupCache.keys()) {
+        phoneLookupCache += MemoryUsage::HashNodeSize + MemoryUsage::string(number) +
+                            MemoryUsage::string(*m_phoneLookupCache.object(number));
+    }
+    QMultiHash<QString, QString>::const_iterator k = m_phoneLookupKeys.constBegin();
+    for(; k != m_phoneLookupKeys.constEnd(); k++) {
+        phoneLookupCache += MemoryUsage::HashNodeSize + MemoryUsage::string(k.key()) + MemoryUsage::string(k.value());
+    }
+    m_phoneLookupLock.unlock();
+    usage.insert("phoneLookupCache", phoneLookupCache);
+
+    return usage;
+}
+
+void ContactsMap::releaseCaches()
+{
+    m_queryCache.clear();
+    m_phoneLookupLock.lock();
+    m_phoneLookupCache.clear();
+    m_phoneLookupKeys.clear();
+    m_phoneLookupLock.unlock();
+}
+
+int ContactsMap::releaseContacts()
+{
+    // the filter threads keep references to the contacts while the lock is held
+    ContactsMapWriteLocker locker(&m_mutex);
+    int released = 0;
+    Q_FOREACH(ContactEntry *entry, m_idToEntry) {
+        if (entry->individual()->releaseContact()) {
+            released++;
+        }
+    }
+    return released;
+}
+
 SortClause ContactsMap::defaultSort()
 {
     static SortClause clause("");
@@ -262,9 +526,10 @@ ContactEntry *ContactsMap::value(FolksIndividual *individual) const
 void ContactsMap::removeData(ContactEntry *entry, bool del)
 {
     if (entry) {
-        Q_FOREACH(const QString &key,  m_phoneToEntry.keys(entry)) {
-            m_phoneToEntry.remove(key, entry);
-        }
+        m_generation++;
+        removePhoneData(entry);
+        m_smartDialIndex.remove(entry);
+        m_sectionIndex.remove(entry->individual()->id());
         m_contacts.removeOne(entry);
         if (del) {
             delete entry;
@@ -279,6 +544,8 @@ void ContactsMap::insertData(ContactEntry *entry)
 
 
     if (fIndividual) {
+        m_generation++;
+
         // fill id map
         m_idToEntry.insert(folks_individual_get_id(fIndividual), entry);
 
@@ -292,32 +559,73 @@ void ContactsMap::insertData(ContactEntry *entry)
         }
 
         // fill phone map
-        insertData(entry->individual()->contact().details<QContactPhoneNumber>(), entry);
+        QIndividual *individual = entry->individual();
+        insertData(individual->normalizedPhoneNumbers(), entry);
+        m_smartDialIndex.insert(entry, individual->contact(), individual->normalizedPhoneNumbers());
+        updateSectionData(entry);
     }
 }
 
-void ContactsMap::insertData(const QList<QContactPhoneNumber> &numbers, ContactEntry *entry)
+void ContactsMap::insertData(const QStringList &normalizedNumbers, ContactEntry *entry)
 {
-    Q_FOREACH(const QContactPhoneNumber &phone, numbers) {
-        QString mNumber = minimalNumber(phone.number());
+    Q_FOREACH(const QString &number, normalizedNumbers) {
+        QString mNumber = number.right(7);
         if (!mNumber.isEmpty()) {
             m_phoneToEntry.insert(mNumber, entry);
+            m_entryToPhone.insert(entry, mNumber);
+            invalidatePhoneLookups(mNumber);
         }
     }
 }
 
-QString ContactsMap::minimalNumber(const QString &phone) const
+void ContactsMap::removePhoneData(ContactEntry *entry)
+{
+    // use the reverse index, a search by value in the phone map is linear
+    Q_FOREACH(const QString &key, m_entryToPhone.values(entry)) {
+        m_phoneToEntry.remove(key, entry);
+        invalidatePhoneLookups(key);
+    }
+    m_entryToPhone.remove(entry);
+}
+
+void ContactsMap::invalidatePhoneLookups(const QString &key)
+{
+    // the entries of the key changed (phones, visibility or deletion), the other keys
+    // keep their lookups
+    QMutexLocker locker(&m_phoneLookupLock);
+    Q_FOREACH(const QString &number, m_phoneLookupKeys.values(key)) {
+        m_phoneLookupCache.remove(number);
+    }
+    m_phoneLookupKeys.remove(key);
+}
+
+void ContactsMap::updateIndexesData(ContactEntry *entry)
 {
-    static i18n::phonenumbers::PhoneNumberUtil *phonenumberUtil = i18n::phonenumbers::PhoneNumberUtil::GetInstance();
+    m_generation++;
 
-    std::string stdPreprocessedPhone(phone.toStdString());
-    phonenumberUtil->NormalizeDiallableCharsOnly(&stdPreprocessedPhone);
+    QIndividual *individual = entry->individual();
+    removePhoneData(entry);
+    insertData(individual->normalizedPhoneNumbers(), entry);
 
-    if (stdPreprocessedPhone.length() <= 7) {
-        return QString::fromStdString(stdPreprocessedPhone);
+    m_smartDialIndex.remove(entry);
+    m_smartDialIndex.insert(entry, individual->contact(), individual->normalizedPhoneNumbers());
+    updateSectionData(entry);
+}
+
+void ContactsMap::updateSectionData(ContactEntry *entry)
+{
+    // the section of the contact changes with the tag, visibility or deletion
+    QIndividual *individual = entry->individual();
+    if (individual->isVisible() && !individual->deletedAt().isValid()) {
+        m_sectionIndex.insert(individual->id(), individual->contact());
+    } else {
+        m_sectionIndex.remove(individual->id());
     }
+}
 
-    return QString::fromStdString(stdPreprocessedPhone).right(7);
+QString ContactsMap::minimalNumber(const QString &phone) const
+{
+    return Filter::normalizePhoneNumber(phone).right(7);
 }
 
 } //namespace
@@ -19,11 +19,19 @@
 #ifndef __GALERA_CONTACTS_MAP_PRIV_H__
 #define __GALERA_CONTACTS_MAP_PRIV_H__
 
+#include "query-cache.h"
+#include "section-index.h"
+#include "smart-dial-index.h"
+
 #include "common/sort-clause.h"
 
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 #include <QtCore/QHash>
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QVariantMap>
 
 #include <QtContacts/QContactPhoneNumber>
 
@@ -66,6 +74,10 @@ public:
     ContactEntry *value(FolksIndividual *individual) const;
     ContactEntry *value(const QString &id) const;
     QList<ContactEntry*> valueByPhone(const QString &phone) const;
+    // return the id of the contact that best matches the phone number
+    QString lookupPhone(const QString &phone);
+    // return the ids of the contacts that match the keypad digits, ranked by match position
+    QStringList smartDial(const QString &digits, int maxCount);
     QList<ContactEntry*> values(const QStringList &ids) const;
 
     ContactEntry *take(FolksIndividual *individual);
@@ -74,6 +86,7 @@ public:
     void remove(const QString &id);
     void insert(ContactEntry *entry);
     void updatePosition(ContactEntry *entry);
+    void updateIndexes(ContactEntry *entry);
     int size() const;
     void clear();
     void lockForRead();
@@ -82,6 +95,23 @@ public:
     QList<QtContacts::QContact> contacts() const;
     QStringList keys() const;
 
+    // per letter counts of the visible contacts, only valid when sorted by tag
+    SectionIndex sectionIndex() const;
+
+    // incremented on every change of the contacts
+    qint64 generation() const;
+    // recent query results, used to refine the search-as-you-type queries
+    bool queryCandidates(const Filter &filter, bool showInvisible, QStringList *ids);
+    void insertQueryResult(const Filter &filter, bool showInvisible, const QStringList &ids);
+
+    // estimated memory used by the individuals and by each index, the contacts cached
+    // by the individuals are not included (see QIndividual::cachedContactsMemory)
+    QVariantMap memoryUsage();
+    // drop the query and phone lookup results
+    void releaseCaches();
+    // drop the contacts cached by the individuals, return the number of contacts released
+    int releaseContacts();
+
     void sertSort(const SortClause &clause);
     SortClause sort() const;
 
@@ -90,14 +120,30 @@ public:
 private:
     QHash<QString, ContactEntry*> m_idToEntry;
     QMultiMap<QString, ContactEntry*> m_phoneToEntry;
+    QMultiHash<ContactEntry*, QString> m_entryToPhone;
+    SmartDialIndex m_smartDialIndex;
+    SectionIndex m_sectionIndex;
     // sorted contacts
     QList<ContactEntry*> m_contacts;
     SortClause m_sortClause;
     QReadWriteLock m_mutex;
+    // phone lookup results by normalized number, an empty id means no match
+    QCache<QString, QString> m_phoneLookupCache;
+    // numbers of the cached lookups by phone index key, the lookup candidates only come
+    // from the entries with the same key, a change on them drops only these lookups
+    QMultiHash<QString, QString> m_phoneLookupKeys;
+    QMutex m_phoneLookupLock;
+    QueryCache m_queryCache;
+    // incremented on every change of the contacts, invalidates the query results
+    qint64 m_generation;
 
     void removeData(ContactEntry *entry, bool del);
     void insertData(ContactEntry *entry);
-    void insertData(const QList<QtContacts::QContactPhoneNumber> &numbers, ContactEntry *entry);
+    void insertData(const QStringList &normalizedNumbers, ContactEntry *entry);
+    void removePhoneData(ContactEntry *entry);
+    void invalidatePhoneLookups(const QString &key);
+    void updateIndexesData(ContactEntry *entry);
+    void updateSectionData(ContactEntry *entry);
     QString minimalNumber(const QString &phone) const;
 };
 
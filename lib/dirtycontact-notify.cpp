@@ -19,19 +19,70 @@
 
 //this timeout represents how long the server will wait for changes on the contact before notify the client
 #define NOTIFY_CONTACTS_TIMEOUT 500
+//timeout used for a single change after a quiet period (Eg. the user editing a contact)
+#define NOTIFY_CONTACTS_INTERACTIVE_TIMEOUT 20
+//max time that a change can wait to be notified while new changes keep arriving
+#define NOTIFY_CONTACTS_MAX_LATENCY 2000
+//max number of ids sent in a single signal
+#define NOTIFY_CONTACTS_MAX_IDS 500
 
 #include "dirtycontact-notify.h"
+#include "addressbook.h"
 #include "addressbook-adaptor.h"
+#include "contacts-map.h"
+#include "qindividual.h"
+#include "stats.h"
+
+#include "common/fetch-hint.h"
+#include "common/vcard-parser.h"
+
+using namespace QtContacts;
 
 namespace galera {
 
-DirtyContactsNotify::DirtyContactsNotify(AddressBookAdaptor *adaptor, QObject *parent)
+DirtyContactsNotify::DirtyContactsNotify(AddressBook *addressBook, AddressBookAdaptor *adaptor, QObject *parent)
     : QObject(parent),
-      m_adaptor(adaptor)
+      m_addressBook(addressBook),
+      m_adaptor(adaptor),
+      m_batches(0),
+      m_interactiveBatches(0),
+      m_signals(0),
+      m_notifiedIds(0),
+      m_maxBatchSize(0),
+      m_totalDelay(0),
+      m_maxDelay(0)
 {
     m_timer.setInterval(NOTIFY_CONTACTS_TIMEOUT);
     m_timer.setSingleShot(true);
     connect(&m_timer, SIGNAL(timeout()), SLOT(emitSignals()));
+
+    // remove the listener when the client leaves the bus
+    m_listenersWatcher = new QDBusServiceWatcher(this);
+    m_listenersWatcher->setConnection(adaptor->connection());
+    m_listenersWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(m_listenersWatcher, SIGNAL(serviceUnregistered(QString)), SLOT(removeListener(QString)));
+}
+
+void DirtyContactsNotify::addListener(const QString &service, const QStringList &fields, bool includeContacts)
+{
+    if (service.isEmpty()) {
+        return;
+    }
+
+    ChangesListener listener;
+    listener.fields = fields;
+    listener.includeContacts = includeContacts;
+    if (!m_listeners.contains(service)) {
+        m_listenersWatcher->addWatchedService(service);
+    }
+    m_listeners.insert(service, listener);
+}
+
+void DirtyContactsNotify::removeListener(const QString &service)
+{
+    if (m_listeners.remove(service) > 0) {
+        m_listenersWatcher->removeWatchedService(service);
+    }
 }
 
 void DirtyContactsNotify::insertAddedContacts(QSet<QString> ids)
@@ -51,7 +102,53 @@ void DirtyContactsNotify::insertAddedContacts(QSet<QString> ids)
     }
 
     m_contactsAdded += addedIds;
-    m_timer.start();
+    scheduleEmit();
+}
+
+void DirtyContactsNotify::scheduleEmit()
+{
+    int pending = m_contactsChanged.size() + m_contactsAdded.size() + m_contactsRemoved.size();
+    if (pending == 0) {
+        return;
+    }
+
+    if (!m_pendingSince.isValid()) {
+        m_pendingSince.start();
+
+        // a single change after a quiet period is probably an user action, notify it as fast as possible
+        bool quiet = !m_lastEmit.isValid() || (m_lastEmit.elapsed() > NOTIFY_CONTACTS_TIMEOUT);
+        if (quiet && (pending == 1)) {
+            m_timer.start(NOTIFY_CONTACTS_INTERACTIVE_TIMEOUT);
+            return;
+        }
+    }
+
+    // wait for the burst to finish but never more than the max latency since the first pending change
+    qint64 remaining = NOTIFY_CONTACTS_MAX_LATENCY - m_pendingSince.elapsed();
+    m_timer.start(int(qBound<qint64>(0, remaining, NOTIFY_CONTACTS_TIMEOUT)));
+}
+
+QList<QStringList> DirtyContactsNotify::splitIds(const QStringList &ids)
+{
+    QList<QStringList> chunks;
+    for(int i=0; i < ids.size(); i += NOTIFY_CONTACTS_MAX_IDS) {
+        chunks << ids.mid(i, NOTIFY_CONTACTS_MAX_IDS);
+    }
+    return chunks;
+}
+
+QVariantMap DirtyContactsNotify::statistics() const
+{
+    QVariantMap stats;
+    stats.insert("batches", m_batches);
+    stats.insert("interactiveBatches", m_interactiveBatches);
+    stats.insert("signals", m_signals);
+    stats.insert("notifiedIds", m_notifiedIds);
+    stats.insert("maxBatchSize", m_maxBatchSize);
+    stats.insert("averageBatchSize", m_batches > 0 ? double(m_notifiedIds) / m_batches : 0.0);
+    stats.insert("maxDelay", m_maxDelay);
+    stats.insert("averageDelay", m_batches > 0 ? double(m_totalDelay) / m_batches : 0.0);
+    return stats;
 }
 
 void DirtyContactsNotify::flush()
@@ -67,6 +164,7 @@ void DirtyContactsNotify::clear()
     m_contactsAdded.clear();
     m_contactsRemoved.clear();
     m_timer.stop();
+    m_pendingSince.invalidate();
 }
 
 void DirtyContactsNotify::insertRemovedContacts(QSet<QString> ids)
@@ -85,17 +183,119 @@ void DirtyContactsNotify::insertRemovedContacts(QSet<QString> ids)
     }
 
     m_contactsRemoved += removedIds;
-    m_timer.start();
+    scheduleEmit();
 }
 
 void DirtyContactsNotify::insertChangedContacts(QSet<QString> ids)
 {
     if (!m_adaptor || !m_adaptor->isReady()) {
+        // the change is not reported, reset the changed details of the contacts
+        takeChangedDetailTypes(ids.toList());
         return;
     }
 
     m_contactsChanged += ids;
-    m_timer.start();
+    scheduleEmit();
+}
+
+QList<int> DirtyContactsNotify::takeChangedDetailTypes(const QStringList &ids) const
+{
+    ContactsMap *contacts = m_addressBook ? m_addressBook->m_contacts : 0;
+    if (!contacts) {
+        return QList<int>();
+    }
+
+    // the types must be taken from all contacts to reset the individual state
+    QSet<int> types;
+    bool unknown = false;
+    Q_FOREACH(const QString &id, ids) {
+        ContactEntry *entry = contacts->value(id);
+        if (!entry) {
+            continue;
+        }
+
+        QList<QContactDetail::DetailType> contactTypes = entry->individual()->takeChangedDetailTypes();
+        if (contactTypes.isEmpty()) {
+            unknown = true;
+        }
+        Q_FOREACH(QContactDetail::DetailType type, contactTypes) {
+            types << type;
+        }
+    }
+
+    // an empty list means that any detail could have changed
+    return unknown ? QList<int>() : types.toList();
+}
+
+QStringList DirtyContactsNotify::serializeContacts(const QStringList &ids, const QStringList &fields) const
+{
+    ContactsMap *contacts = m_addressBook ? m_addressBook->m_contacts : 0;
+
+    // the result has the same size of "ids", contacts not found will have an empty vcard
+    QStringList vcards;
+    QList<QContact> contactsToSerialize;
+    QList<int> positions;
+    QList<QContactDetail::DetailType> detailTypes = FetchHint::parseFieldNames(fields);
+    for(int i=0; i < ids.size(); i++) {
+        vcards << QString();
+        ContactEntry *entry = contacts ? contacts->value(ids[i]) : 0;
+        if (entry) {
+            contactsToSerialize << QIndividual::copy(entry->individual()->contact(), detailTypes);
+            positions << i;
+        }
+    }
+
+    if (!contactsToSerialize.isEmpty()) {
+        GALERA_STATS_SCOPE("VCardParser.contactToVcardSync");
+        QStringList result = VCardParser::contactToVcardSync(contactsToSerialize);
+        for(int i=0; (i < positions.size()) && (i < result.size()); i++) {
+            vcards[positions[i]] = result[i];
+        }
+    }
+    return vcards;
+}
+
+void DirtyContactsNotify::notifyListeners(const QStringList &changedIds,
+                                          const QList<int> &changedTypes,
+                                          const QStringList &addedIds)
+{
+    // serialize the contacts only once for each field set requested
+    QHash<QString, QStringList> changedVCards;
+    QHash<QString, QStringList> addedVCards;
+
+    QHash<QString, ChangesListener>::const_iterator i = m_listeners.constBegin();
+    for(; i != m_listeners.constEnd(); i++) {
+        const ChangesListener &listener = i.value();
+        const QString fieldsKey = listener.fields.join(",");
+
+        if (!changedIds.isEmpty()) {
+            QStringList vcards;
+            if (listener.includeContacts) {
+                if (!changedVCards.contains(fieldsKey)) {
+                    changedVCards.insert(fieldsKey, serializeContacts(changedIds, listener.fields));
+                }
+                vcards = changedVCards.value(fieldsKey);
+            }
+            m_adaptor->notifyListener(i.key(),
+                                      "contactsUpdatedDetailed",
+                                      QVariantList() << changedIds
+                                                     << QVariant::fromValue(changedTypes)
+                                                     << vcards);
+        }
+
+        if (!addedIds.isEmpty()) {
+            QStringList vcards;
+            if (listener.includeContacts) {
+                if (!addedVCards.contains(fieldsKey)) {
+                    addedVCards.insert(fieldsKey, serializeContacts(addedIds, listener.fields));
+                }
+                vcards = addedVCards.value(fieldsKey);
+            }
+            m_adaptor->notifyListener(i.key(),
+                                      "contactsAddedDetailed",
+                                      QVariantList() << addedIds << vcards);
+        }
+    }
 }
 
 void DirtyContactsNotify::emitSignals()
@@ -104,27 +304,55 @@ void DirtyContactsNotify::emitSignals()
                << "\n\tChanged:" << m_contactsChanged.size()
                << "\n\tRemoved:" << m_contactsRemoved.size()
                << "\n\tAdded:" << m_contactsAdded.size();
-    if (!m_contactsChanged.isEmpty()) {
-        // ignore the signal if the added signal was not fired yet
-        m_contactsChanged.subtract(m_contactsAdded);
-        // ignore the signal if the contact was removed
-        m_contactsChanged.subtract(m_contactsRemoved);
-
-        if (!m_contactsChanged.isEmpty()) {
-            Q_EMIT m_adaptor->contactsUpdated(m_contactsChanged.toList());
-            m_contactsChanged.clear();
+
+    // ignore the signal if the added signal was not fired yet
+    m_contactsChanged.subtract(m_contactsAdded);
+    // ignore the signal if the contact was removed
+    m_contactsChanged.subtract(m_contactsRemoved);
+
+    int batchSize = m_contactsChanged.size() + m_contactsAdded.size() + m_contactsRemoved.size();
+    if (batchSize > 0) {
+        qint64 delay = m_pendingSince.isValid() ? m_pendingSince.elapsed() : 0;
+        m_batches++;
+        if (delay <= NOTIFY_CONTACTS_INTERACTIVE_TIMEOUT * 2) {
+            m_interactiveBatches++;
+        }
+        m_notifiedIds += batchSize;
+        m_maxBatchSize = qMax(m_maxBatchSize, batchSize);
+        m_totalDelay += delay;
+        m_maxDelay = qMax(m_maxDelay, delay);
+    }
+    m_pendingSince.invalidate();
+    m_lastEmit.start();
+
+    // big changes are sent in small chunks to avoid huge dbus messages
+    Q_FOREACH(const QStringList &ids, splitIds(m_contactsChanged.toList())) {
+        QList<int> types = takeChangedDetailTypes(ids);
+        if (!m_listeners.isEmpty()) {
+            notifyListeners(ids, types, QStringList());
         }
+        Q_EMIT m_adaptor->contactsUpdated(ids);
+        m_signals++;
     }
+    m_contactsChanged.clear();
 
-    if (!m_contactsRemoved.isEmpty()) {
-        Q_EMIT m_adaptor->contactsRemoved(m_contactsRemoved.toList());
-        m_contactsRemoved.clear();
+    Q_FOREACH(const QStringList &ids, splitIds(m_contactsRemoved.toList())) {
+        Q_EMIT m_adaptor->contactsRemoved(ids);
+        m_signals++;
     }
+    m_contactsRemoved.clear();
 
-    if (!m_contactsAdded.isEmpty()) {
-        Q_EMIT m_adaptor->contactsAdded(m_contactsAdded.toList());
-        m_contactsAdded.clear();
+    Q_FOREACH(const QStringList &ids, splitIds(m_contactsAdded.toList())) {
+        // the changes made before the contact was reported are part of the added contact,
+        // they must not be sent with its next update
+        takeChangedDetailTypes(ids);
+        if (!m_listeners.isEmpty()) {
+            notifyListeners(QStringList(), QList<int>(), ids);
+        }
+        Q_EMIT m_adaptor->contactsAdded(ids);
+        m_signals++;
     }
+    m_contactsAdded.clear();
 }
 
 } //namespace
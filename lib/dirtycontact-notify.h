@@ -24,36 +24,83 @@
 #include <QtCore/QSet>
 #include <QtCore/QString>
 #include <QtCore/QPointer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QVariantMap>
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+
+#include <QtDBus/QDBusServiceWatcher>
 
 namespace galera {
 
+class AddressBook;
 class AddressBookAdaptor;
 
 // this is a helper class uses a timer with a small timeout to notify the client about
 // any contact change notification. This class should be used instead of emit the signal directly
 // this will avoid notify about the contact update several times when updating different fields simultaneously
 // With that we can reduce the dbus traffic and skip some client calls to query about the new contact info.
+// A single change after a quiet period is notified almost immediately, bursts of changes are grouped
+// but never delayed more than a max latency and big groups are split in chunks.
 class DirtyContactsNotify : public QObject
 {
     Q_OBJECT
 
 public:
-    DirtyContactsNotify(AddressBookAdaptor *adaptor, QObject *parent=0);
+    DirtyContactsNotify(AddressBook *addressBook, AddressBookAdaptor *adaptor, QObject *parent=0);
     void insertChangedContacts(QSet<QString> ids);
     void insertRemovedContacts(QSet<QString> ids);
     void insertAddedContacts(QSet<QString> ids);
     void flush();
     void clear();
+    QVariantMap statistics() const;
+
+    // clients registered as listeners also receive the detailed signals with the changed detail types
+    // and if requested the contacts vcards containing only the requested fields
+    void addListener(const QString &service, const QStringList &fields, bool includeContacts);
+
+public Q_SLOTS:
+    void removeListener(const QString &service);
 
 private Q_SLOTS:
     void emitSignals();
 
 private:
+    class ChangesListener
+    {
+    public:
+        QStringList fields;
+        bool includeContacts;
+    };
+
+    QPointer<AddressBook> m_addressBook;
     QPointer<AddressBookAdaptor> m_adaptor;
     QTimer m_timer;
     QSet<QString> m_contactsChanged;
     QSet<QString> m_contactsAdded;
     QSet<QString> m_contactsRemoved;
+    QHash<QString, ChangesListener> m_listeners;
+    QDBusServiceWatcher *m_listenersWatcher;
+    QElapsedTimer m_pendingSince;
+    QElapsedTimer m_lastEmit;
+
+    // statistics
+    int m_batches;
+    int m_interactiveBatches;
+    int m_signals;
+    qint64 m_notifiedIds;
+    int m_maxBatchSize;
+    qint64 m_totalDelay;
+    qint64 m_maxDelay;
+
+    void scheduleEmit();
+    static QList<QStringList> splitIds(const QStringList &ids);
+
+    QList<int> takeChangedDetailTypes(const QStringList &ids) const;
+    QStringList serializeContacts(const QStringList &ids, const QStringList &fields) const;
+    void notifyListeners(const QStringList &changedIds,
+                         const QList<int> &changedTypes,
+                         const QStringList &addedIds);
 };
 
 
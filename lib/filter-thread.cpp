@@ -0,0 +1,405 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter-thread.h"
+#include "contacts-map.h"
+#include "contact-less-than.h"
+#include "memory-usage.h"
+#include "qindividual.h"
+#include "stats.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QDataStream>
+
+#include <QtContacts/QContactGuid>
+#include <QtContacts/QContactManagerEngine>
+#include <QtContacts/QContactSortOrder>
+
+using namespace QtContacts;
+
+namespace galera
+{
+
+FilterThread::FilterThread(const QString &filter, const QString &sort, int maxCount, bool showInvisible, ContactsMap *allContacts)
+    : m_filter(filter),
+      m_sortClause(sort),
+      m_allContacts(allContacts),
+      m_maxCount(maxCount),
+      m_showInvisible(showInvisible),
+      m_canceled(false),
+      m_running(false),
+      m_done(false),
+      m_generation(allContacts ? allContacts->generation() : -1),
+      m_views(0)
+{
+    setAutoDelete(false);
+}
+
+QList<QContact> FilterThread::result() const
+{
+    if (isRunning()) {
+        return QList<QContact>();
+    } else {
+        return m_contacts;
+    }
+}
+
+bool FilterThread::appendContact(const QContact &contact, const QDateTime &deteletedAt, const QStringList &normalizedPhones)
+{
+    if (checkContact(contact, deteletedAt, normalizedPhones)) {
+        addSorted(&m_contacts, contact, m_sortClause);
+        m_sectionIndex.insert(contact.detail<QContactGuid>().guid(), contact);
+        return true;
+    }
+    return false;
+}
+
+bool FilterThread::removeContact(const QContact &contact)
+{
+    m_sectionIndex.remove(contact.detail<QContactGuid>().guid());
+    return m_contacts.removeAll(contact);
+}
+
+SectionIndex FilterThread::sectionIndex() const
+{
+    if (isRunning() || !SectionIndex::isSectionSort(resultSort())) {
+        return SectionIndex();
+    }
+    return m_sectionIndex;
+}
+
+QString FilterThread::token(int index) const
+{
+    if ((index < 0) || (index >= m_contacts.size())) {
+        return QString();
+    }
+
+    const QContact &contact = m_contacts.at(index);
+    QVariantList keys;
+    Q_FOREACH(const QContactSortOrder &order, resultSort().toContactSortOrder()) {
+        keys << contact.detail(order.detailType()).value(order.detailField());
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << contact.detail<QContactGuid>().guid() << keys;
+    return QString::fromLatin1(data.toBase64());
+}
+
+int FilterThread::seek(const QString &token) const
+{
+    QByteArray data = QByteArray::fromBase64(token.toLatin1());
+    QDataStream stream(data);
+    QString id;
+    QVariantList keys;
+    stream >> id >> keys;
+    if ((stream.status() != QDataStream::Ok) || id.isEmpty()) {
+        return -1;
+    }
+
+    SortClause sort = resultSort();
+    QList<QContactSortOrder> orders = sort.toContactSortOrder();
+    if (orders.size() != keys.size()) {
+        // the view sort changed after the token was created
+        return -1;
+    }
+
+    QList<QContact>::const_iterator begin = m_contacts.constBegin();
+    QList<QContact>::const_iterator end = m_contacts.constEnd();
+    if (!orders.isEmpty()) {
+        // build a contact with the sort keys to find the range of contacts with the same keys
+        QContact keyContact;
+        for (int i = 0; i < orders.size(); i++) {
+            if (keys[i].isValid()) {
+                QContactDetail detail(orders[i].detailType());
+                detail.setValue(orders[i].detailField(), keys[i]);
+                keyContact.saveDetail(&detail);
+            }
+        }
+
+        // the binary search needs a strict order, ContactLessThan is true for equal keys
+        // and would return an empty range for them
+        auto lessThan = [&orders](const QContact &contactA, const QContact &contactB) {
+            return QContactManagerEngine::compareContact(contactA, contactB, orders) < 0;
+        };
+        begin = std::lower_bound(m_contacts.constBegin(), m_contacts.constEnd(), keyContact, lessThan);
+        end = std::upper_bound(begin, m_contacts.constEnd(), keyContact, lessThan);
+    }
+
+    for (QList<QContact>::const_iterator it = begin; it != end; ++it) {
+        if (it->detail<QContactGuid>().guid() == id) {
+            return std::distance(m_contacts.constBegin(), it) + 1;
+        }
+    }
+
+    // the results are snapshots, a contact missing from it means that the token belongs
+    // to another view or result
+    return -1;
+}
+
+QSharedPointer<FilterThread> FilterThread::sorted(const SortClause &clause) const
+{
+    QSharedPointer<FilterThread> copy(new FilterThread(m_filter.toString(), clause.toString(),
+                                                       m_maxCount, m_showInvisible, m_allContacts));
+    copy->m_contacts = m_contacts;
+    copy->m_sectionIndex = m_sectionIndex;
+    copy->m_generation = m_generation;
+    copy->m_done = true;
+    if (!clause.isEmpty()) {
+        ContactLessThan lessThan(clause);
+        qSort(copy->m_contacts.begin(), copy->m_contacts.end(), lessThan);
+    }
+    return copy;
+}
+
+void FilterThread::addSorted(QList<QContact> *sorted, const QContact &toAdd, const SortClause& sortOrder)
+{
+    if (!sortOrder.isEmpty()) {
+        ContactLessThan lessThan(sortOrder);
+        QList<QContact>::iterator it(std::upper_bound(sorted->begin(), sorted->end(), toAdd, lessThan));
+        sorted->insert(it, toAdd);
+    } else {
+        // no sort order just add it to the end
+        sorted->append(toAdd);
+    }
+}
+
+void FilterThread::cancel()
+{
+    m_canceledLock.lockForWrite();
+    m_canceled = true;
+    m_canceledLock.unlock();
+}
+
+bool FilterThread::isRunning() const
+{
+    return m_running;
+}
+
+bool FilterThread::done() const
+{
+    return m_done;
+}
+
+qint64 FilterThread::generation() const
+{
+    QMutexLocker locker(&m_doneLock);
+    return m_generation;
+}
+
+void FilterThread::notifyWhenDone(QObject *listener, const char *slot)
+{
+    QMutexLocker locker(&m_doneLock);
+    if (m_done) {
+        // skip the method type code
+        QByteArray method(slot + 1);
+        method = method.left(method.indexOf('('));
+        QMetaObject::invokeMethod(listener, method.constData(), Qt::QueuedConnection);
+    } else {
+        connect(this, SIGNAL(finished()), listener, slot, Qt::QueuedConnection);
+    }
+}
+
+void FilterThread::attach()
+{
+    m_views++;
+}
+
+int FilterThread::detach()
+{
+    m_views--;
+    return m_views;
+}
+
+int FilterThread::views() const
+{
+    return m_views;
+}
+
+qint64 FilterThread::memoryUsage() const
+{
+    qint64 size = sizeof(FilterThread);
+    if (done()) {
+        size += (m_contacts.size() * (MemoryUsage::ListNodeSize + sizeof(QContact))) +
+                m_sectionIndex.memoryUsage();
+    }
+    return size;
+}
+
+QString FilterThread::key(const QString &filter, const QString &sort, int maxCount,
+                          bool showInvisible, const QStringList &sources)
+{
+    QStringList sortedSources(sources);
+    sortedSources.sort();
+    return QString("%1|%2|%3|%4|%5").arg(Filter(filter).toString())
+                                    .arg(SortClause(sort).toString())
+                                    .arg(maxCount)
+                                    .arg(showInvisible)
+                                    .arg(sortedSources.join(","));
+}
+
+SortClause FilterThread::resultSort() const
+{
+    // without sort clause the contacts are in the same order as the contacts map
+    if (m_sortClause.isEmpty() && m_allContacts) {
+        return m_allContacts->sort();
+    }
+    return m_sortClause;
+}
+
+void FilterThread::notifyFinished()
+{
+    QMutexLocker locker(&m_doneLock);
+    m_running = false;
+    m_done = true;
+    Q_EMIT finished();
+}
+
+bool FilterThread::checkContact(const QContact &contact, const QDateTime &deletedAt, const QStringList &normalizedPhones)
+{
+    return m_filter.test(contact, deletedAt, normalizedPhones);
+}
+
+void FilterThread::run()
+{
+    if (m_canceled || !m_allContacts) {
+        notifyFinished();
+        return;
+    }
+
+    GALERA_STATS_SCOPE("FilterThread.run");
+    m_allContacts->lockForRead();
+    m_doneLock.lock();
+    m_generation = m_allContacts->generation();
+    m_doneLock.unlock();
+
+    // only sort contacts if the contacts was stored in a different order into the contacts map
+    bool needSort = (!m_sortClause.isEmpty() &&
+                     (m_sortClause.toContactSortOrder() != m_allContacts->sort().toContactSortOrder()));
+    // filter contacts if necessary
+    if (m_filter.isValid() && m_filter.isEmpty()) {
+        GALERA_STATS_COUNT("FilterThread.all", 1);
+        // the contacts map already counts the visible contacts by section
+        bool copySections = (!m_showInvisible && (m_maxCount <= 0));
+        if (copySections) {
+            m_sectionIndex = m_allContacts->sectionIndex();
+        }
+
+        Q_FOREACH(ContactEntry *entry, m_allContacts->values()) {
+            if ((m_showInvisible || entry->individual()->isVisible()) &&
+                !entry->individual()->deletedAt().isValid()) {
+
+                QContact contact = entry->individual()->contact();
+
+                if (needSort) {
+                    addSorted(&m_contacts, contact, m_sortClause);
+                } else {
+                    m_contacts.append(contact);
+                }
+                if (!copySections) {
+                    m_sectionIndex.insert(entry->individual()->id(), contact);
+                }
+
+                if ((m_maxCount > 0) && (m_maxCount >= m_contacts.size())) {
+                    break;
+                }
+            }
+        }
+    } else if (m_filter.isValid()) {
+        // optmization
+        QList<ContactEntry *> preFilter;
+        // the full scan results are kept to refine the next queries
+        bool cacheResult = false;
+        QStringList resultIds;
+
+        // check if is a query by id
+        QStringList idsToFilter = m_filter.idsToFilter();
+        if (!idsToFilter.isEmpty()) {
+            GALERA_STATS_COUNT("FilterThread.indexed", 1);
+            preFilter = m_allContacts->values(idsToFilter);
+        } else {
+            // check if is a phone number query
+            QString phoneToFilter = m_filter.phoneNumberToFilter();
+            if (!phoneToFilter.isEmpty()) {
+                GALERA_STATS_COUNT("FilterThread.indexed", 1);
+                preFilter = m_allContacts->valueByPhone(phoneToFilter);
+            } else {
+                // check if the query narrows a recent query
+                QStringList candidates;
+                if (m_allContacts->queryCandidates(m_filter, m_showInvisible, &candidates)) {
+                    GALERA_STATS_COUNT("FilterThread.refined", 1);
+                    preFilter = m_allContacts->values(candidates);
+                } else {
+                    GALERA_STATS_COUNT("FilterThread.scanned", 1);
+                    qDebug() << "Filter not optimized" << m_filter.toContactFilter();
+                    preFilter = m_allContacts->values();
+                }
+                cacheResult = true;
+            }
+        }
+        GALERA_STATS_RECORD("FilterThread.candidates", preFilter.size());
+
+        Q_FOREACH(ContactEntry *entry, preFilter) {
+            m_canceledLock.lockForRead();
+            if (m_canceled) {
+                m_canceledLock.unlock();
+                m_allContacts->unlock();
+                notifyFinished();
+                return;
+            }
+
+            QContact contact = entry->individual()->contact();
+            QDateTime deletedAt = entry->individual()->deletedAt();
+            QStringList normalizedPhones = entry->individual()->normalizedPhoneNumbers();
+            m_canceledLock.unlock();
+
+            if ((m_showInvisible || entry->individual()->isVisible()) &&
+                checkContact(contact, deletedAt, normalizedPhones)) {
+                if (needSort) {
+                    addSorted(&m_contacts, contact, m_sortClause);
+                } else {
+                    m_contacts.append(contact);
+                }
+                m_sectionIndex.insert(entry->individual()->id(), contact);
+                if (cacheResult) {
+                    resultIds << entry->individual()->id();
+                }
+                if ((m_maxCount > 0) && (m_contacts.size() >= m_maxCount)) {
+                    // incomplete result
+                    cacheResult = false;
+                    break;
+                }
+            }
+        }
+
+        if (cacheResult) {
+            m_allContacts->insertQueryResult(m_filter, m_showInvisible, resultIds);
+        }
+    } else {
+        // invalid filter
+        m_contacts.clear();
+        m_sectionIndex.clear();
+    }
+
+    GALERA_STATS_RECORD("FilterThread.matches", m_contacts.size());
+    m_allContacts->unlock();
+    notifyFinished();
+}
+
+} //namespace
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_FILTER_THREAD_H__
+#define __GALERA_FILTER_THREAD_H__
+
+#include "section-index.h"
+
+#include "common/sort-clause.h"
+#include "common/filter.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QRunnable>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSharedPointer>
+
+#include <QtContacts/QContact>
+
+namespace galera
+{
+class ContactsMap;
+
+// Filter and sort the contacts map in the thread pool. The result is a snapshot of the
+// contacts map generation used to compute it, the map changes are not applied to it,
+// this keeps the offsets and page tokens of the views stable. The snapshot can be shared
+// by several views with the same query while the generation does not change, see
+// AddressBook::sharedFilter
+class FilterThread: public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    FilterThread(const QString &filter, const QString &sort, int maxCount, bool showInvisible, ContactsMap *allContacts);
+
+    QList<QtContacts::QContact> result() const;
+    bool appendContact(const QtContacts::QContact &contact, const QDateTime &deteletedAt, const QStringList &normalizedPhones);
+    bool removeContact(const QtContacts::QContact &contact);
+    SectionIndex sectionIndex() const;
+    // opaque page token for the contact at the index, it contains the contact sort keys and id
+    QString token(int index) const;
+    // index of the first contact after the contact encoded in the token, -1 if the token is
+    // invalid or the contact is not on this result
+    int seek(const QString &token) const;
+    // return a copy of the result with a different sort, the copy is not shared
+    QSharedPointer<FilterThread> sorted(const SortClause &clause) const;
+
+    void cancel();
+    bool isRunning() const;
+    bool done() const;
+    // contacts map generation used to compute the result
+    qint64 generation() const;
+
+    // invoke the slot when the filter is done, immediately if it is already done
+    void notifyWhenDone(QObject *listener, const char *slot);
+    // views using this result, the filter can only be canceled by the last one
+    void attach();
+    int detach();
+    int views() const;
+    // estimated memory used by the result, the contacts data is shared with the contacts map
+    qint64 memoryUsage() const;
+
+    // normalized query used to share the filter between views
+    static QString key(const QString &filter, const QString &sort, int maxCount,
+                       bool showInvisible, const QStringList &sources);
+
+Q_SIGNALS:
+    void finished();
+
+protected:
+    void run();
+
+private:
+    Filter m_filter;
+    SortClause m_sortClause;
+    ContactsMap *m_allContacts;
+    QList<QtContacts::QContact> m_contacts;
+    SectionIndex m_sectionIndex;
+
+    int m_maxCount;
+    bool m_showInvisible;
+    bool m_canceled;
+    QReadWriteLock m_canceledLock;
+    bool m_running;
+    bool m_done;
+    mutable QMutex m_doneLock;
+    qint64 m_generation;
+    int m_views;
+
+    SortClause resultSort() const;
+    void notifyFinished();
+    bool checkContact(const QtContacts::QContact &contact, const QDateTime &deletedAt, const QStringList &normalizedPhones);
+    static void addSorted(QList<QtContacts::QContact> *sorted, const QtContacts::QContact &toAdd, const SortClause& sortOrder);
+};
+
+} //namespace
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory-usage.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QUrl>
+
+using namespace QtContacts;
+
+namespace galera
+{
+
+qint64 MemoryUsage::string(const QString &value)
+{
+    if (value.isNull()) {
+        return sizeof(QString);
+    }
+    return sizeof(QString) + sizeof(QArrayData) + ((value.size() + 1) * sizeof(QChar));
+}
+
+qint64 MemoryUsage::stringList(const QStringList &values)
+{
+    qint64 size = sizeof(QStringList) + sizeof(QArrayData);
+    Q_FOREACH(const QString &value, values) {
+        size += ListNodeSize + string(value);
+    }
+    return size;
+}
+
+qint64 MemoryUsage::variant(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::String:
+        return sizeof(QVariant) + string(value.toString());
+    case QVariant::StringList:
+        return sizeof(QVariant) + stringList(value.toStringList());
+    case QVariant::ByteArray:
+        return sizeof(QVariant) + sizeof(QArrayData) + value.toByteArray().size();
+    case QVariant::Url:
+        return sizeof(QVariant) + string(value.toUrl().toString());
+    default:
+        return sizeof(QVariant);
+    }
+}
+
+qint64 MemoryUsage::contact(const QContact &contact)
+{
+    qint64 size = sizeof(QContact);
+    Q_FOREACH(const QContactDetail &detail, contact.details()) {
+        // the detail private data keeps the values on a map
+        size += ListNodeSize + sizeof(QContactDetail) + (4 * sizeof(void*));
+        QMap<int, QVariant> values = detail.values();
+        QMap<int, QVariant>::const_iterator i = values.constBegin();
+        for(; i != values.constEnd(); i++) {
+            size += MapNodeSize + sizeof(int) + variant(i.value());
+        }
+    }
+    return size;
+}
+
+} //namespace
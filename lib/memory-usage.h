@@ -0,0 +1,50 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_MEMORY_USAGE_H__
+#define __GALERA_MEMORY_USAGE_H__
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+#include <QtContacts/QContact>
+
+namespace galera
+{
+
+// Rough estimate in bytes of the memory used by strings, variants and contacts, used to
+// report the memory of the service and to enforce the memory budget.
+// The allocator overhead is ignored and data shared between copies is counted on each one.
+class MemoryUsage
+{
+public:
+    static qint64 string(const QString &value);
+    static qint64 stringList(const QStringList &values);
+    static qint64 variant(const QVariant &value);
+    static qint64 contact(const QtContacts::QContact &contact);
+
+    // size of the nodes of the Qt containers without the key and the value
+    static const int HashNodeSize = 5 * sizeof(void*);
+    static const int MapNodeSize = 4 * sizeof(void*);
+    static const int ListNodeSize = sizeof(void*);
+};
+
+} //namespace
+
+#endif
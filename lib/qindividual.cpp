@@ -17,12 +17,17 @@
  */
 
 #include "qindividual.h"
+#include "avatar-store.h"
+#include "avatar-thumbnailer.h"
 #include "detail-context-parser.h"
 #include "gee-utils.h"
 #include "update-contact-request.h"
 #include "e-source-ubuntu.h"
+#include "memory-usage.h"
+#include "trace.h"
 
 #include "common/vcard-parser.h"
+#include "common/filter.h"
 
 #include <folks/folks-eds.h>
 #include <libebook/libebook.h>
@@ -145,17 +150,53 @@ static QString unaccent(const QString &value)
     return out;
 }
 
+static QList<QContactDetail::DetailType> detailTypesForProperty(const QByteArray &property)
+{
+    static QHash<QByteArray, QList<QContactDetail::DetailType> > propertyTypes;
+    if (propertyTypes.isEmpty()) {
+        QList<QContactDetail::DetailType> nameTypes;
+        nameTypes << QContactDetail::TypeDisplayLabel
+                  << QContactDetail::TypeName
+                  << QContactDetail::TypeTag
+                  << QContactDetail::TypeExtendedDetail;
+
+        propertyTypes.insert("alias", nameTypes);
+        propertyTypes.insert("full-name", nameTypes);
+        propertyTypes.insert("structured-name", nameTypes);
+        propertyTypes.insert("nickname", QList<QContactDetail::DetailType>() << QContactDetail::TypeNickname);
+        propertyTypes.insert("avatar", QList<QContactDetail::DetailType>() << QContactDetail::TypeAvatar);
+        propertyTypes.insert("birthday", QList<QContactDetail::DetailType>() << QContactDetail::TypeBirthday);
+        propertyTypes.insert("email-addresses", QList<QContactDetail::DetailType>() << QContactDetail::TypeEmailAddress);
+        propertyTypes.insert("gender", QList<QContactDetail::DetailType>() << QContactDetail::TypeGender);
+        propertyTypes.insert("im-addresses", QList<QContactDetail::DetailType>() << QContactDetail::TypeOnlineAccount);
+        propertyTypes.insert("is-favourite", QList<QContactDetail::DetailType>() << QContactDetail::TypeFavorite);
+        propertyTypes.insert("notes", QList<QContactDetail::DetailType>() << QContactDetail::TypeNote);
+        propertyTypes.insert("phone-numbers", QList<QContactDetail::DetailType>() << QContactDetail::TypePhoneNumber);
+        propertyTypes.insert("postal-addresses", QList<QContactDetail::DetailType>() << QContactDetail::TypeAddress);
+        propertyTypes.insert("roles", QList<QContactDetail::DetailType>() << QContactDetail::TypeOrganization);
+        propertyTypes.insert("urls", QList<QContactDetail::DetailType>() << QContactDetail::TypeUrl);
+    }
+
+    // properties not listed here can change anything (Eg. "personas"), TypeUndefined marks the change as unknown
+    return propertyTypes.value(property, QList<QContactDetail::DetailType>() << QContactDetail::TypeUndefined);
+}
+
 }
 
 namespace galera
 {
 bool QIndividual::m_autoLink = false;
 QStringList QIndividual::m_supportedExtendedDetails;
+QAtomicInt QIndividual::m_cachedContacts;
+QAtomicInteger<qint64> QIndividual::m_cachedContactsMemory;
+QMutex QIndividual::m_avatarCacheLock;
+QHash<QString, bool> QIndividual::m_avatarCache;
 
 QIndividual::QIndividual(FolksIndividual *individual, FolksIndividualAggregator *aggregator)
     : m_individual(0),
       m_aggregator(aggregator),
       m_contact(0),
+      m_contactMemory(0),
       m_currentUpdate(0),
       m_visible(true)
 {
@@ -391,8 +432,23 @@ void QIndividual::folksIndividualChanged(FolksIndividual *individual,
                                          GParamSpec *pspec,
                                          QIndividual *self)
 {
-    Q_UNUSED(individual);
-    Q_UNUSED(pspec);
+    // keep track of the changed details even during a contact update, they will be sent with the change notification
+    Q_FOREACH(QContactDetail::DetailType type, detailTypesForProperty(QByteArray(pspec->name))) {
+        self->m_changedDetailTypes << type;
+    }
+
+    if (qstrcmp(pspec->name, "avatar") == 0) {
+        // the avatar stored on the folks cache for this individual is out of date
+        FolksAvatarCache *cache = folks_avatar_cache_dup();
+        gchar *uri = folks_avatar_cache_build_uri_for_avatar(cache, folks_individual_get_id(individual));
+        m_avatarCacheLock.lock();
+        m_avatarCache.insert(QString::fromUtf8(uri), false);
+        m_avatarCacheLock.unlock();
+        g_free(uri);
+        g_object_unref(cache);
+
+        AvatarThumbnailer::instance()->invalidateContact(self->id());
+    }
 
     // skip update contact during a contact update, the update will be done after
     if (self->m_contactLock.tryLock()) {
@@ -403,6 +459,18 @@ void QIndividual::folksIndividualChanged(FolksIndividual *individual,
     }
 }
 
+void QIndividual::avatarThumbnailsChanged(bool notify)
+{
+    if (m_contactLock.tryLock()) {
+        markAsDirty();
+        if (notify) {
+            m_changedDetailTypes << QContactDetail::TypeAvatar;
+            notifyUpdate();
+        }
+        m_contactLock.unlock();
+    }
+}
+
 QString QIndividual::qStringFromGChar(const gchar *str)
 {
     return QString::fromUtf8(str).remove(QRegExp("[\r\n]"));
@@ -425,12 +493,30 @@ QtContacts::QContactDetail QIndividual::getPersonaPhoto(FolksPersona *persona, i
                 url = QString::fromUtf8(uri);
                 g_free(uri);
             }
-        } else {
+        } else if (G_IS_BYTES_ICON(avatarIcon)) {
+            // the contacts with the same photo share the stored file
+            url = AvatarStore::instance()->store(m_id, g_bytes_icon_get_bytes(G_BYTES_ICON(avatarIcon)));
+        }
+
+        if (url.isEmpty() && !G_IS_FILE_ICON(avatarIcon)) {
             FolksAvatarCache *cache = folks_avatar_cache_dup();
             const char *contactId = folks_individual_get_id(m_individual);
             gchar *uri = folks_avatar_cache_build_uri_for_avatar(cache, contactId);
             url = QString::fromUtf8(uri);
-            if (!QFile::exists(url)) {
+
+            // the file is only checked once, the avatar changes are tracked by folksIndividualChanged
+            bool store;
+            m_avatarCacheLock.lock();
+            QHash<QString, bool>::iterator i = m_avatarCache.find(url);
+            if (i == m_avatarCache.end()) {
+                store = !QFile::exists(QUrl(url).toLocalFile());
+            } else {
+                store = !i.value();
+            }
+            m_avatarCache.insert(url, true);
+            m_avatarCacheLock.unlock();
+
+            if (store) {
                 folks_avatar_cache_store_avatar(cache,
                                                 contactId,
                                                 avatarIcon,
@@ -446,6 +532,11 @@ QtContacts::QContactDetail QIndividual::getPersonaPhoto(FolksPersona *persona, i
         }
         avatar.setImageUrl(QUrl(url));
         avatar.setDetailUri(QString("%1.1").arg(index));
+
+        QVariantMap thumbnails = AvatarThumbnailer::instance()->thumbnails(url, m_id);
+        if (!thumbnails.isEmpty()) {
+            avatar.setValue(VCardParser::AvatarThumbnailsField, thumbnails);
+        }
     }
     return avatar;
 }
@@ -460,11 +551,19 @@ void QIndividual::avatarCacheStoreDone(GObject *source, GAsyncResult *result, gp
     if (error) {
         qWarning() << "Fail to store avatar" << error->message;
         g_error_free(error);
+        // try again on the next contact update
+        m_avatarCacheLock.lock();
+        m_avatarCache.insert(QString::fromUtf8((gchar*) data), false);
+        m_avatarCacheLock.unlock();
+    } else {
+        // the thumbnails may have been generated from the previous content
+        AvatarThumbnailer::instance()->refresh(QString::fromUtf8(uri));
     }
 
-    if (!g_str_equal(data, uri)) {
+    if (uri && !g_str_equal(data, uri)) {
         qWarning() << "Avatar name changed from" << (gchar*)data << "to" << uri;
     }
+    g_free(uri);
     g_free(data);
 }
 
@@ -880,17 +979,40 @@ QtContacts::QContact QIndividual::copy(const QContact &c, QList<QContactDetail::
 QtContacts::QContact &QIndividual::contact()
 {
     if (!m_contact && m_individual) {
+        GALERA_TRACE_SPAN("folks", "QIndividual::contact");
         QMutexLocker locker(&m_contactLock);
+        // the filter threads and the main thread can rebuild a released contact at the
+        // same time, only the first one builds it and updates the counters
+        if (m_contact) {
+            return *m_contact;
+        }
         updatePersonas();
         // avoid change on m_contact pointer until the contact is fully loaded
         QContact contact;
         contact.setId(QContactId("qtcontacts:galera:", m_id.toUtf8()));
         updateContact(&contact);
+
+        m_normalizedPhones.clear();
+        Q_FOREACH(const QContactPhoneNumber &phone, contact.details<QContactPhoneNumber>()) {
+            QString normalized = Filter::normalizePhoneNumber(phone.number());
+            if (!normalized.isEmpty()) {
+                m_normalizedPhones << normalized;
+            }
+        }
         m_contact = new QContact(contact);
+        m_contactMemory = MemoryUsage::contact(contact);
+        m_cachedContacts.ref();
+        m_cachedContactsMemory.fetchAndAddRelaxed(m_contactMemory);
     }
     return *m_contact;
 }
 
+QStringList QIndividual::normalizedPhoneNumbers()
+{
+    contact();
+    return m_normalizedPhones;
+}
+
 void QIndividual::updatePersonas()
 {
     Q_FOREACH(FolksPersona *p, m_personas.values()) {
@@ -1114,8 +1236,8 @@ void QIndividual::clear()
     }
 
     if (m_contact) {
-        delete m_contact;
-        m_contact = 0;
+        deleteContact();
+        m_normalizedPhones.clear();
     }
 }
 
@@ -1145,6 +1267,7 @@ void QIndividual::flush()
 
 bool QIndividual::markAsDeleted()
 {
+    GALERA_TRACE_SPAN("eds", "QIndividual::markAsDeleted");
     QString currentDate = QDateTime::currentDateTime().toString(Qt::ISODate);
     GeeSet *personas = folks_individual_get_personas(m_individual);
     if (!personas) {
@@ -1808,13 +1931,63 @@ void QIndividual::setExtendedDetails(FolksPersona *persona,
     }
 }
 
+QList<QContactDetail::DetailType> QIndividual::takeChangedDetailTypes()
+{
+    QList<QContactDetail::DetailType> types;
+    if (!m_changedDetailTypes.contains(QContactDetail::TypeUndefined)) {
+        types = m_changedDetailTypes.toList();
+    }
+    m_changedDetailTypes.clear();
+    return types;
+}
+
 void QIndividual::markAsDirty()
 {
-    delete m_contact;
-    m_contact = 0;
+    deleteContact();
+    m_normalizedPhones.clear();
     m_deletedAt = QDateTime();
 }
 
+void QIndividual::deleteContact()
+{
+    if (m_contact) {
+        delete m_contact;
+        m_contact = 0;
+        m_cachedContacts.deref();
+        m_cachedContactsMemory.fetchAndAddRelaxed(-m_contactMemory);
+        m_contactMemory = 0;
+    }
+}
+
+bool QIndividual::releaseContact()
+{
+    if (!m_contact || m_currentUpdate || !m_contactLock.tryLock()) {
+        return false;
+    }
+
+    deleteContact();
+    m_contactLock.unlock();
+    return true;
+}
+
+qint64 QIndividual::memoryUsage()
+{
+    qint64 size = sizeof(QIndividual) + MemoryUsage::string(m_id);
+    size += m_listeners.size() * (MemoryUsage::ListNodeSize + sizeof(QPair<QObject*, QMetaMethod>));
+
+    // the personas and phones are changed while the contact is loaded, the lock is kept
+    // during the contact update
+    if (m_contactLock.tryLock()) {
+        size += MemoryUsage::stringList(m_normalizedPhones);
+        // the personas are owned by folks, only the map is counted
+        Q_FOREACH(const QString &key, m_personas.keys()) {
+            size += MemoryUsage::MapNodeSize + MemoryUsage::string(key) + sizeof(FolksPersona*);
+        }
+        m_contactLock.unlock();
+    }
+    return size;
+}
+
 void QIndividual::enableAutoLink(bool flag)
 {
     m_autoLink = flag;
@@ -1825,6 +1998,16 @@ bool QIndividual::autoLinkEnabled()
     return m_autoLink;
 }
 
+int QIndividual::cachedContacts()
+{
+    return m_cachedContacts.load();
+}
+
+qint64 QIndividual::cachedContactsMemory()
+{
+    return m_cachedContactsMemory.load();
+}
+
 FolksPersona* QIndividual::primaryPersona()
 {
     if (m_personas.size() > 0) {
@@ -19,10 +19,13 @@
 #ifndef __GALERA_QINDIVIDUAL_H__
 #define __GALERA_QINDIVIDUAL_H__
 
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QHash>
 #include <QtCore/QString>
 #include <QtCore/QList>
 #include <QtCore/QMultiHash>
 #include <QtCore/QMutex>
+#include <QtCore/QSet>
 #include <QtCore/QDateTime>
 
 #include <QVersitProperty>
@@ -46,6 +49,8 @@ public:
 
     QString id() const;
     QtContacts::QContact &contact();
+    // phone numbers of the contact normalized with Filter::normalizePhoneNumber
+    QStringList normalizedPhoneNumbers();
     QtContacts::QContact copy(QList<QtContacts::QContactDetail::DetailType> fields);
     bool update(const QString &vcard, QObject *object, const char *slot);
     bool update(const QtContacts::QContact &contact, QObject *object, const char *slot);
@@ -59,6 +64,16 @@ public:
     QDateTime deletedAt();
     bool setVisible(bool visible);
     bool isVisible() const;
+    // return the detail types changed since the last call, an empty list means that the changes are unknown
+    QList<QtContacts::QContactDetail::DetailType> takeChangedDetailTypes();
+    // free the contact cache, the contact will be loaded again from folks when necessary;
+    // fails if the contact is being loaded or updated
+    bool releaseContact();
+    // estimated memory used by the individual without the contact cache
+    qint64 memoryUsage();
+    // the avatar thumbnails got ready, the contact will be loaded again with them,
+    // the listeners are only notified if the contact could have been fetched by a client
+    void avatarThumbnailsChanged(bool notify = true);
 
     static QtContacts::QContact copy(const QtContacts::QContact &c, QList<QtContacts::QContactDetail::DetailType> fields);
     static GHashTable *parseDetails(const QtContacts::QContact &contact);
@@ -71,10 +86,16 @@ public:
     static void enableAutoLink(bool flag);
     static bool autoLinkEnabled();
 
+    // number of contacts cached and their estimated memory
+    static int cachedContacts();
+    static qint64 cachedContactsMemory();
+
 private:
     FolksIndividual *m_individual;
     FolksIndividualAggregator *m_aggregator;
     QtContacts::QContact *m_contact;
+    qint64 m_contactMemory;
+    QStringList m_normalizedPhones;
     UpdateContactRequest *m_currentUpdate;
     QList<QPair<QObject*, QMetaMethod> > m_listeners;
     QMap<QString, FolksPersona*> m_personas;
@@ -83,9 +104,15 @@ private:
     QMetaObject::Connection m_updateConnection;
     QMutex m_contactLock;
     QDateTime m_deletedAt;
+    QSet<QtContacts::QContactDetail::DetailType> m_changedDetailTypes;
     bool m_visible;
     static bool m_autoLink;
     static QStringList m_supportedExtendedDetails;
+    static QAtomicInt m_cachedContacts;
+    static QAtomicInteger<qint64> m_cachedContactsMemory;
+    // avatars stored on the folks cache during this session, false if the content is out of date
+    static QMutex m_avatarCacheLock;
+    static QHash<QString, bool> m_avatarCache;
 
     QIndividual();
     QIndividual(const QIndividual &);
@@ -94,6 +121,7 @@ private:
 
     QMultiHash<QString, QString> parseDetails(FolksAbstractFieldDetails *details) const;
     void markAsDirty();
+    void deleteContact();
     void updateContact(QtContacts::QContact *contact) const;
     void updatePersonas();
     void clearPersonas();
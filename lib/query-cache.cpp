@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "query-cache.h"
+#include "memory-usage.h"
+
+#include <QtCore/QMutexLocker>
+
+namespace galera
+{
+
+QueryCache::QueryResult::QueryResult(const Filter &filter, bool showInvisible, const QStringList &ids, qint64 generation)
+    : m_filter(filter),
+      m_showInvisible(showInvisible),
+      m_ids(ids),
+      m_generation(generation)
+{
+}
+
+QueryCache::QueryCache(int maxSize)
+    : m_maxSize(maxSize)
+{
+}
+
+void QueryCache::insert(const Filter &filter, bool showInvisible, const QStringList &ids, qint64 generation)
+{
+    QMutexLocker locker(&m_lock);
+    m_results.prepend(QueryResult(filter, showInvisible, ids, generation));
+    while (m_results.size() > m_maxSize) {
+        m_results.removeLast();
+    }
+}
+
+bool QueryCache::candidates(const Filter &filter, bool showInvisible, qint64 generation, QStringList *ids)
+{
+    QMutexLocker locker(&m_lock);
+    int best = -1;
+    for (int i = m_results.size() - 1; i >= 0; i--) {
+        const QueryResult &result = m_results[i];
+        if (result.m_generation != generation) {
+            // the contacts changed since this result was computed
+            m_results.removeAt(i);
+            if (best > i) {
+                best--;
+            }
+            continue;
+        }
+
+        // the filter thread checks the contact visibility again
+        if ((result.m_showInvisible || !showInvisible) &&
+            filter.isNarrowerThan(result.m_filter) &&
+            ((best == -1) || (result.m_ids.size() < m_results[best].m_ids.size()))) {
+            best = i;
+        }
+    }
+
+    if (best == -1) {
+        return false;
+    }
+
+    *ids = m_results[best].m_ids;
+    m_results.move(best, 0);
+    return true;
+}
+
+void QueryCache::clear()
+{
+    QMutexLocker locker(&m_lock);
+    m_results.clear();
+}
+
+qint64 QueryCache::memoryUsage()
+{
+    QMutexLocker locker(&m_lock);
+    qint64 size = sizeof(QueryCache);
+    Q_FOREACH(const QueryResult &result, m_results) {
+        // the ids are shared with the contacts, only the list is counted
+        size += MemoryUsage::ListNodeSize + sizeof(QueryResult) +
+                MemoryUsage::string(result.m_filter.toString()) +
+                result.m_ids.size() * (MemoryUsage::ListNodeSize + sizeof(QString));
+    }
+    return size;
+}
+
+} // namespace
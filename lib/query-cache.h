@@ -0,0 +1,65 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_QUERY_CACHE_H__
+#define __GALERA_QUERY_CACHE_H__
+
+#include "common/filter.h"
+
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+#include <QtCore/QMutex>
+
+namespace galera {
+
+// Keep the result of the most recent queries. A new query which narrows one of them
+// (e.g. "jo" followed by "joh") only needs to test the contacts of the previous result.
+// The results are only valid for the contacts map generation used to compute them.
+class QueryCache
+{
+public:
+    QueryCache(int maxSize);
+
+    void insert(const Filter &filter, bool showInvisible, const QStringList &ids, qint64 generation);
+    // return the smallest cached result that contains all contacts that match the filter
+    bool candidates(const Filter &filter, bool showInvisible, qint64 generation, QStringList *ids);
+    void clear();
+    // estimated memory used by the cached results
+    qint64 memoryUsage();
+
+private:
+    class QueryResult
+    {
+    public:
+        QueryResult(const Filter &filter, bool showInvisible, const QStringList &ids, qint64 generation);
+
+        Filter m_filter;
+        bool m_showInvisible;
+        QStringList m_ids;
+        qint64 m_generation;
+    };
+
+    int m_maxSize;
+    // most recent first
+    QList<QueryResult> m_results;
+    QMutex m_lock;
+};
+
+} // namespace
+
+#endif //__GALERA_QUERY_CACHE_H__
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "section-index.h"
+#include "memory-usage.h"
+
+#include "common/sort-clause.h"
+
+#include <QtContacts/QContactTag>
+#include <QtContacts/QContactManagerEngine>
+#include <QtContacts/QContactSortOrder>
+
+#include <algorithm>
+
+using namespace QtContacts;
+
+namespace galera
+{
+
+SectionIndex::SectionIndex()
+{
+}
+
+void SectionIndex::insert(const QString &id, const QContact &contact)
+{
+    remove(id);
+
+    QString section = sectionName(contact);
+    m_idToSection.insert(id, section);
+    m_counts[section]++;
+}
+
+void SectionIndex::remove(const QString &id)
+{
+    QHash<QString, QString>::iterator it = m_idToSection.find(id);
+    if (it == m_idToSection.end()) {
+        return;
+    }
+
+    QMap<QString, int>::iterator count = m_counts.find(it.value());
+    if (count != m_counts.end()) {
+        count.value()--;
+        if (count.value() <= 0) {
+            m_counts.erase(count);
+        }
+    }
+    m_idToSection.erase(it);
+}
+
+void SectionIndex::clear()
+{
+    m_counts.clear();
+    m_idToSection.clear();
+}
+
+qint64 SectionIndex::memoryUsage() const
+{
+    qint64 size = sizeof(SectionIndex);
+    QMap<QString, int>::const_iterator c = m_counts.constBegin();
+    for(; c != m_counts.constEnd(); c++) {
+        size += MemoryUsage::MapNodeSize + MemoryUsage::string(c.key()) + sizeof(int);
+    }
+    // the section names are shared with the counts map
+    QHash<QString, QString>::const_iterator i = m_idToSection.constBegin();
+    for(; i != m_idToSection.constEnd(); i++) {
+        size += MemoryUsage::HashNodeSize + MemoryUsage::string(i.key()) + sizeof(QString);
+    }
+    return size;
+}
+
+bool SectionIndex::isEmpty() const
+{
+    return m_counts.isEmpty();
+}
+
+QStringList SectionIndex::sections() const
+{
+    // the sections must follow the same collation used to sort the contacts by tag,
+    // the raw map order would put accented letters after 'Z'
+    QStringList result = m_counts.keys();
+    std::sort(result.begin(), result.end(), sectionLessThan);
+    return result;
+}
+
+QList<int> SectionIndex::offsets() const
+{
+    QList<int> result;
+    int offset = 0;
+    Q_FOREACH(const QString &section, sections()) {
+        result << offset;
+        offset += m_counts.value(section);
+    }
+    return result;
+}
+
+QList<int> SectionIndex::counts() const
+{
+    QList<int> result;
+    Q_FOREACH(const QString &section, sections()) {
+        result << m_counts.value(section);
+    }
+    return result;
+}
+
+QString SectionIndex::sectionName(const QContact &contact)
+{
+    // the tag is already in upper case (see QIndividual::updateContact)
+    QString tag = contact.detail<QContactTag>().tag();
+    if (tag.isEmpty()) {
+        return QString("");
+    }
+
+    // group the accented letters with the base letter if the collation does the same,
+    // this keeps the contacts of each section together in the sorted list
+    QString initial = tag.left(1);
+    QString base = initial.normalized(QString::NormalizationForm_D).left(1);
+    if ((base != initial) &&
+        (compareSectionNames(initial + QLatin1Char('A'), base + QLatin1Char('B')) < 0)) {
+        return base;
+    }
+    return initial;
+}
+
+int SectionIndex::compareSectionNames(const QString &nameA, const QString &nameB)
+{
+    // same comparison used by QContactManagerEngine::compareContact for the tag,
+    // the sort clauses are always case insensitive (see SortClause)
+    return QContactManagerEngine::compareVariant(nameA, nameB, Qt::CaseInsensitive);
+}
+
+bool SectionIndex::sectionLessThan(const QString &nameA, const QString &nameB)
+{
+    // contacts without tag are sorted at the end of the list
+    if (nameA.isEmpty() || nameB.isEmpty()) {
+        return !nameA.isEmpty() && nameB.isEmpty();
+    }
+    return compareSectionNames(nameA, nameB) < 0;
+}
+
+bool SectionIndex::isSectionSort(const SortClause &sort)
+{
+    QList<QContactSortOrder> orders = sort.toContactSortOrder();
+    if (orders.isEmpty()) {
+        return false;
+    }
+
+    const QContactSortOrder &first = orders.first();
+    return ((first.detailType() == QContactDetail::TypeTag) &&
+            (first.detailField() == QContactTag::FieldTag) &&
+            (first.direction() == Qt::AscendingOrder));
+}
+
+} // namespace
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_SECTION_INDEX_H__
+#define __GALERA_SECTION_INDEX_H__
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+
+#include <QtContacts/QContact>
+
+namespace galera {
+
+class SortClause;
+
+// Count contacts by the first letter of the tag used as first key of the default sort.
+// Contacts without tag are grouped in a empty section, which is always the last one.
+// The sections are ordered with the same collation used to sort the contacts.
+class SectionIndex
+{
+public:
+    SectionIndex();
+
+    void insert(const QString &id, const QtContacts::QContact &contact);
+    void remove(const QString &id);
+    void clear();
+    bool isEmpty() const;
+    // estimated memory used by the index
+    qint64 memoryUsage() const;
+
+    // sections in the sort order with the start offset and the number of contacts of each one
+    QStringList sections() const;
+    QList<int> offsets() const;
+    QList<int> counts() const;
+
+    static QString sectionName(const QtContacts::QContact &contact);
+    // the index is only valid for lists sorted by tag
+    static bool isSectionSort(const SortClause &sort);
+
+private:
+    QMap<QString, int> m_counts;
+    QHash<QString, QString> m_idToSection;
+
+    static int compareSectionNames(const QString &nameA, const QString &nameB);
+    static bool sectionLessThan(const QString &nameA, const QString &nameB);
+};
+
+} // namespace
+
+#endif //__GALERA_SECTION_INDEX_H__
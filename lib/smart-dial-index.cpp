@@ -0,0 +1,269 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "smart-dial-index.h"
+#include "memory-usage.h"
+
+#include <QtContacts/QContactDisplayLabel>
+#include <QtContacts/QContactNickname>
+#include <QtContacts/QContactExtendedDetail>
+
+#include <algorithm>
+
+using namespace QtContacts;
+
+namespace
+{
+    // keypad digit for each letter from 'a' to 'z'
+    const char keypadLetters[] = "22233344455566677778889999";
+
+    // the keys of a name are the start of each word, the position is the word index
+    QPair<QString, QList<QPair<int, int> > > nameKeys(const QString &name)
+    {
+        QStringList words = galera::SmartDialIndex::keypadWords(name);
+        QString text;
+        QList<QPair<int, int> > keys;
+        for (int i = 0; i < words.size(); i++) {
+            keys << qMakePair(text.length(), i);
+            text += words[i];
+        }
+        return qMakePair(text, keys);
+    }
+}
+
+namespace galera
+{
+
+class SmartDialIndex::KeyLessThan
+{
+public:
+    KeyLessThan(const QVector<QString> &texts)
+        : m_texts(texts)
+    {
+    }
+
+    QStringRef ref(const Key &key) const
+    {
+        const QString &text = m_texts.at(key.text);
+        return QStringRef(&text, key.offset, text.length() - key.offset);
+    }
+
+    bool operator()(const Key &keyA, const Key &keyB) const
+    {
+        return QStringRef::compare(ref(keyA), ref(keyB)) < 0;
+    }
+
+    bool operator()(const Key &key, const QString &digits) const
+    {
+        return ref(key).compare(digits) < 0;
+    }
+
+private:
+    const QVector<QString> &m_texts;
+};
+
+SmartDialIndex::SmartDialIndex()
+    : m_deadKeys(0)
+{
+}
+
+void SmartDialIndex::insert(ContactEntry *entry, const QContact &contact, const QStringList &normalizedPhones)
+{
+    QMutexLocker locker(&m_lock);
+
+    QPair<QString, QList<QPair<int, int> > > name = nameKeys(contact.detail<QContactDisplayLabel>().label());
+    appendText(entry, name.first, name.second);
+    Q_FOREACH(const QContactNickname &nickname, contact.details<QContactNickname>()) {
+        name = nameKeys(nickname.nickname());
+        appendText(entry, name.first, name.second);
+    }
+    Q_FOREACH(const QContactExtendedDetail &xDetail, contact.details<QContactExtendedDetail>()) {
+        if (xDetail.name() == "X-NORMALIZED_FN") {
+            name = nameKeys(xDetail.data().toString());
+            appendText(entry, name.first, name.second);
+        }
+    }
+
+    // every suffix of the phone, the position is the digit offset
+    Q_FOREACH(const QString &phone, normalizedPhones) {
+        QList<QPair<int, int> > keys;
+        for (int i = 0; i < phone.length(); i++) {
+            keys << qMakePair(i, i);
+        }
+        appendText(entry, phone, keys);
+    }
+}
+
+void SmartDialIndex::appendText(ContactEntry *entry, const QString &text, const QList<QPair<int, int> > &keys)
+{
+    // the offsets and positions are stored in 16 bits
+    if (keys.isEmpty() || (text.length() > 0xffff)) {
+        return;
+    }
+
+    int textId;
+    if (m_freeTexts.isEmpty()) {
+        textId = m_texts.size();
+        m_texts.append(text);
+        m_textEntries.append(entry);
+        m_textKeys.append(keys.size());
+    } else {
+        textId = m_freeTexts.takeLast();
+        m_texts[textId] = text;
+        m_textEntries[textId] = entry;
+        m_textKeys[textId] = keys.size();
+    }
+    m_entryTexts.insert(entry, textId);
+
+    for (int i = 0; i < keys.size(); i++) {
+        Key key;
+        key.text = textId;
+        key.offset = keys[i].first;
+        key.position = qMin(keys[i].second, 0xffff);
+        m_pendingKeys.append(key);
+    }
+}
+
+void SmartDialIndex::remove(ContactEntry *entry)
+{
+    QMutexLocker locker(&m_lock);
+    // the texts are kept until the keys are dropped, the sorted keys still compare them
+    Q_FOREACH(int textId, m_entryTexts.values(entry)) {
+        m_textEntries[textId] = 0;
+        m_deadKeys += m_textKeys[textId];
+        m_removedTexts.append(textId);
+    }
+    m_entryTexts.remove(entry);
+}
+
+void SmartDialIndex::clear()
+{
+    QMutexLocker locker(&m_lock);
+    m_texts.clear();
+    m_textEntries.clear();
+    m_textKeys.clear();
+    m_entryTexts.clear();
+    m_removedTexts.clear();
+    m_freeTexts.clear();
+    m_keys.clear();
+    m_pendingKeys.clear();
+    m_deadKeys = 0;
+}
+
+void SmartDialIndex::prepare() const
+{
+    KeyLessThan lessThan(m_texts);
+    if (!m_pendingKeys.isEmpty()) {
+        std::sort(m_pendingKeys.begin(), m_pendingKeys.end(), lessThan);
+        QVector<Key> keys(m_keys.size() + m_pendingKeys.size());
+        std::merge(m_keys.constBegin(), m_keys.constEnd(),
+                   m_pendingKeys.constBegin(), m_pendingKeys.constEnd(),
+                   keys.begin(), lessThan);
+        m_keys.swap(keys);
+        m_pendingKeys.clear();
+    }
+
+    // drop the keys of the removed texts once they are the half of the index
+    if ((m_deadKeys > 0) && ((m_deadKeys * 2) >= m_keys.size())) {
+        const QVector<ContactEntry*> &textEntries = m_textEntries;
+        QVector<Key>::iterator end = std::remove_if(m_keys.begin(), m_keys.end(),
+                                                    [&textEntries](const Key &key) {
+                                                        return textEntries.at(key.text) == 0;
+                                                    });
+        m_keys.erase(end, m_keys.end());
+        m_keys.squeeze();
+        Q_FOREACH(int textId, m_removedTexts) {
+            m_texts[textId].clear();
+            m_freeTexts.append(textId);
+        }
+        m_removedTexts.clear();
+        m_deadKeys = 0;
+    }
+}
+
+qint64 SmartDialIndex::memoryUsage() const
+{
+    QMutexLocker locker(&m_lock);
+    qint64 size = sizeof(SmartDialIndex);
+    Q_FOREACH(const QString &text, m_texts) {
+        size += MemoryUsage::string(text);
+    }
+    size += m_textEntries.capacity() * sizeof(ContactEntry*);
+    size += m_textKeys.capacity() * sizeof(int);
+    size += m_entryTexts.size() * (MemoryUsage::HashNodeSize + sizeof(ContactEntry*) + sizeof(int));
+    size += (m_removedTexts.capacity() + m_freeTexts.capacity()) * sizeof(int);
+    size += (m_keys.capacity() + m_pendingKeys.capacity()) * sizeof(Key);
+    return size;
+}
+
+QHash<ContactEntry*, int> SmartDialIndex::match(const QString &digits) const
+{
+    QHash<ContactEntry*, int> result;
+    if (digits.isEmpty()) {
+        return result;
+    }
+
+    QMutexLocker locker(&m_lock);
+    prepare();
+
+    // the keys are sorted, all keys starting with the digits are together
+    KeyLessThan lessThan(m_texts);
+    QVector<Key>::const_iterator it = std::lower_bound(m_keys.constBegin(), m_keys.constEnd(), digits, lessThan);
+    for (; (it != m_keys.constEnd()) && lessThan.ref(*it).startsWith(digits); ++it) {
+        ContactEntry *entry = m_textEntries.at(it->text);
+        if (!entry) {
+            continue;
+        }
+        QHash<ContactEntry*, int>::iterator current = result.find(entry);
+        if (current == result.end()) {
+            result.insert(entry, it->position);
+        } else if (it->position < current.value()) {
+            current.value() = it->position;
+        }
+    }
+    return result;
+}
+
+QStringList SmartDialIndex::keypadWords(const QString &text)
+{
+    QStringList words;
+    QString word;
+    // decompose the accented chars, the marks are ignored
+    Q_FOREACH(const QChar &c, text.normalized(QString::NormalizationForm_D)) {
+        if (c.category() == QChar::Mark_NonSpacing) {
+            continue;
+        } else if ((c >= QLatin1Char('0')) && (c <= QLatin1Char('9'))) {
+            word += c;
+        } else if (c.isLetter()) {
+            char letter = c.toLower().toLatin1();
+            if ((letter >= 'a') && (letter <= 'z')) {
+                word += QLatin1Char(keypadLetters[letter - 'a']);
+            }
+        } else if (!word.isEmpty()) {
+            words << word;
+            word.clear();
+        }
+    }
+
+    if (!word.isEmpty()) {
+        words << word;
+    }
+    return words;
+}
+
+} // namespace
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_SMART_DIAL_INDEX_H__
+#define __GALERA_SMART_DIAL_INDEX_H__
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QVector>
+
+#include <QtContacts/QContact>
+
+namespace galera {
+
+class ContactEntry;
+
+// Map keypad digit sequences to contacts.
+// Names are indexed by word: the keypad digits of each word followed by the remaining
+// words, this way "john smith" can be found by "5646" or "76484" and by "564676484".
+// Phone numbers are indexed by suffix, which allow search for any part of the number.
+// The keypad text of each name and phone is stored once, the keys are offsets on it kept
+// in a sorted vector and compared in place. The new keys are sorted and the keys of the
+// removed entries are dropped on the next match.
+class SmartDialIndex
+{
+public:
+    SmartDialIndex();
+
+    void insert(ContactEntry *entry, const QtContacts::QContact &contact, const QStringList &normalizedPhones);
+    void remove(ContactEntry *entry);
+    void clear();
+    // estimated memory used by the index
+    qint64 memoryUsage() const;
+
+    // return the entries that match the digits and the position of the best match
+    // (the word index for names, the digit offset for phone numbers)
+    QHash<ContactEntry*, int> match(const QString &digits) const;
+
+    // split the text in words and translate each word to keypad digits
+    static QStringList keypadWords(const QString &text);
+
+private:
+    struct Key
+    {
+        quint32 text;
+        quint16 offset;
+        quint16 position;
+    };
+    class KeyLessThan;
+
+    // keypad texts and the entry of each one, the removed texts have no entry
+    // (the members changed by match are guarded by m_lock)
+    mutable QVector<QString> m_texts;
+    QVector<ContactEntry*> m_textEntries;
+    // number of keys of each text
+    QVector<int> m_textKeys;
+    QMultiHash<ContactEntry*, int> m_entryTexts;
+    // texts of removed entries, they are reused after their keys are dropped
+    mutable QVector<int> m_removedTexts;
+    mutable QVector<int> m_freeTexts;
+
+    mutable QMutex m_lock;
+    // sorted keys and the keys inserted since the last match
+    mutable QVector<Key> m_keys;
+    mutable QVector<Key> m_pendingKeys;
+    // keys of removed texts still in m_keys or m_pendingKeys
+    mutable int m_deadKeys;
+
+    // keys are pairs of offset on the text and match position
+    void appendText(ContactEntry *entry, const QString &text, const QList<QPair<int, int> > &keys);
+    void prepare() const;
+};
+
+} // namespace
+
+#endif //__GALERA_SMART_DIAL_INDEX_H__
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "startup-timeline.h"
+
+#include <QtCore/QDebug>
+
+// max number of phases recorded, avoid grow forever if the service reloads several times,
+// the ready and first query phases are always recorded
+#define STARTUP_TIMELINE_MAX_PHASES     256
+
+namespace galera
+{
+
+StartupTimeline::StartupTimeline()
+    : m_lastPhase(0),
+      m_ready(false),
+      m_queryServed(false),
+      m_individuals(0),
+      m_batches(0),
+      m_batchesPhase(-1)
+{
+    m_timer.start();
+}
+
+StartupTimeline::~StartupTimeline()
+{
+    unwatch();
+}
+
+void StartupTimeline::mark(const QString &phase, const QVariantMap &details)
+{
+    if (m_phases.size() >= STARTUP_TIMELINE_MAX_PHASES) {
+        return;
+    }
+    appendPhase(phase, details);
+}
+
+void StartupTimeline::appendPhase(const QString &phase, const QVariantMap &details)
+{
+    qint64 now = m_timer.elapsed();
+    QVariantMap entry(details);
+    entry.insert("phase", phase);
+    entry.insert("time", now);
+    entry.insert("delta", now - m_lastPhase);
+    m_phases << entry;
+    m_lastPhase = now;
+}
+
+void StartupTimeline::ready(int contacts)
+{
+    QVariantMap details;
+    details.insert("contacts", contacts);
+    details.insert("individuals", m_individuals);
+    appendPhase("ready", details);
+
+    // persona stores and batches are only watched during the first startup
+    if (!m_ready) {
+        m_ready = true;
+        unwatch();
+    }
+
+    qDebug() << "Service ready in" << m_timer.elapsed() << "ms, startup timeline:";
+    Q_FOREACH(const QVariant &phase, m_phases) {
+        QVariantMap p = phase.toMap();
+        QVariantMap details(p);
+        details.remove("phase");
+        details.remove("time");
+        details.remove("delta");
+        qDebug() << "\t" << p["time"].toLongLong() << "ms"
+                 << "(+" << p["delta"].toLongLong() << "ms)"
+                 << p["phase"].toString()
+                 << (details.isEmpty() ? QVariant() : QVariant(details));
+    }
+}
+
+void StartupTimeline::queryServed()
+{
+    if (m_ready && !m_queryServed) {
+        m_queryServed = true;
+        appendPhase("firstQuery");
+    }
+}
+
+void StartupTimeline::individualsBatch(int size)
+{
+    if (m_ready) {
+        return;
+    }
+
+    m_individuals += size;
+    m_batches++;
+    if (m_batchesPhase < 0) {
+        if (m_phases.size() >= STARTUP_TIMELINE_MAX_PHASES) {
+            return;
+        }
+        appendPhase("individualsBatch");
+        m_batchesPhase = m_phases.size() - 1;
+    }
+
+    // the batches are aggregated in a single phase, there is one batch for each
+    // folks notification and they would fill the timeline
+    qint64 now = m_timer.elapsed();
+    QVariantMap entry = m_phases[m_batchesPhase].toMap();
+    entry.insert("batches", m_batches);
+    entry.insert("total", m_individuals);
+    entry.insert("maxSize", qMax(size, entry.value("maxSize", 0).toInt()));
+    entry.insert("duration", now - entry.value("time").toLongLong());
+    m_phases[m_batchesPhase] = entry;
+    m_lastPhase = now;
+}
+
+QVariantList StartupTimeline::toList() const
+{
+    return m_phases;
+}
+
+void StartupTimeline::watchFolks()
+{
+    if (m_ready || !m_handlers.isEmpty()) {
+        return;
+    }
+
+    FolksBackendStore *backendStore = folks_backend_store_dup();
+    watch(G_OBJECT(backendStore), "backend-available", (GCallback) StartupTimeline::backendAvailable);
+
+    // backends loaded before
+    GeeCollection *backends = folks_backend_store_list_backends(backendStore);
+    GeeIterator *iter = gee_iterable_iterator(GEE_ITERABLE(backends));
+    while(gee_iterator_next(iter)) {
+        FolksBackend *backend = FOLKS_BACKEND(gee_iterator_get(iter));
+        watchBackend(backend);
+        g_object_unref(backend);
+    }
+    g_object_unref(iter);
+    g_object_unref(backends);
+    g_object_unref(backendStore);
+}
+
+void StartupTimeline::watch(GObject *object, const char *signal, GCallback callback)
+{
+    g_object_ref(object);
+    gulong id = g_signal_connect(object, signal, callback, this);
+    m_handlers << qMakePair(object, id);
+}
+
+void StartupTimeline::unwatch()
+{
+    for(int i = 0; i < m_handlers.size(); i++) {
+        g_signal_handler_disconnect(m_handlers[i].first, m_handlers[i].second);
+        g_object_unref(m_handlers[i].first);
+    }
+    m_handlers.clear();
+}
+
+void StartupTimeline::watchBackend(FolksBackend *backend)
+{
+    QString name = QString::fromUtf8(folks_backend_get_name(backend));
+    if (m_backends.contains(name)) {
+        return;
+    }
+    m_backends << name;
+    watch(G_OBJECT(backend), "persona-store-added", (GCallback) StartupTimeline::personaStoreAdded);
+
+    GeeMap *stores = folks_backend_get_persona_stores(backend);
+    GeeCollection *values = gee_map_get_values(stores);
+    GeeIterator *iter = gee_iterable_iterator(GEE_ITERABLE(values));
+    while(gee_iterator_next(iter)) {
+        FolksPersonaStore *store = FOLKS_PERSONA_STORE(gee_iterator_get(iter));
+        watchPersonaStore(store);
+        g_object_unref(store);
+    }
+    g_object_unref(iter);
+    g_object_unref(values);
+}
+
+void StartupTimeline::watchPersonaStore(FolksPersonaStore *store)
+{
+    QString id = QString::fromUtf8(folks_persona_store_get_id(store));
+    if (m_storeAddedAt.contains(id)) {
+        return;
+    }
+
+    m_storeAddedAt.insert(id, m_timer.elapsed());
+    QVariantMap details;
+    details.insert("store", id);
+    mark("personaStoreAdded", details);
+
+    if (folks_persona_store_get_is_prepared(store)) {
+        personaStoreStateChanged(store, "personaStorePrepared");
+    } else {
+        watch(G_OBJECT(store), "notify::is-prepared", (GCallback) StartupTimeline::personaStorePrepared);
+    }
+
+    if (folks_persona_store_get_is_quiescent(store)) {
+        personaStoreStateChanged(store, "personaStoreQuiescent");
+    } else {
+        watch(G_OBJECT(store), "notify::is-quiescent", (GCallback) StartupTimeline::personaStoreQuiescent);
+    }
+}
+
+void StartupTimeline::personaStoreStateChanged(FolksPersonaStore *store, const QString &state)
+{
+    QString id = QString::fromUtf8(folks_persona_store_get_id(store));
+    QVariantMap details;
+    details.insert("store", id);
+    details.insert("elapsed", m_timer.elapsed() - m_storeAddedAt.value(id, 0));
+    mark(state, details);
+}
+
+void StartupTimeline::backendAvailable(FolksBackendStore *store, FolksBackend *backend, StartupTimeline *self)
+{
+    Q_UNUSED(store);
+    QVariantMap details;
+    details.insert("backend", QString::fromUtf8(folks_backend_get_name(backend)));
+    self->mark("backendAvailable", details);
+    self->watchBackend(backend);
+}
+
+void StartupTimeline::personaStoreAdded(FolksBackend *backend, FolksPersonaStore *store, StartupTimeline *self)
+{
+    Q_UNUSED(backend);
+    self->watchPersonaStore(store);
+}
+
+void StartupTimeline::personaStorePrepared(FolksPersonaStore *store, GParamSpec *param, StartupTimeline *self)
+{
+    Q_UNUSED(param);
+    if (folks_persona_store_get_is_prepared(store)) {
+        self->personaStoreStateChanged(store, "personaStorePrepared");
+    }
+}
+
+void StartupTimeline::personaStoreQuiescent(FolksPersonaStore *store, GParamSpec *param, StartupTimeline *self)
+{
+    Q_UNUSED(param);
+    if (folks_persona_store_get_is_quiescent(store)) {
+        self->personaStoreStateChanged(store, "personaStoreQuiescent");
+    }
+}
+
+} //namespace
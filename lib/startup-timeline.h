@@ -0,0 +1,87 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_STARTUP_TIMELINE_H__
+#define __GALERA_STARTUP_TIMELINE_H__
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QVariantList>
+#include <QtCore/QVariantMap>
+
+#include <folks/folks.h>
+#include <glib.h>
+#include <glib-object.h>
+
+namespace galera
+{
+
+// Monotonic timeline of the service startup phases, the time of each phase is
+// relative to the creation of the timeline.
+class StartupTimeline
+{
+public:
+    StartupTimeline();
+    ~StartupTimeline();
+
+    void mark(const QString &phase, const QVariantMap &details = QVariantMap());
+    // mark the service as ready, the timeline is printed on the log
+    void ready(int contacts);
+    // mark the first query served after the service get ready
+    void queryServed();
+    // record the prepare time of each persona store and individuals batch
+    // until the service get ready, the batches are aggregated in a single phase
+    void watchFolks();
+    void individualsBatch(int size);
+
+    QVariantList toList() const;
+
+private:
+    QElapsedTimer m_timer;
+    QVariantList m_phases;
+    qint64 m_lastPhase;
+    bool m_ready;
+    bool m_queryServed;
+    int m_individuals;
+    int m_batches;
+    // index of the aggregated individuals batch phase
+    int m_batchesPhase;
+    QSet<QString> m_backends;
+    QHash<QString, qint64> m_storeAddedAt;
+    QList<QPair<GObject*, gulong> > m_handlers;
+
+    void appendPhase(const QString &phase, const QVariantMap &details = QVariantMap());
+    void watch(GObject *object, const char *signal, GCallback callback);
+    void unwatch();
+    void watchBackend(FolksBackend *backend);
+    void watchPersonaStore(FolksPersonaStore *store);
+    void personaStoreStateChanged(FolksPersonaStore *store, const QString &state);
+
+    static void backendAvailable(FolksBackendStore *store, FolksBackend *backend, StartupTimeline *self);
+    static void personaStoreAdded(FolksBackend *backend, FolksPersonaStore *store, StartupTimeline *self);
+    static void personaStorePrepared(FolksPersonaStore *store, GParamSpec *param, StartupTimeline *self);
+    static void personaStoreQuiescent(FolksPersonaStore *store, GParamSpec *param, StartupTimeline *self);
+};
+
+} //namespace
+
+#endif
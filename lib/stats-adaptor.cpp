@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats-adaptor.h"
+#include "addressbook.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonObject>
+
+namespace galera
+{
+
+StatsAdaptor::StatsAdaptor(AddressBook *parent)
+    : QDBusAbstractAdaptor(parent),
+      m_addressBook(parent)
+{
+}
+
+StatsAdaptor::~StatsAdaptor()
+{
+}
+
+QString StatsAdaptor::dump() const
+{
+    // histograms of time are in microseconds
+    QVariantMap stats = Stats::dump();
+    stats.insert("notifications", m_addressBook->notificationStatistics());
+    // estimated memory in bytes
+    stats.insert("memory", m_addressBook->memoryUsage());
+    return QString::fromUtf8(QJsonDocument(QJsonObject::fromVariantMap(stats)).toJson(QJsonDocument::Compact));
+}
+
+void StatsAdaptor::reset()
+{
+    Stats::reset();
+}
+
+QString StatsAdaptor::startupTimeline() const
+{
+    // list of phases with the time in ms since the service started
+    QJsonArray timeline = QJsonArray::fromVariantList(m_addressBook->startupTimeline());
+    return QString::fromUtf8(QJsonDocument(timeline).toJson(QJsonDocument::Compact));
+}
+
+QString StatsAdaptor::dumpTrace() const
+{
+    // Chrome trace format, empty if the service was built without ENABLE_TRACING
+    return QString::fromUtf8(Trace::dump());
+}
+
+} //namespace
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_STATS_ADAPTOR_H__
+#define __GALERA_STATS_ADAPTOR_H__
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+
+#include <QtDBus/QtDBus>
+
+#include "common/dbus-service-defs.h"
+
+namespace galera
+{
+class AddressBook;
+class StatsAdaptor: public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", CPIM_ADDRESSBOOK_STATS_IFACE_NAME)
+    Q_CLASSINFO("D-Bus Introspection", ""
+"  <interface name=\"com.canonical.pim.AddressBook.Stats\">\n"
+"    <method name=\"dump\">\n"
+"      <arg direction=\"out\" type=\"s\" name=\"json\"/>\n"
+"    </method>\n"
+"    <method name=\"reset\"/>\n"
+"    <method name=\"startupTimeline\">\n"
+"      <arg direction=\"out\" type=\"s\" name=\"json\"/>\n"
+"    </method>\n"
+"    <method name=\"dumpTrace\">\n"
+"      <arg direction=\"out\" type=\"s\" name=\"json\"/>\n"
+"    </method>\n"
+"  </interface>\n"
+        "")
+
+public:
+    StatsAdaptor(AddressBook *parent);
+    virtual ~StatsAdaptor();
+
+public Q_SLOTS:
+    QString dump() const;
+    void reset();
+    QString startupTimeline() const;
+    QString dumpTrace() const;
+
+private:
+    AddressBook *m_addressBook;
+};
+
+} //namespace
+
+#endif
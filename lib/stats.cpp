@@ -0,0 +1,259 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+#include <QtCore/QVariantList>
+#include <QtCore/qmath.h>
+
+namespace galera
+{
+
+StatsCounter::StatsCounter()
+    : m_value(0)
+{
+}
+
+void StatsCounter::add(qint64 value)
+{
+    m_value.fetchAndAddRelaxed(value);
+}
+
+qint64 StatsCounter::value() const
+{
+    return m_value.load();
+}
+
+void StatsCounter::reset()
+{
+    m_value.store(0);
+}
+
+StatsHistogram::StatsHistogram()
+    : m_count(0),
+      m_sum(0),
+      m_max(0)
+{
+}
+
+int StatsHistogram::bucketIndex(qint64 value)
+{
+    static const qint64 subBuckets = (1 << SubBucketBits);
+    if (value < subBuckets) {
+        return (value < 0) ? 0 : int(value);
+    }
+
+    // position of the highest bit set
+    int exponent = 0;
+    for (qint64 v = value; v > 1; v >>= 1) {
+        exponent++;
+    }
+    int subBucket = int(value >> (exponent - SubBucketBits)) & (subBuckets - 1);
+    return ((exponent - SubBucketBits + 1) << SubBucketBits) + subBucket;
+}
+
+qint64 StatsHistogram::bucketUpperBound(int index)
+{
+    static const int subBuckets = (1 << SubBucketBits);
+    if (index < subBuckets) {
+        return index;
+    }
+
+    int exponent = (index >> SubBucketBits) + SubBucketBits - 1;
+    int subBucket = index & (subBuckets - 1);
+    qint64 lowerBound = qint64(subBuckets + subBucket) << (exponent - SubBucketBits);
+    return lowerBound + (qint64(1) << (exponent - SubBucketBits)) - 1;
+}
+
+void StatsHistogram::record(qint64 value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+
+    m_buckets[bucketIndex(value)].fetchAndAddRelaxed(1);
+    m_count.fetchAndAddRelaxed(1);
+    m_sum.fetchAndAddRelaxed(value);
+
+    qint64 max = m_max.load();
+    while ((value > max) && !m_max.testAndSetRelaxed(max, value, max)) {
+        // max was updated by other thread, try again
+    }
+}
+
+qint64 StatsHistogram::count() const
+{
+    return m_count.load();
+}
+
+qint64 StatsHistogram::percentile(double p) const
+{
+    qint64 total = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        total += m_buckets[i].load();
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    qint64 rank = qMax(qint64(1), qint64(qCeil((p / 100.0) * total)));
+    qint64 accumulated = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        accumulated += m_buckets[i].load();
+        if (accumulated >= rank) {
+            return qMin(bucketUpperBound(i), m_max.load());
+        }
+    }
+    return m_max.load();
+}
+
+void StatsHistogram::reset()
+{
+    for (int i = 0; i < BucketCount; i++) {
+        m_buckets[i].store(0);
+    }
+    m_count.store(0);
+    m_sum.store(0);
+    m_max.store(0);
+}
+
+QVariantMap StatsHistogram::toMap() const
+{
+    QVariantMap map;
+    qint64 count = m_count.load();
+    map.insert("count", count);
+    map.insert("sum", m_sum.load());
+    map.insert("max", m_max.load());
+    map.insert("mean", count > 0 ? double(m_sum.load()) / count : 0.0);
+    map.insert("p50", percentile(50));
+    map.insert("p90", percentile(90));
+    map.insert("p99", percentile(99));
+    map.insert("p999", percentile(99.9));
+
+    // only the non empty buckets as pairs of [upper bound, count]
+    QVariantList buckets;
+    for (int i = 0; i < BucketCount; i++) {
+        qint64 bucketCount = m_buckets[i].load();
+        if (bucketCount > 0) {
+            buckets << QVariant(QVariantList() << bucketUpperBound(i) << bucketCount);
+        }
+    }
+    map.insert("buckets", buckets);
+    return map;
+}
+
+StatsTimer::StatsTimer(StatsHistogram *histogram)
+    : m_histogram(histogram)
+{
+    m_timer.start();
+}
+
+StatsTimer::~StatsTimer()
+{
+    m_histogram->record(m_timer.nsecsElapsed() / 1000);
+}
+
+Stats::Stats()
+{
+    m_uptime.start();
+}
+
+Stats *Stats::instance()
+{
+    static Stats stats;
+    return &stats;
+}
+
+StatsCounter *Stats::counter(const QString &name)
+{
+    Stats *self = instance();
+    self->m_lock.lockForRead();
+    StatsCounter *counter = self->m_counters.value(name, 0);
+    self->m_lock.unlock();
+
+    if (!counter) {
+        QWriteLocker locker(&self->m_lock);
+        counter = self->m_counters.value(name, 0);
+        if (!counter) {
+            counter = new StatsCounter;
+            self->m_counters.insert(name, counter);
+        }
+    }
+    return counter;
+}
+
+StatsHistogram *Stats::histogram(const QString &name)
+{
+    Stats *self = instance();
+    self->m_lock.lockForRead();
+    StatsHistogram *histogram = self->m_histograms.value(name, 0);
+    self->m_lock.unlock();
+
+    if (!histogram) {
+        QWriteLocker locker(&self->m_lock);
+        histogram = self->m_histograms.value(name, 0);
+        if (!histogram) {
+            histogram = new StatsHistogram;
+            self->m_histograms.insert(name, histogram);
+        }
+    }
+    return histogram;
+}
+
+qint64 Stats::now()
+{
+    return instance()->m_uptime.nsecsElapsed() / 1000;
+}
+
+QVariantMap Stats::dump()
+{
+    Stats *self = instance();
+    QReadLocker locker(&self->m_lock);
+
+    QVariantMap counters;
+    QMap<QString, StatsCounter*>::const_iterator c = self->m_counters.constBegin();
+    for(; c != self->m_counters.constEnd(); c++) {
+        counters.insert(c.key(), c.value()->value());
+    }
+
+    QVariantMap histograms;
+    QMap<QString, StatsHistogram*>::const_iterator h = self->m_histograms.constBegin();
+    for(; h != self->m_histograms.constEnd(); h++) {
+        histograms.insert(h.key(), h.value()->toMap());
+    }
+
+    QVariantMap result;
+    result.insert("uptime", self->m_uptime.elapsed());
+    result.insert("counters", counters);
+    result.insert("histograms", histograms);
+    return result;
+}
+
+void Stats::reset()
+{
+    Stats *self = instance();
+    QReadLocker locker(&self->m_lock);
+    Q_FOREACH(StatsCounter *counter, self->m_counters) {
+        counter->reset();
+    }
+    Q_FOREACH(StatsHistogram *histogram, self->m_histograms) {
+        histogram->reset();
+    }
+}
+
+} //namespace
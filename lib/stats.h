@@ -0,0 +1,138 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_STATS_H__
+#define __GALERA_STATS_H__
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMap>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QString>
+#include <QtCore/QVariantMap>
+
+#include "trace.h"
+
+namespace galera
+{
+
+// Counter that can be updated from any thread without locks
+class StatsCounter
+{
+public:
+    StatsCounter();
+
+    void add(qint64 value = 1);
+    qint64 value() const;
+    void reset();
+
+private:
+    QAtomicInteger<qint64> m_value;
+};
+
+// HDR style histogram: values are stored in log-linear buckets with 4 sub buckets for each
+// power of two, this keeps the error of the percentiles under 25% for any value
+// without locks and with a fixed amount of memory.
+class StatsHistogram
+{
+public:
+    StatsHistogram();
+
+    void record(qint64 value);
+    qint64 count() const;
+    qint64 percentile(double p) const;
+    void reset();
+    QVariantMap toMap() const;
+
+    static int bucketIndex(qint64 value);
+    static qint64 bucketUpperBound(int index);
+
+private:
+    static const int SubBucketBits = 2;
+    static const int BucketCount = (64 << SubBucketBits);
+
+    QAtomicInteger<qint64> m_buckets[BucketCount];
+    QAtomicInteger<qint64> m_count;
+    QAtomicInteger<qint64> m_sum;
+    QAtomicInteger<qint64> m_max;
+};
+
+// Record the time spent on the current scope in microseconds
+class StatsTimer
+{
+public:
+    StatsTimer(StatsHistogram *histogram);
+    ~StatsTimer();
+
+private:
+    StatsHistogram *m_histogram;
+    QElapsedTimer m_timer;
+};
+
+class Stats
+{
+public:
+    // the returned objects are never deleted, the call sites should keep the pointer
+    // to avoid the lookup (see GALERA_STATS_* macros)
+    static StatsCounter *counter(const QString &name);
+    static StatsHistogram *histogram(const QString &name);
+
+    // monotonic time in microseconds, used to measure asynchronous operations
+    static qint64 now();
+
+    static QVariantMap dump();
+    static void reset();
+
+private:
+    QReadWriteLock m_lock;
+    QMap<QString, StatsCounter*> m_counters;
+    QMap<QString, StatsHistogram*> m_histograms;
+    QElapsedTimer m_uptime;
+
+    Stats();
+    static Stats *instance();
+};
+
+} //namespace
+
+#define GALERA_STATS_CONCAT_(a, b) a##b
+#define GALERA_STATS_CONCAT(a, b) GALERA_STATS_CONCAT_(a, b)
+
+// increment the counter "name"
+#define GALERA_STATS_COUNT(name, value) \
+    do { \
+        static galera::StatsCounter *_statsCounter = galera::Stats::counter(QStringLiteral(name)); \
+        _statsCounter->add(value); \
+    } while(0)
+
+// record the value into the histogram "name"
+#define GALERA_STATS_RECORD(name, value) \
+    do { \
+        static galera::StatsHistogram *_statsHistogram = galera::Stats::histogram(QStringLiteral(name)); \
+        _statsHistogram->record(value); \
+    } while(0)
+
+// record the time spent until the end of the current scope into the histogram "name",
+// the scope is also traced if tracing is enabled
+#define GALERA_STATS_SCOPE(name) \
+    GALERA_TRACE_SPAN("service", name); \
+    static galera::StatsHistogram *GALERA_STATS_CONCAT(_statsHistogram, __LINE__) = \
+        galera::Stats::histogram(QStringLiteral(name)); \
+    galera::StatsTimer GALERA_STATS_CONCAT(_statsTimer, __LINE__)(GALERA_STATS_CONCAT(_statsHistogram, __LINE__))
+
+#endif
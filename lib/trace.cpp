@@ -0,0 +1,250 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+#include "stats.h"
+
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QObject>
+#include <QtCore/QVariant>
+
+// number of events kept for each thread
+#define TRACE_BUFFER_SIZE   4096
+
+namespace
+{
+
+struct TraceEvent
+{
+    // odd while the event is being written, used to skip torn events on dump
+    QAtomicInteger<quint32> sequence;
+    char phase;
+    const char *category;
+    const char *name;
+    quint64 id;
+    qint64 timestamp;
+};
+
+// Ring buffer written only by the owner thread and read by dump() from any thread
+class TraceBuffer
+{
+public:
+    TraceBuffer(int threadIndex)
+        : m_head(0),
+          m_threadIndex(threadIndex)
+    {
+    }
+
+    void append(char phase, const char *category, const char *name, quint64 id)
+    {
+        quint32 index = m_head.load();
+        TraceEvent &event = m_events[index % TRACE_BUFFER_SIZE];
+        quint32 sequence = event.sequence.load();
+
+        event.sequence.storeRelease(sequence + 1);
+        event.phase = phase;
+        event.category = category;
+        event.name = name;
+        event.id = id;
+        event.timestamp = galera::Stats::now();
+        event.sequence.storeRelease(sequence + 2);
+
+        m_head.storeRelease(index + 1);
+    }
+
+    void toJson(qint64 pid, QJsonArray *events) const
+    {
+        quint32 head = m_head.loadAcquire();
+        quint32 first = (head > TRACE_BUFFER_SIZE) ? (head - TRACE_BUFFER_SIZE) : 0;
+        for (quint32 i = first; i < head; i++) {
+            const TraceEvent &event = m_events[i % TRACE_BUFFER_SIZE];
+            quint32 sequence = event.sequence.loadAcquire();
+            if (sequence & 1) {
+                continue;
+            }
+
+            TraceEvent copy;
+            copy.phase = event.phase;
+            copy.category = event.category;
+            copy.name = event.name;
+            copy.id = event.id;
+            copy.timestamp = event.timestamp;
+            if (event.sequence.loadAcquire() != sequence) {
+                // overwritten while reading
+                continue;
+            }
+
+            QJsonObject json;
+            json.insert("ph", QString(QChar(copy.phase)));
+            json.insert("cat", QString::fromLatin1(copy.category));
+            json.insert("name", QString::fromLatin1(copy.name));
+            json.insert("ts", copy.timestamp);
+            json.insert("pid", pid);
+            json.insert("tid", m_threadIndex);
+            if ((copy.phase == 'b') || (copy.phase == 'e')) {
+                json.insert("id", QString::number(copy.id, 16));
+            }
+            events->append(json);
+        }
+    }
+
+private:
+    TraceEvent m_events[TRACE_BUFFER_SIZE];
+    QAtomicInteger<quint32> m_head;
+    int m_threadIndex;
+};
+
+// buffers are never deleted, the events of finished threads are kept for the dump
+QMutex buffersLock;
+QList<TraceBuffer*> buffers;
+// buffers of finished threads, the thread pools recreate their threads after some idle
+// time so the buffers are reused by the new threads instead of allocating a new one
+QList<TraceBuffer*> freeBuffers;
+QAtomicInteger<quint64> lastAsyncId(0);
+
+// release the buffer when the thread finishes
+class ThreadBuffer
+{
+public:
+    ThreadBuffer()
+        : buffer(0)
+    {
+    }
+
+    ~ThreadBuffer()
+    {
+        if (buffer) {
+            QMutexLocker locker(&buffersLock);
+            freeBuffers << buffer;
+        }
+    }
+
+    TraceBuffer *buffer;
+};
+
+TraceBuffer *threadBuffer()
+{
+    static thread_local ThreadBuffer thread;
+    if (!thread.buffer) {
+        QMutexLocker locker(&buffersLock);
+        if (!freeBuffers.isEmpty()) {
+            thread.buffer = freeBuffers.takeLast();
+        } else {
+            thread.buffer = new TraceBuffer(buffers.size() + 1);
+            buffers << thread.buffer;
+        }
+    }
+    return thread.buffer;
+}
+
+}
+
+namespace galera
+{
+
+void Trace::begin(const char *category, const char *name)
+{
+    threadBuffer()->append('B', category, name, 0);
+}
+
+void Trace::end(const char *category, const char *name)
+{
+    threadBuffer()->append('E', category, name, 0);
+}
+
+void Trace::asyncBegin(const char *category, const char *name, QObject *object)
+{
+    quint64 id = lastAsyncId.fetchAndAddRelaxed(1) + 1;
+    object->setProperty("TRACE_ID", id);
+    threadBuffer()->append('b', category, name, id);
+}
+
+void Trace::asyncEnd(const char *category, const char *name, QObject *object)
+{
+    quint64 id = object->property("TRACE_ID").toULongLong();
+    if (id > 0) {
+        threadBuffer()->append('e', category, name, id);
+    }
+}
+
+bool Trace::isEnabled()
+{
+#ifdef GALERA_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+QByteArray Trace::dump()
+{
+    QJsonArray events;
+    qint64 pid = QCoreApplication::applicationPid();
+    {
+        QMutexLocker locker(&buffersLock);
+        Q_FOREACH(const TraceBuffer *buffer, buffers) {
+            buffer->toJson(pid, &events);
+        }
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", events);
+    trace.insert("displayTimeUnit", QString("ms"));
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+QString Trace::dumpToFile()
+{
+    QString fileName = QDir(QDir::tempPath()).filePath(
+                QString("address-book-service-trace-%1-%2.json")
+                    .arg(QCoreApplication::applicationPid())
+                    .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss")));
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Fail to write trace file" << fileName;
+        return QString();
+    }
+    file.write(dump());
+    file.close();
+    return fileName;
+}
+
+TraceSpan::TraceSpan(const char *category, const char *name)
+    : m_category(category),
+      m_name(name)
+{
+    Trace::begin(m_category, m_name);
+}
+
+TraceSpan::~TraceSpan()
+{
+    Trace::end(m_category, m_name);
+}
+
+} //namespace
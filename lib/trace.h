@@ -0,0 +1,82 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_TRACE_H__
+#define __GALERA_TRACE_H__
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+class QObject;
+
+namespace galera
+{
+
+// Records begin and end of spans into a ring buffer for each thread, the buffer can be
+// dumped in the Chrome trace format (chrome://tracing).
+// The spans are only recorded if the service was built with ENABLE_TRACING, use the
+// GALERA_TRACE_* macros this way the calls are removed otherwise.
+// The names and categories must be string literals, only the pointers are stored.
+class Trace
+{
+public:
+    static void begin(const char *category, const char *name);
+    static void end(const char *category, const char *name);
+    // spans that finish on a different function, the id is stored on the object
+    static void asyncBegin(const char *category, const char *name, QObject *object);
+    static void asyncEnd(const char *category, const char *name, QObject *object);
+
+    static bool isEnabled();
+    static QByteArray dump();
+    static QString dumpToFile();
+};
+
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const char *name);
+    ~TraceSpan();
+
+private:
+    const char *m_category;
+    const char *m_name;
+};
+
+} //namespace
+
+#ifdef GALERA_ENABLE_TRACING
+
+#define GALERA_TRACE_CONCAT_(a, b) a##b
+#define GALERA_TRACE_CONCAT(a, b) GALERA_TRACE_CONCAT_(a, b)
+
+#define GALERA_TRACE_SPAN(category, name) \
+    galera::TraceSpan GALERA_TRACE_CONCAT(_traceSpan, __LINE__)(category, name)
+#define GALERA_TRACE_ASYNC_BEGIN(category, name, object) \
+    galera::Trace::asyncBegin(category, name, object)
+#define GALERA_TRACE_ASYNC_END(category, name, object) \
+    galera::Trace::asyncEnd(category, name, object)
+
+#else
+
+#define GALERA_TRACE_SPAN(category, name)
+#define GALERA_TRACE_ASYNC_BEGIN(category, name, object)
+#define GALERA_TRACE_ASYNC_END(category, name, object)
+
+#endif
+
+#endif
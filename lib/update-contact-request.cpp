@@ -18,8 +18,11 @@
 
 #include "update-contact-request.h"
 #include "qindividual.h"
+#include "avatar-store.h"
 #include "detail-context-parser.h"
 #include "gee-utils.h"
+#include "stats.h"
+#include "trace.h"
 
 #include "common/vcard-parser.h"
 
@@ -71,6 +74,7 @@ UpdateContactRequest::~UpdateContactRequest()
 
 void UpdateContactRequest::invokeSlot(const QString &errorMessage)
 {
+    GALERA_TRACE_ASYNC_END("eds", "UpdateContactRequest", this);
     Q_EMIT done(errorMessage);
 
     if (m_slot.isValid() && m_parent) {
@@ -88,6 +92,7 @@ void UpdateContactRequest::invokeSlot(const QString &errorMessage)
 
 void UpdateContactRequest::start()
 {
+    GALERA_TRACE_ASYNC_BEGIN("eds", "UpdateContactRequest", this);
     m_currentDetailType = QContactDetail::TypeAddress;
     m_originalContact = m_parent->contact();
     m_personas = m_parent->personas();
@@ -123,6 +128,9 @@ bool UpdateContactRequest::isEqual(const QtContacts::QContactDetail &detailA,
     switch(detailA.type()) {
     case QContactDetail::TypeFavorite:
         return detailA.value(QContactFavorite::FieldFavorite).toBool() == detailB.value(QContactFavorite::FieldFavorite).toBool();
+    case QContactDetail::TypeAvatar:
+        // the thumbnails are generated by the service
+        return detailA.value(QContactAvatar::FieldImageUrl).toUrl() == detailB.value(QContactAvatar::FieldImageUrl).toUrl();
     default:
     {
         // clear detail uri to compare only the field value
@@ -304,6 +312,28 @@ void UpdateContactRequest::updateAvatar()
                  << "\n\t" << originalDetails.size() << (originalDetails.size() > 0 ? originalDetails[0] : QContactDetail()) << "\n"
                  << "\n\t" << newDetails.size() << (newDetails.size() > 0 ? newDetails[0] : QContactDetail());
 
+        //Only supports one avatar
+        QUrl avatarUri;
+        QUrl oldAvatarUri;
+
+        if (originalDetails.count()) {
+            QContactAvatar avatar = static_cast<QContactAvatar>(originalDetails[0]);
+            oldAvatarUri = avatar.imageUrl();
+        }
+
+        if (newDetails.count()) {
+            QContactAvatar avatar = static_cast<QContactAvatar>(newDetails[0]);
+            avatarUri = avatar.imageUrl();
+        }
+
+        // the sync usually downloads the same photo to a new file, avoid writing it again
+        if (AvatarStore::sameContent(oldAvatarUri, avatarUri)) {
+            qDebug() << "avatar content did not change";
+            GALERA_STATS_COUNT("AvatarStore.unchangedUpdates", 1);
+            updateDetailsDone(0, 0, this);
+            return;
+        }
+
         // update avatar version if necessary
         QContactExtendedDetail originalAvatarRev;
         QContactExtendedDetail newAvatarRev;
@@ -327,20 +357,6 @@ void UpdateContactRequest::updateAvatar()
             m_newContact.saveDetail(&newAvatarRev);
         }
 
-        //Only supports one avatar
-        QUrl avatarUri;
-        QUrl oldAvatarUri;
-
-        if (originalDetails.count()) {
-            QContactAvatar avatar = static_cast<QContactAvatar>(originalDetails[0]);
-            oldAvatarUri = avatar.imageUrl();
-        }
-
-        if (newDetails.count()) {
-            QContactAvatar avatar = static_cast<QContactAvatar>(newDetails[0]);
-            avatarUri = avatar.imageUrl();
-        }
-
         if ((avatarUri != oldAvatarUri) &&
             (avatarUri.isLocalFile() || avatarUri.isEmpty())){
             GFileIcon *avatarFileIcon = NULL;
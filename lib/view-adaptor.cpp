@@ -18,6 +18,8 @@
 
 #include "view-adaptor.h"
 #include "view.h"
+#include "stats.h"
+#include "workload-recorder.h"
 
 namespace galera
 {
@@ -41,8 +43,10 @@ void ViewAdaptor::destroy()
     this->deleteLater();
 }
 
-QString ViewAdaptor::contactDetails(const QStringList &fields, const QString &id)
+QString ViewAdaptor::contactDetails(const QStringList &fields, const QString &id, const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBookView.contactDetails");
+    GALERA_WORKLOAD_RECORD(message, fields << id);
     if (m_view) {
         return m_view->contactDetails(fields, id);
     } else {
@@ -52,6 +56,8 @@ QString ViewAdaptor::contactDetails(const QStringList &fields, const QString &id
 
 QStringList ViewAdaptor::contactsDetails(const QStringList &fields, int startIndex, int pageSize, const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBookView.contactsDetails");
+    GALERA_WORKLOAD_RECORD(message, fields << startIndex << pageSize);
     if (m_view) {
         message.setDelayedReply(true);
         m_view->contactsDetails(fields, startIndex, pageSize, message);
@@ -59,6 +65,19 @@ QStringList ViewAdaptor::contactsDetails(const QStringList &fields, int startInd
     return QStringList();
 }
 
+QStringList ViewAdaptor::contactsDetailsFrom(const QStringList &fields, const QString &token, int pageSize,
+                                             const QDBusMessage &message, QString &nextToken)
+{
+    GALERA_STATS_SCOPE("AddressBookView.contactsDetailsFrom");
+    GALERA_WORKLOAD_RECORD(message, fields << token << pageSize);
+    Q_UNUSED(nextToken);
+    if (m_view) {
+        message.setDelayedReply(true);
+        m_view->contactsDetailsFrom(fields, token, pageSize, message);
+    }
+    return QStringList();
+}
+
 int ViewAdaptor::count()
 {
     if (m_view) {
@@ -68,15 +87,30 @@ int ViewAdaptor::count()
     }
 }
 
-void ViewAdaptor::sort(const QString &field)
+QStringList ViewAdaptor::sectionIndex(const QDBusMessage &message, QList<int> &offsets, QList<int> &counts)
+{
+    GALERA_STATS_SCOPE("AddressBookView.sectionIndex");
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
+    if (m_view) {
+        return m_view->sectionIndex(offsets, counts);
+    } else {
+        return QStringList();
+    }
+}
+
+void ViewAdaptor::sort(const QString &field, const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBookView.sort");
+    GALERA_WORKLOAD_RECORD(message, field);
     if (m_view) {
         return m_view->sort(field);
     }
 }
 
-void ViewAdaptor::close()
+void ViewAdaptor::close(const QDBusMessage &message)
 {
+    GALERA_STATS_SCOPE("AddressBookView.close");
+    GALERA_WORKLOAD_RECORD_NO_ARGS(message);
     if (m_view) {
         return m_view->close();
     }
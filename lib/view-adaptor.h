@@ -59,11 +59,23 @@ class ViewAdaptor: public QDBusAbstractAdaptor
 "      <arg direction=\"in\" type=\"i\" name=\"pageSize\"/>\n"
 "      <arg direction=\"out\" type=\"as\"/>\n"
 "    </method>\n"
+"    <method name=\"contactsDetailsFrom\">\n"
+"      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
+"      <arg direction=\"in\" type=\"s\" name=\"token\"/>\n"
+"      <arg direction=\"in\" type=\"i\" name=\"pageSize\"/>\n"
+"      <arg direction=\"out\" type=\"as\" name=\"vcards\"/>\n"
+"      <arg direction=\"out\" type=\"s\" name=\"nextToken\"/>\n"
+"    </method>\n"
 "    <method name=\"contactDetails\">\n"
 "      <arg direction=\"in\" type=\"as\" name=\"fields\"/>\n"
 "      <arg direction=\"in\" type=\"s\" name=\"id\"/>\n"
 "      <arg direction=\"out\" type=\"s\"/>\n"
 "    </method>\n"
+"    <method name=\"sectionIndex\">\n"
+"      <arg direction=\"out\" type=\"as\" name=\"sections\"/>\n"
+"      <arg direction=\"out\" type=\"ai\" name=\"offsets\"/>\n"
+"      <arg direction=\"out\" type=\"ai\" name=\"counts\"/>\n"
+"    </method>\n"
 "    <method name=\"close\"/>\n"
 "  </interface>\n"
         "")
@@ -74,11 +86,14 @@ public:
     void destroy();
 
 public Q_SLOTS:
-    QString contactDetails(const QStringList &fields, const QString &id);
+    QString contactDetails(const QStringList &fields, const QString &id, const QDBusMessage &message);
     QStringList contactsDetails(const QStringList &fields, int startIndex, int pageSize, const QDBusMessage &message);
+    QStringList contactsDetailsFrom(const QStringList &fields, const QString &token, int pageSize,
+                                    const QDBusMessage &message, QString &nextToken);
     int count();
-    void sort(const QString &field);
-    void close();
+    QStringList sectionIndex(const QDBusMessage &message, QList<int> &offsets, QList<int> &counts);
+    void sort(const QString &field, const QDBusMessage &message);
+    void close(const QDBusMessage &message);
 
 Q_SIGNALS:
     void contactsAdded(int pos, int length);
@@ -19,8 +19,10 @@
 #include "view.h"
 #include "view-adaptor.h"
 #include "contacts-map.h"
-#include "contact-less-than.h"
 #include "qindividual.h"
+#include "filter-thread.h"
+#include "section-index.h"
+#include "stats.h"
 
 #include "common/vcard-parser.h"
 #include "common/filter.h"
@@ -28,10 +30,10 @@
 #include "common/dbus-service-defs.h"
 
 #include <QtContacts/QContact>
+#include <QtContacts/QContactGuid>
 
 #include <QtVersit/QVersitDocument>
 
-#include <QtCore/QReadWriteLock>
 #include <QtCore/QCoreApplication>
 
 using namespace QtContacts;
@@ -40,207 +42,16 @@ using namespace QtVersit;
 namespace galera
 {
 
-class FilterThread: public QRunnable
-{
-public:
-    FilterThread(QString filter, QString sort, int maxCount, bool showInvisible, ContactsMap *allContacts, QObject *parent)
-        : m_parent(parent),
-          m_filter(filter),
-          m_sortClause(sort),
-          m_maxCount(maxCount),
-          m_allContacts(allContacts),
-          m_showInvisible(showInvisible),
-          m_canceled(false),
-          m_running(false),
-          m_done(false)
-    {
-        setAutoDelete(false);
-    }
-
-    QList<QContact> result() const
-    {
-        if (isRunning()) {
-            return QList<QContact>();
-        } else {
-            return m_contacts;
-        }
-    }
-
-    bool appendContact(const QContact &contact, const QDateTime &deteletedAt)
-    {
-        if (checkContact(contact, deteletedAt)) {
-            addSorted(&m_contacts, contact, m_sortClause);
-            return true;
-        }
-        return false;
-    }
-
-    bool removeContact(const QContact &contact)
-    {
-        return m_contacts.removeAll(contact);
-    }
-
-    void chageSort(SortClause clause)
-    {
-        m_sortClause = clause;
-        if (!clause.isEmpty()) {
-            ContactLessThan lessThan(m_sortClause);
-            qSort(m_contacts.begin(), m_contacts.end(), lessThan);
-        }
-    }
-
-    void addSorted(QList<QContact> *sorted, const QContact &toAdd, const SortClause& sortOrder)
-    {
-        if (!sortOrder.isEmpty()) {
-            ContactLessThan lessThan(sortOrder);
-            QList<QContact>::iterator it(std::upper_bound(sorted->begin(), sorted->end(), toAdd, lessThan));
-            sorted->insert(it, toAdd);
-        } else {
-            // no sort order just add it to the end
-            sorted->append(toAdd);
-        }
-    }
-
-    void cancel()
-    {
-        m_canceledLock.lockForWrite();
-        m_canceled = true;
-        m_canceledLock.unlock();
-    }
-
-    bool isRunning() const
-    {
-        return m_running;
-    }
-
-    bool done() const
-    {
-        return m_done;
-    }
-
-protected:
-    void notifyFinished()
-    {
-        m_running = false;
-        m_done = true;
-        QMetaObject::invokeMethod(m_parent, "onFilterDone", Qt::QueuedConnection);
-    }
-
-    void run()
-    {
-        if (m_canceled || !m_allContacts) {
-            notifyFinished();
-            return;
-        }
-
-        m_allContacts->lockForRead();
-        // only sort contacts if the contacts was stored in a different order into the contacts map
-        bool needSort = (!m_sortClause.isEmpty() &&
-                         (m_sortClause.toContactSortOrder() != m_allContacts->sort().toContactSortOrder()));
-        // filter contacts if necessary
-        if (m_filter.isValid() && m_filter.isEmpty()) {
-            Q_FOREACH(ContactEntry *entry, m_allContacts->values()) {
-                if ((m_showInvisible || entry->individual()->isVisible()) &&
-                    !entry->individual()->deletedAt().isValid()) {
-
-                    QContact contact = entry->individual()->contact();
-
-                    if (needSort) {
-                        addSorted(&m_contacts, contact, m_sortClause);
-                    } else {
-                        m_contacts.append(contact);
-                    }
-
-                    if ((m_maxCount > 0) && (m_maxCount >= m_contacts.size())) {
-                        break;
-                    }
-                }
-            }
-        } else if (m_filter.isValid()) {
-            // optmization
-            QList<ContactEntry *> preFilter;
-
-            // check if is a query by id
-            QStringList idsToFilter = m_filter.idsToFilter();
-            if (!idsToFilter.isEmpty()) {
-                preFilter = m_allContacts->values(idsToFilter);
-            } else {
-                // check if is a phone number query
-                QString phoneToFilter = m_filter.phoneNumberToFilter();
-                if (!phoneToFilter.isEmpty()) {
-                    preFilter = m_allContacts->valueByPhone(phoneToFilter);
-                } else {
-                    qDebug() << "Filter not optimized" << m_filter.toContactFilter();
-                    preFilter = m_allContacts->values();
-                }
-            }
-
-            Q_FOREACH(ContactEntry *entry, preFilter) {
-                m_canceledLock.lockForRead();
-                if (m_canceled) {
-                    m_canceledLock.unlock();
-                    m_allContacts->unlock();
-                    notifyFinished();
-                    return;
-                }
-
-                QContact contact = entry->individual()->contact();
-                QDateTime deletedAt = entry->individual()->deletedAt();
-                m_canceledLock.unlock();
-
-                if ((m_showInvisible || entry->individual()->isVisible()) &&
-                    checkContact(contact, deletedAt)) {
-                    if (needSort) {
-                        addSorted(&m_contacts, contact, m_sortClause);
-                    } else {
-                        m_contacts.append(contact);
-                    }
-                    if ((m_maxCount > 0) && (m_contacts.size() >= m_maxCount)) {
-                        break;
-                    }
-                }
-            }
-        } else {
-            // invalid filter
-            m_contacts.clear();
-        }
-
-        m_allContacts->unlock();
-        notifyFinished();
-    }
-
-private:
-    QObject *m_parent;
-    Filter m_filter;
-    SortClause m_sortClause;
-    ContactsMap *m_allContacts;
-    QList<QContact> m_contacts;
-
-    int m_maxCount;
-    bool m_showInvisible;
-    bool m_canceled;
-    QReadWriteLock m_canceledLock;
-    bool m_running;
-    bool m_done;
-
-    bool checkContact(const QContact &contact, const QDateTime &deletedAt)
-    {
-        return m_filter.test(contact, deletedAt);
-    }
-};
-
-View::View(const QString &clause, const QString &sort, int maxCount, bool showInvisible,
-           const QStringList &sources, ContactsMap *allContacts,
-           QObject *parent)
+View::View(QSharedPointer<FilterThread> filterThread, const QStringList &sources, QObject *parent)
     : QObject(parent),
       m_sources(sources),
-      m_filterThread(new FilterThread(clause, sort, maxCount, showInvisible, allContacts, this)),
+      m_filterThread(filterThread),
       m_adaptor(0),
-      m_waiting(0)
+      m_waiting(0),
+      m_lastAccess(Stats::now())
 {
-    if (allContacts) {
-        QThreadPool::globalInstance()->start(m_filterThread);
-    }
+    m_filterThread->attach();
+    m_filterThread->notifyWhenDone(this, SLOT(onFilterDone()));
 }
 
 View::~View()
@@ -261,12 +72,12 @@ void View::close()
     }
 
     if (m_filterThread) {
-        if (!m_filterThread->done()) {
+        // the filter is shared with other views, only the last one can cancel it
+        if ((m_filterThread->detach() == 0) && !m_filterThread->done()) {
             m_filterThread->cancel();
             waitFilter();
         }
-        delete m_filterThread;
-        m_filterThread = 0;
+        m_filterThread.clear();
     }
 }
 
@@ -275,6 +86,20 @@ bool View::isOpen() const
     return (m_adaptor != 0);
 }
 
+qint64 View::lastAccess() const
+{
+    return m_lastAccess;
+}
+
+qint64 View::memoryUsage() const
+{
+    qint64 size = sizeof(View);
+    if (m_filterThread) {
+        size += m_filterThread->memoryUsage() / qMax(1, m_filterThread->views());
+    }
+    return size;
+}
+
 QString View::contactDetails(const QStringList &fields, const QString &id)
 {
     Q_ASSERT(FALSE);
@@ -287,6 +112,41 @@ QStringList View::contactsDetails(const QStringList &fields, int startIndex, int
         return QStringList();
     }
 
+    parseContactsPage(fields, startIndex, pageSize, message, PageReply);
+    return QStringList();
+}
+
+QStringList View::contactsDetailsFrom(const QStringList &fields, const QString &token, int pageSize, const QDBusMessage &message)
+{
+    if (!m_filterThread || !isOpen()) {
+        return QStringList();
+    }
+
+    waitFilter();
+
+    // an empty token starts from the beginning of the view
+    int startIndex = token.isEmpty() ? 0 : m_filterThread->seek(token);
+    if (startIndex < 0) {
+        QDBusMessage reply = message.createErrorReply(QDBusError::InvalidArgs, "Invalid page token");
+        QDBusConnection::sessionBus().send(reply);
+        return QStringList();
+    }
+
+    parseContactsPage(fields, startIndex, pageSize, message, PageWithTokenReply);
+    return QStringList();
+}
+
+void View::firstPageDetails(const QStringList &fields, int pageSize, const QDBusMessage &message)
+{
+    // the reply will contain the view path and the first page of contacts
+    parseContactsPage(fields, 0, pageSize, message, FirstPageReply);
+}
+
+void View::parseContactsPage(const QStringList &fields, int startIndex, int pageSize,
+                             const QDBusMessage &message, PageReplyType replyType)
+{
+    qint64 start = Stats::now();
+    m_lastAccess = start;
     waitFilter();
 
     const QList<QContact> &contacts = m_filterThread->result();
@@ -305,17 +165,58 @@ QStringList View::contactsDetails(const QStringList &fields, int startIndex, int
 
     VCardParser *parser = new VCardParser(this);
     parser->setProperty("DATA", QVariant::fromValue<QDBusMessage>(message));
+    parser->setProperty("REPLY_TYPE", replyType);
+    parser->setProperty("STATS_START", start);
+    parser->setProperty("STATS_PARSE_START", Stats::now());
+    parser->setProperty("CONTACTS", pageOfContacts.size());
+    GALERA_TRACE_ASYNC_BEGIN("dbus", "AddressBookView.page.reply", parser);
+    if (replyType == PageWithTokenReply) {
+        // the last page does not have a continuation token
+        int lastIndex = startIndex + pageOfContacts.size() - 1;
+        bool hasMore = (lastIndex >= startIndex) && ((lastIndex + 1) < contacts.count());
+        parser->setProperty("NEXT_TOKEN", hasMore ? m_filterThread->token(lastIndex) : QString());
+    }
     connect(parser, &VCardParser::vcardParsed,
             this, &View::onVCardParsed);
     parser->contactToVcard(pageOfContacts);
-    return QStringList();
 }
 
 void View::onVCardParsed(const QStringList &vcards)
 {
     QObject *sender = QObject::sender();
-    QDBusMessage reply = sender->property("DATA").value<QDBusMessage>().createReply(vcards);
+    QDBusMessage message = sender->property("DATA").value<QDBusMessage>();
+    QDBusMessage reply;
+    switch (sender->property("REPLY_TYPE").toInt()) {
+    case FirstPageReply:
+        reply = message.createReply(QVariantList() << QVariant::fromValue(QDBusObjectPath(dynamicObjectPath()))
+                                                   << vcards);
+        break;
+    case PageWithTokenReply:
+        reply = message.createReply(QVariantList() << vcards
+                                                   << sender->property("NEXT_TOKEN").toString());
+        break;
+    default:
+        reply = message.createReply(vcards);
+        break;
+    }
     QDBusConnection::sessionBus().send(reply);
+
+    qint64 now = Stats::now();
+    GALERA_STATS_RECORD("VCardParser.contactToVcard", now - sender->property("STATS_PARSE_START").toLongLong());
+    // the first page is also replied by this function
+    qint64 elapsed = now - sender->property("STATS_START").toLongLong();
+    switch (sender->property("REPLY_TYPE").toInt()) {
+    case FirstPageReply:
+        GALERA_STATS_RECORD("AddressBook.queryFirstPage.reply", elapsed);
+        break;
+    case PageWithTokenReply:
+        GALERA_STATS_RECORD("AddressBookView.contactsDetailsFrom.reply", elapsed);
+        break;
+    default:
+        GALERA_STATS_RECORD("AddressBookView.contactsDetails.reply", elapsed);
+        break;
+    }
+    GALERA_TRACE_ASYNC_END("dbus", "AddressBookView.page.reply", sender);
     sender->deleteLater();
 }
 
@@ -325,11 +226,13 @@ void View::onFilterDone()
         m_waiting->quit();
         m_waiting = 0;
     }
+    Q_EMIT filterDone();
 }
 
 void View::waitFilter()
 {
     if (m_filterThread && !m_filterThread->done()) {
+        GALERA_TRACE_SPAN("view", "View::waitFilter");
         QEventLoop loop;
         m_waiting = &loop;
         loop.exec();
@@ -342,18 +245,57 @@ int View::count()
         return 0;
     }
 
+    m_lastAccess = Stats::now();
     waitFilter();
 
     return m_filterThread->result().count();
 }
 
+QStringList View::contactsIds()
+{
+    if (!m_filterThread) {
+        return QStringList();
+    }
+
+    waitFilter();
+
+    QStringList ids;
+    const QList<QContact> &contacts = m_filterThread->result();
+    ids.reserve(contacts.size());
+    Q_FOREACH(const QContact &contact, contacts) {
+        ids << contact.detail<QContactGuid>().guid();
+    }
+    return ids;
+}
+
+QStringList View::sectionIndex(QList<int> &offsets, QList<int> &counts)
+{
+    if (!m_filterThread || !isOpen()) {
+        return QStringList();
+    }
+
+    m_lastAccess = Stats::now();
+    waitFilter();
+
+    SectionIndex index = m_filterThread->sectionIndex();
+    offsets = index.offsets();
+    counts = index.counts();
+    return index.sections();
+}
+
 void View::sort(const QString &field)
 {
     if (!isOpen()) {
         return;
     }
 
-    m_filterThread->chageSort(SortClause(field));
+    // the current result can be shared with other views, sort a copy of it
+    m_lastAccess = Stats::now();
+    waitFilter();
+    QSharedPointer<FilterThread> sorted = m_filterThread->sorted(SortClause(field));
+    m_filterThread->detach();
+    m_filterThread = sorted;
+    m_filterThread->attach();
 }
 
 QString View::objectPath()
@@ -397,7 +339,8 @@ bool View::appendContact(ContactEntry *entry)
     }
 
     if (m_filterThread->appendContact(entry->individual()->contact(),
-                                      entry->individual()->deletedAt())) {
+                                      entry->individual()->deletedAt(),
+                                      entry->individual()->normalizedPhoneNumbers())) {
         Q_EMIT countChanged(m_filterThread->result().count());
         return true;
     }
@@ -24,6 +24,7 @@
 
 #include <QtCore/QString>
 #include <QtCore/QStringList>
+#include <QtCore/QSharedPointer>
 #include <QtDBus/QtDBus>
 
 #include <QtContacts/QContactFilter>
@@ -42,7 +43,7 @@ class View : public QObject
     Q_PROPERTY(int count READ count NOTIFY countChanged)
 
 public:
-    View(const QString &clause, const QString &sort, int maxCount, bool showInvisible, const QStringList &sources, ContactsMap *allContacts, QObject *parent);
+    View(QSharedPointer<FilterThread> filterThread, const QStringList &sources, QObject *parent);
     ~View();
 
     static QString objectPath();
@@ -58,13 +59,24 @@ public:
     // Adaptor
     QString contactDetails(const QStringList &fields, const QString &id);
     int count();
+    QStringList contactsIds();
+    // first letters of the contacts with the start offset and the number of contacts of each one,
+    // empty if the view is not sorted by the default sort
+    QStringList sectionIndex(QList<int> &offsets, QList<int> &counts);
     void sort(const QString &field);
     void close();
 
     bool isOpen() const;
+    // time of the last call done by the client (see Stats::now)
+    qint64 lastAccess() const;
+    // estimated memory used by the view, a result shared by several views is split between them
+    qint64 memoryUsage() const;
 
 public Q_SLOTS:
     QStringList contactsDetails(const QStringList &fields, int startIndex, int pageSize, const QDBusMessage &message);
+    // page starting after the contact encoded in the token, the reply contains the token of the next page
+    QStringList contactsDetailsFrom(const QStringList &fields, const QString &token, int pageSize, const QDBusMessage &message);
+    void firstPageDetails(const QStringList &fields, int pageSize, const QDBusMessage &message);
     void onFilterDone();
 
 private Q_SLOTS:
@@ -73,14 +85,24 @@ private Q_SLOTS:
 Q_SIGNALS:
     void closed();
     void countChanged(int count=0);
+    void filterDone();
 
 private:
+    enum PageReplyType {
+        PageReply = 0,
+        FirstPageReply,
+        PageWithTokenReply
+    };
+
     QStringList m_sources;
-    FilterThread *m_filterThread;
+    QSharedPointer<FilterThread> m_filterThread;
     ViewAdaptor *m_adaptor;
     QEventLoop *m_waiting;
+    qint64 m_lastAccess;
 
     void waitFilter();
+    void parseContactsPage(const QStringList &fields, int startIndex, int pageSize,
+                           const QDBusMessage &message, PageReplyType replyType);
 };
 
 } //namespace
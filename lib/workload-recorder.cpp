@@ -0,0 +1,181 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "workload-recorder.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+
+// "GWLD"
+#define WORKLOAD_FILE_MAGIC     0x47574c44
+#define WORKLOAD_FILE_VERSION   1
+
+namespace galera
+{
+
+WorkloadRecorder *WorkloadRecorder::m_instance = 0;
+
+WorkloadRecorder::WorkloadRecorder(const QString &fileName)
+    : m_file(fileName)
+{
+}
+
+WorkloadRecorder::~WorkloadRecorder()
+{
+    m_file.close();
+}
+
+bool WorkloadRecorder::start(const QString &fileName)
+{
+    if (m_instance) {
+        qWarning() << "Workload recorder already running";
+        return false;
+    }
+
+    WorkloadRecorder *recorder = new WorkloadRecorder(fileName);
+    if (!recorder->m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Fail to open workload file" << fileName << recorder->m_file.errorString();
+        delete recorder;
+        return false;
+    }
+
+    recorder->m_stream.setDevice(&recorder->m_file);
+    recorder->m_stream.setVersion(QDataStream::Qt_5_0);
+    recorder->m_stream << quint32(WORKLOAD_FILE_MAGIC)
+                       << quint32(WORKLOAD_FILE_VERSION)
+                       << QDateTime::currentDateTimeUtc();
+    recorder->m_elapsed.start();
+    m_instance = recorder;
+    qDebug() << "Recording workload on" << fileName;
+    return true;
+}
+
+void WorkloadRecorder::stop()
+{
+    delete m_instance;
+    m_instance = 0;
+}
+
+WorkloadRecorder *WorkloadRecorder::instance()
+{
+    return m_instance;
+}
+
+void WorkloadRecorder::record(const WorkloadCall &call)
+{
+    m_stream << call.offset
+             << call.duration
+             << call.delayed
+             << call.sender
+             << call.path
+             << call.interface
+             << call.member
+             << call.arguments
+             << call.result;
+    if (m_stream.status() != QDataStream::Ok) {
+        qWarning() << "Fail to write workload file, recording stopped" << m_file.errorString();
+        stop();
+    }
+}
+
+QList<WorkloadCall> WorkloadRecorder::load(const QString &fileName, QString *errorMessage)
+{
+    QList<WorkloadCall> calls;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return calls;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QDateTime startTime;
+    stream >> magic >> version >> startTime;
+    if ((magic != WORKLOAD_FILE_MAGIC) || (version != WORKLOAD_FILE_VERSION)) {
+        if (errorMessage) {
+            *errorMessage = QStringLiteral("Invalid workload file");
+        }
+        return calls;
+    }
+
+    while (!stream.atEnd()) {
+        WorkloadCall call;
+        stream >> call.offset
+               >> call.duration
+               >> call.delayed
+               >> call.sender
+               >> call.path
+               >> call.interface
+               >> call.member
+               >> call.arguments
+               >> call.result;
+        // the service can be killed in the middle of a record
+        if (stream.status() != QDataStream::Ok) {
+            qWarning() << "Workload file truncated after" << calls.size() << "calls";
+            break;
+        }
+        calls << call;
+    }
+    return calls;
+}
+
+WorkloadScope::WorkloadScope(const QDBusMessage &message)
+    : m_recorder(WorkloadRecorder::instance()),
+      m_message(message)
+{
+    if (m_recorder) {
+        m_call.offset = m_recorder->m_elapsed.nsecsElapsed() / 1000;
+        m_timer.start();
+    }
+}
+
+WorkloadScope::~WorkloadScope()
+{
+    // the recorder can be stopped during the call
+    if (m_recorder && (m_recorder == WorkloadRecorder::instance())) {
+        m_call.duration = m_timer.nsecsElapsed() / 1000;
+        m_call.delayed = m_message.isDelayedReply();
+        m_call.sender = m_message.service();
+        m_call.path = m_message.path();
+        m_call.interface = m_message.interface();
+        m_call.member = m_message.member();
+        m_recorder->record(m_call);
+    }
+}
+
+bool WorkloadScope::isActive() const
+{
+    return (m_recorder != 0);
+}
+
+void WorkloadScope::setArguments(const QVariantList &arguments)
+{
+    m_call.arguments = arguments;
+}
+
+void WorkloadScope::setResult(const QString &result)
+{
+    m_call.result = result;
+}
+
+} //namespace
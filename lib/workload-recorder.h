@@ -0,0 +1,114 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_WORKLOAD_RECORDER_H__
+#define __GALERA_WORKLOAD_RECORDER_H__
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QDataStream>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QVariantList>
+
+#include <QtDBus/QDBusMessage>
+
+namespace galera
+{
+
+// A D-Bus call received by the service
+struct WorkloadCall
+{
+    WorkloadCall() : offset(0), duration(0), delayed(false) {}
+
+    qint64 offset;          // microseconds since the recording started
+    qint64 duration;        // microseconds spent on the adaptor
+    bool delayed;           // the reply was sent later, the duration does not include it
+    QString sender;
+    QString path;
+    QString interface;
+    QString member;
+    QVariantList arguments;
+    QString result;         // object path of the view created by the call
+};
+
+// Saves the calls received by the adaptors into a binary file that can be replayed
+// with address-book-replay. The recorder is only created if the service is started with
+// ADDRESS_BOOK_RECORD_WORKLOAD=<file>; the file contains the arguments of the calls
+// including the vcards and the search clauses.
+// All functions must be called from the main thread.
+class WorkloadRecorder
+{
+public:
+    static bool start(const QString &fileName);
+    static void stop();
+    static WorkloadRecorder *instance();
+
+    void record(const WorkloadCall &call);
+
+    static QList<WorkloadCall> load(const QString &fileName, QString *errorMessage = 0);
+
+private:
+    static WorkloadRecorder *m_instance;
+
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_elapsed;
+
+    WorkloadRecorder(const QString &fileName);
+    ~WorkloadRecorder();
+
+    friend class WorkloadScope;
+};
+
+// Record the call received on the current scope, does nothing if the recorder is not running
+class WorkloadScope
+{
+public:
+    WorkloadScope(const QDBusMessage &message);
+    ~WorkloadScope();
+
+    bool isActive() const;
+    void setArguments(const QVariantList &arguments);
+    void setResult(const QString &result);
+
+private:
+    WorkloadRecorder *m_recorder;
+    const QDBusMessage &m_message;
+    WorkloadCall m_call;
+    QElapsedTimer m_timer;
+};
+
+} //namespace
+
+// record the call "message" and the arguments until the end of the current scope, the
+// arguments are only evaluated if the recorder is running
+#define GALERA_WORKLOAD_RECORD(message, ...) \
+    galera::WorkloadScope _workloadScope(message); \
+    if (_workloadScope.isActive()) \
+        _workloadScope.setArguments(QVariantList() << __VA_ARGS__)
+
+#define GALERA_WORKLOAD_RECORD_NO_ARGS(message) \
+    galera::WorkloadScope _workloadScope(message)
+
+// the view created by the call, used to replay the calls done on it
+#define GALERA_WORKLOAD_RESULT(result) \
+    if (_workloadScope.isActive()) \
+        _workloadScope.setResult(result)
+
+#endif
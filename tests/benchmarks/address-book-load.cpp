@@ -0,0 +1,578 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Load generator for the address book service.
+// Spawns N simulated clients, each one with its own bus connection, that open views,
+// fetch pages, lookup phones, search as you type and update contacts at the configured
+// rates. At the end prints the throughput and the latency percentiles of each method.
+
+#include "contact-generator.h"
+
+#include "common/dbus-service-defs.h"
+#include "common/filter.h"
+#include "common/vcard-parser.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <QtCore/QDebug>
+#include <QtCore/qmath.h>
+
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusObjectPath>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+#include <QtDBus/QDBusVariant>
+
+#include <QtContacts/QContactDetailFilter>
+#include <QtContacts/QContactUnionFilter>
+#include <QtContacts/QContactDisplayLabel>
+#include <QtContacts/QContactEmailAddress>
+#include <QtContacts/QContactGuid>
+#include <QtContacts/QContactName>
+#include <QtContacts/QContactPhoneNumber>
+
+#include <algorithm>
+
+using namespace QtContacts;
+
+// max number of calls waiting for reply on each client, new calls are skipped after that
+#define LOAD_CLIENT_MAX_PENDING_CALLS   16
+#define LOAD_PAGE_SIZE                  50
+
+class LoadStats
+{
+public:
+    void addCall(const QString &method, qint64 latencyUs, bool error)
+    {
+        MethodStats &stats = m_methods[method];
+        stats.latencies << latencyUs;
+        if (error) {
+            stats.errors++;
+        }
+    }
+
+    void addSkipped(const QString &method)
+    {
+        m_methods[method].skipped++;
+    }
+
+    void print(qint64 elapsedMs, QTextStream &out)
+    {
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+               .arg("method", -18).arg("calls", 8).arg("errors", 7).arg("skipped", 8)
+               .arg("calls/s", 9).arg("p50(ms)", 9).arg("p90(ms)", 9).arg("p99(ms)", 9).arg("max(ms)", 9);
+        QMap<QString, MethodStats>::iterator i = m_methods.begin();
+        for(; i != m_methods.end(); i++) {
+            QVector<qint64> &l = i.value().latencies;
+            std::sort(l.begin(), l.end());
+            out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+                   .arg(i.key(), -18)
+                   .arg(l.size(), 8)
+                   .arg(i.value().errors, 7)
+                   .arg(i.value().skipped, 8)
+                   .arg(elapsedMs > 0 ? (l.size() * 1000.0) / elapsedMs : 0.0, 9, 'f', 1)
+                   .arg(percentile(l, 50), 9, 'f', 2)
+                   .arg(percentile(l, 90), 9, 'f', 2)
+                   .arg(percentile(l, 99), 9, 'f', 2)
+                   .arg(l.isEmpty() ? 0.0 : l.last() / 1000.0, 9, 'f', 2);
+        }
+    }
+
+    void writeCsv(qint64 elapsedMs, QTextStream &out)
+    {
+        out << "method,calls,errors,skipped,callsPerSecond,p50Ms,p90Ms,p99Ms,maxMs\n";
+        QMap<QString, MethodStats>::iterator i = m_methods.begin();
+        for(; i != m_methods.end(); i++) {
+            QVector<qint64> &l = i.value().latencies;
+            std::sort(l.begin(), l.end());
+            out << i.key() << ","
+                << l.size() << ","
+                << i.value().errors << ","
+                << i.value().skipped << ","
+                << (elapsedMs > 0 ? (l.size() * 1000.0) / elapsedMs : 0.0) << ","
+                << percentile(l, 50) << ","
+                << percentile(l, 90) << ","
+                << percentile(l, 99) << ","
+                << (l.isEmpty() ? 0.0 : l.last() / 1000.0) << "\n";
+        }
+    }
+
+private:
+    struct MethodStats
+    {
+        MethodStats() : errors(0), skipped(0) {}
+        QVector<qint64> latencies;
+        int errors;
+        int skipped;
+    };
+    QMap<QString, MethodStats> m_methods;
+
+    // nearest rank percentile in ms, the list must be sorted
+    static double percentile(const QVector<qint64> &sorted, int p)
+    {
+        if (sorted.isEmpty()) {
+            return 0.0;
+        }
+        int rank = qCeil((p / 100.0) * sorted.size()) - 1;
+        return sorted.at(qBound(0, rank, sorted.size() - 1)) / 1000.0;
+    }
+};
+
+struct LoadConfig
+{
+    QString service;
+    int clients;
+    int contacts;
+    int duration;
+    double viewRate;
+    double lookupRate;
+    double searchRate;
+    double smartDialRate;
+    double updateRate;
+    QString csvFile;
+    bool quitServer;
+};
+
+class LoadClient : public QObject
+{
+    Q_OBJECT
+public:
+    LoadClient(int index, const LoadConfig &config, const QStringList &contactIds,
+               const QStringList &phones, const QStringList &names, LoadStats *stats)
+        : m_config(config),
+          m_contactIds(contactIds),
+          m_phones(phones),
+          m_names(names),
+          m_stats(stats),
+          m_generator(index + 1),
+          m_pendingCalls(0),
+          m_running(false)
+    {
+        // each client has its own connection, this way the service sees N different peers
+        m_connection = new QDBusConnection(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                                                                         QString("load-client-%1").arg(index)));
+    }
+
+    ~LoadClient()
+    {
+        QDBusConnection::disconnectFromBus(m_connection->name());
+        delete m_connection;
+    }
+
+    void start()
+    {
+        m_running = true;
+        startTimer(m_config.viewRate, SLOT(openView()));
+        startTimer(m_config.lookupRate, SLOT(lookupPhone()));
+        startTimer(m_config.searchRate, SLOT(search()));
+        startTimer(m_config.smartDialRate, SLOT(smartDial()));
+        startTimer(m_config.updateRate, SLOT(updateContact()));
+    }
+
+    void stop()
+    {
+        m_running = false;
+        Q_FOREACH(QTimer *timer, m_timers) {
+            timer->stop();
+        }
+    }
+
+    bool isIdle() const
+    {
+        return (m_pendingCalls == 0);
+    }
+
+private Q_SLOTS:
+    void openView()
+    {
+        QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                          CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                          CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                          "query");
+        msg << QString() << QString() << 0 << false << QStringList();
+        call("query", msg, "onViewOpened");
+    }
+
+    void onViewOpened(QDBusPendingCallWatcher *watcher)
+    {
+        QDBusPendingReply<QDBusObjectPath> reply = *watcher;
+        if (reply.isError() || !m_running) {
+            return;
+        }
+
+        // first 3 pages, like a contact list scrolling down
+        QString viewPath = reply.value().path();
+        for (int page = 0; page < 3; page++) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              viewPath,
+                                                              CPIM_ADDRESSBOOK_VIEW_IFACE_NAME,
+                                                              "contactsDetails");
+            msg << QStringList() << (page * LOAD_PAGE_SIZE) << LOAD_PAGE_SIZE;
+            call("contactsDetails", msg);
+        }
+
+        QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                          viewPath,
+                                                          CPIM_ADDRESSBOOK_VIEW_IFACE_NAME,
+                                                          "close");
+        call("close", msg);
+    }
+
+    void lookupPhone()
+    {
+        if (m_phones.isEmpty()) {
+            return;
+        }
+        QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                          CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                          CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                          "lookupPhone");
+        msg << m_phones.at(qrand() % m_phones.size()) << QStringList();
+        call("lookupPhone", msg);
+    }
+
+    void search()
+    {
+        if (m_names.isEmpty()) {
+            return;
+        }
+        // one query for each typed letter
+        QString name = m_names.at(qrand() % m_names.size());
+        for (int i = 1; i <= qMin(4, name.size()); i++) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                              "queryIds");
+            msg << searchClause(name.left(i)) << QString() << 0 << false << QStringList();
+            call("queryIds", msg);
+        }
+    }
+
+    void smartDial()
+    {
+        QString digits = QString::number(2 + qrand() % 8) + QString::number(qrand() % 10);
+        QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                          CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                          CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                          "smartDial");
+        msg << digits << 50;
+        call("smartDial", msg);
+    }
+
+    void updateContact()
+    {
+        if (m_contactIds.isEmpty()) {
+            return;
+        }
+        // replace a existing contact with new generated data
+        QContact contact = m_generator.contact(qrand() % m_config.contacts);
+        QContactGuid guid = contact.detail<QContactGuid>();
+        guid.setGuid(m_contactIds.at(qrand() % m_contactIds.size()));
+        contact.saveDetail(&guid);
+        QString vcard = galera::VCardParser::contactToVcard(contact);
+
+        QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                          CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                          CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                          "updateContacts");
+        msg << QStringList(vcard);
+        call("updateContacts", msg);
+    }
+
+    void onCallFinished(QDBusPendingCallWatcher *watcher)
+    {
+        QString method = watcher->property("METHOD").toString();
+        QString next = watcher->property("NEXT_SLOT").toString();
+        QElapsedTimer *timer = static_cast<QElapsedTimer*>(watcher->property("ELAPSED").value<void*>());
+        qint64 latency = timer->nsecsElapsed() / 1000;
+        delete timer;
+
+        m_stats->addCall(method, latency, watcher->isError());
+        if (watcher->isError()) {
+            qWarning() << method << "failed:" << watcher->error().message();
+        }
+        m_pendingCalls--;
+
+        if (!next.isEmpty()) {
+            QMetaObject::invokeMethod(this, next.toUtf8().constData(),
+                                      Q_ARG(QDBusPendingCallWatcher*, watcher));
+        }
+        watcher->deleteLater();
+    }
+
+private:
+    LoadConfig m_config;
+    QStringList m_contactIds;
+    QStringList m_phones;
+    QStringList m_names;
+    LoadStats *m_stats;
+    ContactGenerator m_generator;
+    QDBusConnection *m_connection;
+    QList<QTimer*> m_timers;
+    int m_pendingCalls;
+    bool m_running;
+
+    void startTimer(double rate, const char *slot)
+    {
+        if (rate <= 0) {
+            return;
+        }
+        QTimer *timer = new QTimer(this);
+        timer->setInterval(qMax(1, qRound(1000.0 / rate)));
+        connect(timer, SIGNAL(timeout()), slot);
+        m_timers << timer;
+        // spread the clients over the interval
+        QTimer::singleShot(qrand() % timer->interval(), timer, SLOT(start()));
+    }
+
+    void call(const QString &method, const QDBusMessage &msg, const QString &nextSlot = QString())
+    {
+        if (m_pendingCalls >= LOAD_CLIENT_MAX_PENDING_CALLS) {
+            m_stats->addSkipped(method);
+            return;
+        }
+
+        QElapsedTimer *timer = new QElapsedTimer;
+        timer->start();
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(m_connection->asyncCall(msg), this);
+        watcher->setProperty("METHOD", method);
+        watcher->setProperty("NEXT_SLOT", nextSlot);
+        watcher->setProperty("ELAPSED", QVariant::fromValue<void*>(timer));
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+        m_pendingCalls++;
+    }
+
+    static QString searchClause(const QString &text)
+    {
+        // same filter created by the address book app search field
+        QContactDetailFilter label;
+        label.setDetailType(QContactDisplayLabel::Type, QContactDisplayLabel::FieldLabel);
+        label.setMatchFlags(QContactFilter::MatchContains);
+        label.setValue(text);
+
+        QContactDetailFilter email;
+        email.setDetailType(QContactEmailAddress::Type, QContactEmailAddress::FieldEmailAddress);
+        email.setMatchFlags(QContactFilter::MatchContains);
+        email.setValue(text);
+
+        QContactUnionFilter search;
+        search << label << email;
+        return galera::Filter(search).toString();
+    }
+};
+
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    LoadGenerator(const LoadConfig &config)
+        : m_config(config)
+    {
+    }
+
+    ~LoadGenerator()
+    {
+        qDeleteAll(m_clients);
+    }
+
+public Q_SLOTS:
+    void start()
+    {
+        QTextStream out(stdout);
+        if (!waitForService()) {
+            qWarning() << "Address book service not available:" << m_config.service;
+            QCoreApplication::exit(1);
+            return;
+        }
+
+        out << "Creating " << m_config.contacts << " contacts..." << endl;
+        populate();
+
+        out << "Running " << m_config.clients << " clients for " << m_config.duration << "s..." << endl;
+        for (int i = 0; i < m_config.clients; i++) {
+            LoadClient *client = new LoadClient(i, m_config, m_contactIds, m_phones, m_names, &m_stats);
+            m_clients << client;
+            client->start();
+        }
+        m_elapsed.start();
+        QTimer::singleShot(m_config.duration * 1000, this, SLOT(stop()));
+    }
+
+    void stop()
+    {
+        qint64 elapsed = m_elapsed.elapsed();
+        Q_FOREACH(LoadClient *client, m_clients) {
+            client->stop();
+        }
+
+        // give the pending calls some time to finish
+        QElapsedTimer wait;
+        wait.start();
+        while (!isIdle() && (wait.elapsed() < 10000)) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+        }
+
+        QTextStream out(stdout);
+        m_stats.print(elapsed, out);
+
+        if (!m_config.csvFile.isEmpty()) {
+            QFile csv(m_config.csvFile);
+            if (csv.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                QTextStream csvOut(&csv);
+                m_stats.writeCsv(elapsed, csvOut);
+            } else {
+                qWarning() << "Fail to write" << m_config.csvFile;
+            }
+        }
+
+        if (m_config.quitServer) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                              "shutDown");
+            QDBusConnection::sessionBus().call(msg);
+        }
+        QCoreApplication::exit(0);
+    }
+
+private:
+    LoadConfig m_config;
+    LoadStats m_stats;
+    QList<LoadClient*> m_clients;
+    QStringList m_contactIds;
+    QStringList m_phones;
+    QStringList m_names;
+    QElapsedTimer m_elapsed;
+
+    bool waitForService()
+    {
+        QElapsedTimer wait;
+        wait.start();
+        while (wait.elapsed() < 30000) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              "org.freedesktop.DBus.Properties",
+                                                              "Get");
+            msg << QString(CPIM_ADDRESSBOOK_IFACE_NAME) << QString("isReady");
+            QDBusMessage reply = QDBusConnection::sessionBus().call(msg);
+            if ((reply.type() == QDBusMessage::ReplyMessage) &&
+                reply.arguments().value(0).value<QDBusVariant>().variant().toBool()) {
+                return true;
+            }
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+        }
+        return false;
+    }
+
+    void populate()
+    {
+        ContactGenerator generator;
+        for (int i = 0; i < m_config.contacts; i++) {
+            QContact contact = generator.contact(i);
+            // let the service create the ids
+            contact.setId(QContactId());
+            QContactGuid guid = contact.detail<QContactGuid>();
+            contact.removeDetail(&guid);
+
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                              "createContact");
+            msg << galera::VCardParser::contactToVcard(contact) << QString();
+            QDBusMessage reply = QDBusConnection::sessionBus().call(msg);
+            if (reply.type() != QDBusMessage::ReplyMessage) {
+                qWarning() << "Fail to create contact:" << reply.errorMessage();
+                continue;
+            }
+            m_contactIds << reply.arguments().value(0).toString();
+
+            Q_FOREACH(const QContactPhoneNumber &phone, contact.details<QContactPhoneNumber>()) {
+                m_phones << phone.number();
+            }
+            QString firstName = contact.detail<QContactName>().firstName();
+            if (!firstName.isEmpty()) {
+                m_names << firstName;
+            }
+        }
+    }
+
+    bool isIdle() const
+    {
+        Q_FOREACH(LoadClient *client, m_clients) {
+            if (!client->isIdle()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("address-book-load");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generate load against the address book service and report "
+                                     "throughput and latency of each method.");
+    parser.addHelpOption();
+    QCommandLineOption clientsOption("clients", "Number of simulated clients.", "n", "10");
+    QCommandLineOption contactsOption("contacts", "Number of contacts created before the run.", "n", "1000");
+    QCommandLineOption durationOption("duration", "Duration of the run in seconds.", "seconds", "30");
+    QCommandLineOption viewRateOption("view-rate", "Views opened per client per second (each one fetches 3 pages).", "rate", "0.5");
+    QCommandLineOption lookupRateOption("lookup-rate", "Phone lookups per client per second.", "rate", "2");
+    QCommandLineOption searchRateOption("search-rate", "Searches per client per second (one query per typed letter).", "rate", "0.5");
+    QCommandLineOption smartDialRateOption("smart-dial-rate", "Smart dial queries per client per second.", "rate", "1");
+    QCommandLineOption updateRateOption("update-rate", "Contact updates per client per second.", "rate", "0.1");
+    QCommandLineOption csvOption("csv", "Save the results on a csv file.", "file");
+    QCommandLineOption quitOption("quit-server", "Shutdown the service at the end of the run.");
+    parser.addOptions(QList<QCommandLineOption>()
+                      << clientsOption << contactsOption << durationOption
+                      << viewRateOption << lookupRateOption << searchRateOption
+                      << smartDialRateOption << updateRateOption << csvOption << quitOption);
+    parser.process(app);
+
+    LoadConfig config;
+    if (qEnvironmentVariableIsSet(ALTERNATIVE_CPIM_SERVICE_NAME)) {
+        config.service = qgetenv(ALTERNATIVE_CPIM_SERVICE_NAME);
+    } else {
+        config.service = CPIM_SERVICE_NAME;
+    }
+    config.clients = qMax(1, parser.value(clientsOption).toInt());
+    config.contacts = qMax(1, parser.value(contactsOption).toInt());
+    config.duration = qMax(1, parser.value(durationOption).toInt());
+    config.viewRate = parser.value(viewRateOption).toDouble();
+    config.lookupRate = parser.value(lookupRateOption).toDouble();
+    config.searchRate = parser.value(searchRateOption).toDouble();
+    config.smartDialRate = parser.value(smartDialRateOption).toDouble();
+    config.updateRate = parser.value(updateRateOption).toDouble();
+    config.csvFile = parser.value(csvOption);
+    config.quitServer = parser.isSet(quitOption);
+
+    LoadGenerator generator(config);
+    QTimer::singleShot(0, &generator, SLOT(start()));
+    return app.exec();
+}
+
+#include "address-book-load.moc"
@@ -0,0 +1,482 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Replays a workload recorded by the service (ADDRESS_BOOK_RECORD_WORKLOAD=<file>).
+// The calls are sent at the recorded times, scaled by --speed, each recorded client uses
+// its own bus connection and the calls done on views are sent to the views created by
+// the replay. At the end prints the latency of each method next to the time spent on the
+// service during the recording, and the difference to a previous run if --baseline is used.
+
+#include "lib/workload-recorder.h"
+
+#include "common/dbus-service-defs.h"
+#include "common/vcard-parser.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <QtCore/QDebug>
+#include <QtCore/qmath.h>
+
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusObjectPath>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+#include <QtDBus/QDBusVariant>
+
+#include <algorithm>
+
+using namespace galera;
+
+class ReplayStats
+{
+public:
+    void addRecorded(const QString &method, qint64 durationUs)
+    {
+        m_methods[method].recorded << durationUs;
+    }
+
+    void addCall(const QString &method, qint64 latencyUs, bool error)
+    {
+        MethodStats &stats = m_methods[method];
+        stats.latencies << latencyUs;
+        if (error) {
+            stats.errors++;
+        }
+    }
+
+    void addSkipped(const QString &method)
+    {
+        m_methods[method].skipped++;
+    }
+
+    bool loadBaseline(const QString &fileName)
+    {
+        QFile csv(fileName);
+        if (!csv.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QTextStream in(&csv);
+        // skip the header
+        in.readLine();
+        while (!in.atEnd()) {
+            QStringList values = in.readLine().split(",");
+            if (values.size() < 9) {
+                continue;
+            }
+            m_baseline.insert(values.at(0), qMakePair(values.at(5).toDouble(), values.at(7).toDouble()));
+        }
+        return true;
+    }
+
+    void print(QTextStream &out)
+    {
+        bool hasBaseline = !m_baseline.isEmpty();
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+               .arg("method", -36).arg("calls", 7).arg("errors", 7).arg("skipped", 8)
+               .arg("svc(ms)", 9).arg("p50(ms)", 9).arg("p90(ms)", 9).arg("p99(ms)", 9).arg("max(ms)", 9);
+        if (hasBaseline) {
+            out << QString(" %1 %2").arg("p50 diff%", 9).arg("p99 diff%", 9);
+        }
+        out << "\n";
+
+        QMap<QString, MethodStats>::iterator i = m_methods.begin();
+        for(; i != m_methods.end(); i++) {
+            QVector<qint64> &l = i.value().latencies;
+            QVector<qint64> &r = i.value().recorded;
+            std::sort(l.begin(), l.end());
+            std::sort(r.begin(), r.end());
+            double p50 = percentile(l, 50);
+            double p99 = percentile(l, 99);
+            out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+                   .arg(i.key(), -36)
+                   .arg(l.size(), 7)
+                   .arg(i.value().errors, 7)
+                   .arg(i.value().skipped, 8)
+                   .arg(r.isEmpty() ? QString("-") : QString::number(percentile(r, 50), 'f', 2), 9)
+                   .arg(p50, 9, 'f', 2)
+                   .arg(percentile(l, 90), 9, 'f', 2)
+                   .arg(p99, 9, 'f', 2)
+                   .arg(l.isEmpty() ? 0.0 : l.last() / 1000.0, 9, 'f', 2);
+            if (hasBaseline) {
+                QPair<double, double> base = m_baseline.value(i.key(), qMakePair(0.0, 0.0));
+                out << QString(" %1 %2").arg(difference(base.first, p50), 9).arg(difference(base.second, p99), 9);
+            }
+            out << "\n";
+        }
+    }
+
+    void writeCsv(QTextStream &out)
+    {
+        out << "method,calls,errors,skipped,serviceP50Ms,p50Ms,p90Ms,p99Ms,maxMs\n";
+        QMap<QString, MethodStats>::iterator i = m_methods.begin();
+        for(; i != m_methods.end(); i++) {
+            QVector<qint64> &l = i.value().latencies;
+            QVector<qint64> &r = i.value().recorded;
+            std::sort(l.begin(), l.end());
+            std::sort(r.begin(), r.end());
+            out << i.key() << ","
+                << l.size() << ","
+                << i.value().errors << ","
+                << i.value().skipped << ","
+                << percentile(r, 50) << ","
+                << percentile(l, 50) << ","
+                << percentile(l, 90) << ","
+                << percentile(l, 99) << ","
+                << (l.isEmpty() ? 0.0 : l.last() / 1000.0) << "\n";
+        }
+    }
+
+private:
+    struct MethodStats
+    {
+        MethodStats() : errors(0), skipped(0) {}
+        QVector<qint64> latencies;
+        // time spent on the adaptor during the recording, only for the calls replied
+        // directly by the adaptor
+        QVector<qint64> recorded;
+        int errors;
+        int skipped;
+    };
+    QMap<QString, MethodStats> m_methods;
+    // p50 and p99 of a previous run
+    QMap<QString, QPair<double, double> > m_baseline;
+
+    // nearest rank percentile in ms, the list must be sorted
+    static double percentile(const QVector<qint64> &sorted, int p)
+    {
+        if (sorted.isEmpty()) {
+            return 0.0;
+        }
+        int rank = qCeil((p / 100.0) * sorted.size()) - 1;
+        return sorted.at(qBound(0, rank, sorted.size() - 1)) / 1000.0;
+    }
+
+    static QString difference(double base, double value)
+    {
+        if (base <= 0.0) {
+            return QString("-");
+        }
+        return QString::number(((value - base) * 100.0) / base, 'f', 1);
+    }
+};
+
+struct ReplayConfig
+{
+    QString service;
+    QString workload;
+    double speed;
+    QString populateFile;
+    QString csvFile;
+    QString baselineFile;
+    bool quitServer;
+};
+
+class WorkloadReplay : public QObject
+{
+    Q_OBJECT
+public:
+    WorkloadReplay(const ReplayConfig &config)
+        : m_config(config),
+          m_next(0),
+          m_pendingCalls(0)
+    {
+        m_timer.setSingleShot(true);
+        connect(&m_timer, SIGNAL(timeout()), SLOT(sendDueCalls()));
+    }
+
+    ~WorkloadReplay()
+    {
+        Q_FOREACH(QDBusConnection *connection, m_connections) {
+            QDBusConnection::disconnectFromBus(connection->name());
+            delete connection;
+        }
+    }
+
+public Q_SLOTS:
+    void start()
+    {
+        QTextStream out(stdout);
+        QString errorMessage;
+        m_calls = WorkloadRecorder::load(m_config.workload, &errorMessage);
+        if (m_calls.isEmpty()) {
+            qWarning() << "Fail to load workload" << m_config.workload << errorMessage;
+            QCoreApplication::exit(1);
+            return;
+        }
+
+        if (!m_config.baselineFile.isEmpty() && !m_stats.loadBaseline(m_config.baselineFile)) {
+            qWarning() << "Fail to load baseline" << m_config.baselineFile;
+        }
+
+        if (!waitForService()) {
+            qWarning() << "Address book service not available:" << m_config.service;
+            QCoreApplication::exit(1);
+            return;
+        }
+
+        if (!m_config.populateFile.isEmpty()) {
+            populate();
+        }
+
+        out << "Replaying " << m_calls.size() << " calls ("
+            << m_calls.last().offset / 1000000.0 << "s recorded)..." << endl;
+        m_elapsed.start();
+        sendDueCalls();
+    }
+
+    void sendDueCalls()
+    {
+        qint64 now = m_elapsed.nsecsElapsed() / 1000;
+        while (m_next < m_calls.size()) {
+            qint64 due = (m_config.speed > 0) ? qint64(m_calls.at(m_next).offset / m_config.speed) : 0;
+            if (due > now) {
+                m_timer.start(int((due - now) / 1000));
+                return;
+            }
+            send(m_next++);
+        }
+        finish();
+    }
+
+private Q_SLOTS:
+    void onCallFinished(QDBusPendingCallWatcher *watcher)
+    {
+        qint64 latency = (m_elapsed.nsecsElapsed() / 1000) - watcher->property("START").toLongLong();
+        int index = watcher->property("INDEX").toInt();
+        const WorkloadCall &call = m_calls.at(index);
+        bool error = watcher->isError();
+        m_stats.addCall(methodName(call), latency, error);
+
+        // calls done on the view created by this call can be sent now
+        if (!call.result.isEmpty()) {
+            QList<int> pending = m_pendingViews.take(call.result);
+            QDBusMessage reply = watcher->reply();
+            if (!error && !reply.arguments().isEmpty()) {
+                m_viewPaths.insert(call.result, reply.arguments().at(0).value<QDBusObjectPath>().path());
+                Q_FOREACH(int i, pending) {
+                    send(i);
+                }
+            } else {
+                Q_FOREACH(int i, pending) {
+                    m_stats.addSkipped(methodName(m_calls.at(i)));
+                }
+            }
+        }
+
+        m_pendingCalls--;
+        watcher->deleteLater();
+    }
+
+private:
+    ReplayConfig m_config;
+    ReplayStats m_stats;
+    QList<WorkloadCall> m_calls;
+    int m_next;
+    int m_pendingCalls;
+    QTimer m_timer;
+    QElapsedTimer m_elapsed;
+    QMap<QString, QDBusConnection*> m_connections;
+    // recorded view path -> view path created by the replay
+    QMap<QString, QString> m_viewPaths;
+    // calls waiting for the reply of the call that creates the view
+    QMap<QString, QList<int> > m_pendingViews;
+
+    static QString methodName(const WorkloadCall &call)
+    {
+        return QString("%1.%2").arg(call.interface.section('.', -1)).arg(call.member);
+    }
+
+    QDBusConnection *connectionFor(const QString &sender)
+    {
+        // each recorded client has its own connection, this way the listeners and the
+        // views are kept per client as in the recording
+        QDBusConnection *connection = m_connections.value(sender, 0);
+        if (!connection) {
+            connection = new QDBusConnection(QDBusConnection::connectToBus(QDBusConnection::SessionBus,
+                                                                           QString("replay-client-%1").arg(m_connections.size())));
+            m_connections.insert(sender, connection);
+        }
+        return connection;
+    }
+
+    void send(int index)
+    {
+        const WorkloadCall &call = m_calls.at(index);
+        QString method = methodName(call);
+
+        // the sources are not recorded
+        if (call.member == "updateSources") {
+            m_stats.addSkipped(method);
+            return;
+        }
+
+        QString path = call.path;
+        if (call.interface == CPIM_ADDRESSBOOK_VIEW_IFACE_NAME) {
+            if (m_pendingViews.contains(call.path)) {
+                m_pendingViews[call.path] << index;
+                return;
+            } else if (!m_viewPaths.contains(call.path)) {
+                // the view was created before the recording started
+                m_stats.addSkipped(method);
+                return;
+            }
+            path = m_viewPaths.value(call.path);
+        }
+
+        if (!call.delayed) {
+            m_stats.addRecorded(method, call.duration);
+        }
+        if (!call.result.isEmpty()) {
+            m_pendingViews.insert(call.result, QList<int>());
+        }
+
+        QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service, path, call.interface, call.member);
+        msg.setArguments(call.arguments);
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(connectionFor(call.sender)->asyncCall(msg), this);
+        watcher->setProperty("INDEX", index);
+        watcher->setProperty("START", m_elapsed.nsecsElapsed() / 1000);
+        connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+                SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+        m_pendingCalls++;
+    }
+
+    void finish()
+    {
+        // give the pending calls some time to finish
+        QElapsedTimer wait;
+        wait.start();
+        while ((m_pendingCalls > 0) && (wait.elapsed() < 30000)) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+        }
+
+        QTextStream out(stdout);
+        out << "Replayed in " << m_elapsed.elapsed() / 1000.0 << "s" << endl;
+        m_stats.print(out);
+
+        if (!m_config.csvFile.isEmpty()) {
+            QFile csv(m_config.csvFile);
+            if (csv.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                QTextStream csvOut(&csv);
+                m_stats.writeCsv(csvOut);
+            } else {
+                qWarning() << "Fail to write" << m_config.csvFile;
+            }
+        }
+
+        if (m_config.quitServer) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                              "shutDown");
+            QDBusConnection::sessionBus().call(msg);
+        }
+        QCoreApplication::exit(0);
+    }
+
+    bool waitForService()
+    {
+        QElapsedTimer wait;
+        wait.start();
+        while (wait.elapsed() < 30000) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              "org.freedesktop.DBus.Properties",
+                                                              "Get");
+            msg << QString(CPIM_ADDRESSBOOK_IFACE_NAME) << QString("isReady");
+            QDBusMessage reply = QDBusConnection::sessionBus().call(msg);
+            if ((reply.type() == QDBusMessage::ReplyMessage) &&
+                reply.arguments().value(0).value<QDBusVariant>().variant().toBool()) {
+                return true;
+            }
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+        }
+        return false;
+    }
+
+    void populate()
+    {
+        QFile file(m_config.populateFile);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Fail to open" << m_config.populateFile;
+            return;
+        }
+
+        QStringList vcards = VCardParser::splitVcards(file.readAll());
+        QTextStream(stdout) << "Creating " << vcards.size() << " contacts..." << endl;
+        Q_FOREACH(const QString &vcard, vcards) {
+            QDBusMessage msg = QDBusMessage::createMethodCall(m_config.service,
+                                                              CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                              CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                              "createContact");
+            msg << vcard << QString();
+            QDBusMessage reply = QDBusConnection::sessionBus().call(msg);
+            if (reply.type() != QDBusMessage::ReplyMessage) {
+                qWarning() << "Fail to create contact:" << reply.errorMessage();
+            }
+        }
+    }
+};
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("address-book-replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replay a workload recorded by the address book service "
+                                     "and report the latency of each method.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("workload", "File recorded with ADDRESS_BOOK_RECORD_WORKLOAD.");
+    QCommandLineOption speedOption("speed", "Replay speed, 2 sends the calls twice as fast, 0 sends them without waiting.", "factor", "1");
+    QCommandLineOption populateOption("populate", "Create the contacts of the vcard file before the replay.", "file");
+    QCommandLineOption csvOption("csv", "Save the results on a csv file.", "file");
+    QCommandLineOption baselineOption("baseline", "Compare the results with the csv file of a previous run.", "file");
+    QCommandLineOption quitOption("quit-server", "Shutdown the service at the end of the replay.");
+    parser.addOptions(QList<QCommandLineOption>()
+                      << speedOption << populateOption << csvOption << baselineOption << quitOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    ReplayConfig config;
+    if (qEnvironmentVariableIsSet(ALTERNATIVE_CPIM_SERVICE_NAME)) {
+        config.service = qgetenv(ALTERNATIVE_CPIM_SERVICE_NAME);
+    } else {
+        config.service = CPIM_SERVICE_NAME;
+    }
+    config.workload = parser.positionalArguments().first();
+    config.speed = qMax(0.0, parser.value(speedOption).toDouble());
+    config.populateFile = parser.value(populateOption);
+    config.csvFile = parser.value(csvOption);
+    config.baselineFile = parser.value(baselineOption);
+    config.quitServer = parser.isSet(quitOption);
+
+    WorkloadReplay replay(config);
+    QTimer::singleShot(0, &replay, SLOT(start()));
+    return app.exec();
+}
+
+#include "address-book-replay.moc"
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contact-generator.h"
+
+#include <QtCore/QStringList>
+#include <QtCore/QUrl>
+
+#include <QtContacts/QContactGuid>
+#include <QtContacts/QContactName>
+#include <QtContacts/QContactDisplayLabel>
+#include <QtContacts/QContactTag>
+#include <QtContacts/QContactNickname>
+#include <QtContacts/QContactPhoneNumber>
+#include <QtContacts/QContactEmailAddress>
+#include <QtContacts/QContactOrganization>
+#include <QtContacts/QContactAddress>
+#include <QtContacts/QContactFavorite>
+#include <QtContacts/QContactAvatar>
+
+using namespace QtContacts;
+
+namespace
+{
+    const char *firstNames[] = {
+        "Ana", "André", "Antonio", "Beatriz", "Bruno", "Carla", "Carlos", "Daniel", "Eduardo", "Elena",
+        "Fernanda", "Francisco", "Gabriel", "Helena", "Igor", "Isabel", "João", "Jonas", "José", "Julia",
+        "Lucas", "Luiza", "Marcos", "Maria", "Mariana", "Michael", "Nicolas", "Olga", "Paulo", "Pedro",
+        "Rafael", "Renato", "Ricardo", "Sara", "Sofia", "Thomas", "Tiago", "Vitor", "William", "Zoe"
+    };
+
+    const char *lastNames[] = {
+        "Almeida", "Araujo", "Barbosa", "Carvalho", "Costa", "Dias", "Fernandes", "Ferreira", "Gomes", "Lima",
+        "Lopes", "Martins", "Melo", "Miller", "Nascimento", "Oliveira", "Pereira", "Ribeiro", "Rodrigues", "Santos",
+        "Schmidt", "Silva", "Smith", "Sousa", "Teixeira", "Vieira", "Wagner", "Yamamoto", "Zhang", "Ünal"
+    };
+
+    const char *companies[] = {
+        "Canonical", "Acme", "Globex", "Initech", "Umbrella", "Hooli", "Stark Industries", "Wayne Enterprises"
+    };
+
+    const char *cities[] = {
+        "Recife", "São Paulo", "London", "Berlin", "Montreal", "Taipei", "Lisboa", "Boston"
+    };
+
+    template<typename T, int N>
+    int arraySize(T (&)[N])
+    {
+        return N;
+    }
+}
+
+ContactGenerator::ContactGenerator(quint32 seed)
+    : m_state(seed)
+{
+}
+
+quint32 ContactGenerator::next()
+{
+    // LCG with the glibc constants, qrand would depend on the platform
+    m_state = (m_state * 1103515245u) + 12345u;
+    return (m_state >> 16) & 0x7fff;
+}
+
+int ContactGenerator::percent()
+{
+    return next() % 100;
+}
+
+QString ContactGenerator::phoneNumber()
+{
+    // mix of the most common formats found on phone address books
+    int format = next() % 5;
+    int prefix = 2000 + (next() % 8000);
+    int suffix = next() % 10000;
+    switch (format) {
+    case 0:
+        return QString("+55 81 9%1-%2").arg(prefix).arg(suffix, 4, 10, QChar('0'));
+    case 1:
+        return QString("(81) 3%1-%2").arg(prefix % 1000, 3, 10, QChar('0')).arg(suffix, 4, 10, QChar('0'));
+    case 2:
+        return QString("+1-415-%1-%2").arg(prefix % 1000, 3, 10, QChar('0')).arg(suffix, 4, 10, QChar('0'));
+    case 3:
+        return QString("%1%2").arg(prefix).arg(suffix, 4, 10, QChar('0'));
+    default:
+        return QString("+44 20 %1 %2").arg(prefix).arg(suffix, 4, 10, QChar('0'));
+    }
+}
+
+QContact ContactGenerator::contact(int index)
+{
+    QContact contact;
+    QString guid = QString("benchmark-%1").arg(index);
+    contact.setId(QContactId("qtcontacts:galera:", guid.toUtf8()));
+
+    QContactGuid cGuid;
+    cGuid.setGuid(guid);
+    contact.saveDetail(&cGuid);
+
+    QString label;
+    // ~5% of the contacts only have a phone number
+    if (percent() >= 5) {
+        QContactName name;
+        name.setFirstName(QString::fromUtf8(firstNames[next() % arraySize(firstNames)]));
+        name.setLastName(QString::fromUtf8(lastNames[next() % arraySize(lastNames)]));
+        contact.saveDetail(&name);
+        label = QString("%1 %2").arg(name.firstName()).arg(name.lastName());
+    }
+
+    // phone numbers: 60% one, 30% two, 10% three
+    int phones = percent();
+    phones = (phones < 60) ? 1 : (phones < 90) ? 2 : 3;
+    for (int i = 0; i < phones; i++) {
+        QContactPhoneNumber phone;
+        phone.setNumber(phoneNumber());
+        phone.setSubTypes(QList<int>() << ((i == 0) ? QContactPhoneNumber::SubTypeMobile : QContactPhoneNumber::SubTypeLandline));
+        contact.saveDetail(&phone);
+        if (label.isEmpty()) {
+            label = phone.number();
+        }
+    }
+
+    // emails: 40% none, 50% one, 10% two
+    int emails = percent();
+    emails = (emails < 40) ? 0 : (emails < 90) ? 1 : 2;
+    for (int i = 0; i < emails; i++) {
+        QContactEmailAddress email;
+        email.setEmailAddress(QString("%1.%2@example.com").arg(label.section(' ', 0, 0).toLower()).arg(index + i));
+        contact.saveDetail(&email);
+    }
+
+    if (percent() < 15) {
+        QContactNickname nickname;
+        nickname.setNickname(label.left(3));
+        contact.saveDetail(&nickname);
+    }
+
+    if (percent() < 20) {
+        QContactOrganization org;
+        org.setName(QString::fromUtf8(companies[next() % arraySize(companies)]));
+        contact.saveDetail(&org);
+    }
+
+    if (percent() < 15) {
+        QContactAddress address;
+        address.setStreet(QString("Street %1").arg(next() % 1000));
+        address.setLocality(QString::fromUtf8(cities[next() % arraySize(cities)]));
+        contact.saveDetail(&address);
+    }
+
+    if (percent() < 20) {
+        QContactAvatar avatar;
+        avatar.setImageUrl(QUrl(QString("file:///tmp/avatars/%1.png").arg(index)));
+        contact.saveDetail(&avatar);
+    }
+
+    QContactFavorite favorite;
+    favorite.setFavorite(percent() < 10);
+    contact.saveDetail(&favorite);
+
+    // same details created by QIndividual::updateContact
+    QContactDisplayLabel displayLabel;
+    displayLabel.setLabel(label);
+    contact.saveDetail(&displayLabel);
+
+    QContactTag tag;
+    if (!label.isEmpty() && label.at(0).isLetter()) {
+        tag.setTag(label.toUpper());
+    } else {
+        tag.setTag("");
+    }
+    contact.saveDetail(&tag);
+
+    return contact;
+}
+
+QList<QContact> ContactGenerator::contacts(int count)
+{
+    QList<QContact> result;
+    result.reserve(count);
+    for (int i = 0; i < count; i++) {
+        result << contact(i);
+    }
+    return result;
+}
+
+QList<int> ContactGenerator::sizes(int defaultMax)
+{
+    int max = defaultMax;
+    QByteArray envMax = qgetenv("BENCHMARK_MAX_CONTACTS");
+    if (!envMax.isEmpty()) {
+        max = envMax.toInt();
+    }
+
+    QList<int> result;
+    for (int size = 1000; size <= max; size *= 10) {
+        result << size;
+    }
+    if (result.isEmpty()) {
+        result << qMax(max, 1);
+    }
+    return result;
+}
+
+QString ContactGenerator::sizeName(int size)
+{
+    if (size < 1000) {
+        return QString::number(size);
+    }
+    return QString("%1k").arg(size / 1000);
+}
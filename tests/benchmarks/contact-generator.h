@@ -0,0 +1,50 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GALERA_CONTACT_GENERATOR_H__
+#define __GALERA_CONTACT_GENERATOR_H__
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include <QtContacts/QContact>
+
+// Create synthetic address books for the benchmarks.
+// The result is deterministic for the same seed, this way the runs can be compared.
+class ContactGenerator
+{
+public:
+    ContactGenerator(quint32 seed = 1);
+
+    QtContacts::QContact contact(int index);
+    QList<QtContacts::QContact> contacts(int count);
+
+    // address book sizes used by the benchmarks: 1k, 10k and 100k contacts limited by
+    // the BENCHMARK_MAX_CONTACTS env var
+    static QList<int> sizes(int defaultMax = 100000);
+    static QString sizeName(int size);
+
+private:
+    quint32 m_state;
+
+    quint32 next();
+    int percent();
+    QString phoneNumber();
+};
+
+#endif
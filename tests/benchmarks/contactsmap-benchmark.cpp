@@ -0,0 +1,294 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "contact-generator.h"
+#include "dummy-backend.h"
+#include "scoped-loop.h"
+
+#include "lib/contacts-map.h"
+#include "lib/qindividual.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <QtContacts>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <algorithm>
+
+using namespace QtContacts;
+
+// number of lookups done in each iteration of the benchmarks
+#define CONTACTS_MAP_BENCHMARK_LOOKUPS  100
+
+class ContactMapBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    DummyBackendProxy *m_dummy;
+    QList<FolksIndividual*> m_individuals;
+    QStringList m_phones;
+
+    // contacts are created through the dummy backend, this is slow so the default max size is smaller
+    static QList<int> sizes()
+    {
+        return ContactGenerator::sizes(10000);
+    }
+
+    void createContacts(int size)
+    {
+        ContactGenerator generator;
+        for (int i = 0; i < size; i++) {
+            QContact contact = generator.contact(i);
+            // let the backend create the ids
+            contact.setId(QContactId());
+            QContactGuid guid = contact.detail<QContactGuid>();
+            contact.removeDetail(&guid);
+            m_dummy->createContact(contact);
+
+            QList<QContactPhoneNumber> phones = contact.details<QContactPhoneNumber>();
+            if ((m_phones.size() < CONTACTS_MAP_BENCHMARK_LOOKUPS) && !phones.isEmpty()) {
+                m_phones << phones.first().number();
+            }
+        }
+
+        Q_FOREACH(galera::QIndividual *i, m_dummy->individuals()) {
+            m_individuals << i->individual();
+        }
+    }
+
+    void fillMap(galera::ContactsMap &map, int size)
+    {
+        for (int i = 0; i < size; i++) {
+            map.insert(new galera::ContactEntry(new galera::QIndividual(m_individuals[i], m_dummy->aggregator())));
+        }
+    }
+
+    void addSizeColumn()
+    {
+        QTest::addColumn<int>("size");
+        Q_FOREACH(int size, sizes()) {
+            QTest::newRow(qPrintable(ContactGenerator::sizeName(size))) << size;
+        }
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        m_dummy = new DummyBackendProxy();
+        m_dummy->start();
+        QTRY_VERIFY(m_dummy->isReady());
+
+        createContacts(sizes().last());
+        QCOMPARE(m_individuals.size(), sizes().last());
+    }
+
+    void cleanupTestCase()
+    {
+        m_dummy->shutdown();
+        delete m_dummy;
+    }
+
+    void benchmarkInsert_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkInsert()
+    {
+        QFETCH(int, size);
+
+        QBENCHMARK {
+            galera::ContactsMap map;
+            fillMap(map, size);
+            QCOMPARE(map.size(), size);
+            map.clear();
+        }
+    }
+
+    void benchmarkTakeAndInsert_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkTakeAndInsert()
+    {
+        QFETCH(int, size);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+        QBENCHMARK {
+            for (int i = 0; i < CONTACTS_MAP_BENCHMARK_LOOKUPS; i++) {
+                galera::ContactEntry *entry = map.take(m_individuals[(i * size) / CONTACTS_MAP_BENCHMARK_LOOKUPS]);
+                map.insert(entry);
+            }
+        }
+        QCOMPARE(map.size(), size);
+        map.clear();
+    }
+
+    void benchmarkUpdatePosition_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkUpdatePosition()
+    {
+        QFETCH(int, size);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+        QBENCHMARK {
+            for (int i = 0; i < CONTACTS_MAP_BENCHMARK_LOOKUPS; i++) {
+                galera::ContactEntry *entry = map.value(m_individuals[(i * size) / CONTACTS_MAP_BENCHMARK_LOOKUPS]);
+                map.updatePosition(entry);
+            }
+        }
+        map.clear();
+    }
+
+    void benchmarkLookupPhone_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkLookupPhone()
+    {
+        QFETCH(int, size);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+        QBENCHMARK {
+            Q_FOREACH(const QString &phone, m_phones) {
+                map.lookupPhone(phone);
+            }
+        }
+        map.clear();
+    }
+
+    void benchmarkLookupPhoneUncached_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkLookupPhoneUncached()
+    {
+        QFETCH(int, size);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+
+        // latency of the lookups not answered by the cache, the target is a p99 below 1ms
+        QList<qint64> latencies;
+        QElapsedTimer timer;
+        QBENCHMARK {
+            Q_FOREACH(const QString &phone, m_phones) {
+                map.releaseCaches();
+                timer.start();
+                map.lookupPhone(phone);
+                latencies << timer.nsecsElapsed();
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        qint64 p99 = latencies.value((latencies.size() * 99) / 100);
+        qDebug() << "lookupPhone p99:" << (p99 / 1000) << "us";
+        map.clear();
+    }
+
+    void benchmarkLookupPhoneDuringSync_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkLookupPhoneDuringSync()
+    {
+        QFETCH(int, size);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+
+        // a sync updates the indexes of other contacts between the lookups, the cached
+        // lookups of the numbers not touched by it must survive
+        int updated = 0;
+        QBENCHMARK {
+            Q_FOREACH(const QString &phone, m_phones) {
+                galera::ContactEntry *entry = map.value(m_individuals[updated++ % size]);
+                map.updateIndexes(entry);
+                map.lookupPhone(phone);
+            }
+        }
+        map.clear();
+    }
+
+    void benchmarkValueByPhone_data()
+    {
+        addSizeColumn();
+    }
+
+    void benchmarkValueByPhone()
+    {
+        QFETCH(int, size);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+        QBENCHMARK {
+            Q_FOREACH(const QString &phone, m_phones) {
+                map.valueByPhone(phone);
+            }
+        }
+        map.clear();
+    }
+
+    void benchmarkSmartDial_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<QString>("digits");
+
+        QStringList digits;
+        // "ma", "mari", "silva" and a phone prefix
+        digits << "62" << "6274" << "74582" << "8192";
+        Q_FOREACH(int size, sizes()) {
+            Q_FOREACH(const QString &d, digits) {
+                QTest::newRow(qPrintable(ContactGenerator::sizeName(size) + ":" + d)) << size << d;
+            }
+        }
+    }
+
+    void benchmarkSmartDial()
+    {
+        QFETCH(int, size);
+        QFETCH(QString, digits);
+
+        galera::ContactsMap map;
+        fillMap(map, size);
+        QBENCHMARK {
+            map.smartDial(digits, 50);
+        }
+        map.clear();
+    }
+};
+
+QTEST_MAIN(ContactMapBenchmark)
+
+#include "contactsmap-benchmark.moc"
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contact-generator.h"
+
+#include "common/filter.h"
+#include "common/sort-clause.h"
+#include "lib/contact-less-than.h"
+#include "lib/contacts-map.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+
+#include <QtContacts>
+
+using namespace QtContacts;
+
+class FilterBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    QHash<int, QList<QContact> > m_contacts;
+
+    const QList<QContact> &contacts(int size)
+    {
+        if (!m_contacts.contains(size)) {
+            ContactGenerator generator;
+            m_contacts.insert(size, generator.contacts(size));
+        }
+        return m_contacts[size];
+    }
+
+    QContactFilter searchFilter(const QString &text)
+    {
+        // same filter created by the address book app search field
+        QContactDetailFilter label;
+        label.setDetailType(QContactDisplayLabel::Type, QContactDisplayLabel::FieldLabel);
+        label.setMatchFlags(QContactFilter::MatchContains);
+        label.setValue(text);
+
+        QContactDetailFilter phone = QContactPhoneNumber::match(text);
+        phone.setMatchFlags(QContactFilter::MatchPhoneNumber | QContactFilter::MatchContains);
+
+        QContactDetailFilter email;
+        email.setDetailType(QContactEmailAddress::Type, QContactEmailAddress::FieldEmailAddress);
+        email.setMatchFlags(QContactFilter::MatchContains);
+        email.setValue(text);
+
+        QContactUnionFilter search;
+        search << label << phone << email;
+        return search;
+    }
+
+private Q_SLOTS:
+    void benchmarkFilter_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<QString>("filter");
+
+        QStringList shapes;
+        shapes << "empty" << "label-contains" << "phone-match" << "phone-match-normalized" << "search" << "favorite" << "ids";
+        Q_FOREACH(int size, ContactGenerator::sizes()) {
+            Q_FOREACH(const QString &shape, shapes) {
+                QTest::newRow(qPrintable(ContactGenerator::sizeName(size) + ":" + shape)) << size << shape;
+            }
+        }
+    }
+
+    void benchmarkFilter()
+    {
+        QFETCH(int, size);
+        QFETCH(QString, filter);
+
+        QContactFilter cFilter;
+        if (filter == "label-contains") {
+            QContactDetailFilter label;
+            label.setDetailType(QContactDisplayLabel::Type, QContactDisplayLabel::FieldLabel);
+            label.setMatchFlags(QContactFilter::MatchContains);
+            label.setValue("mar");
+            cFilter = label;
+        } else if ((filter == "phone-match") || (filter == "phone-match-normalized")) {
+            cFilter = QContactPhoneNumber::match("+55 81 92345-0001");
+        } else if (filter == "search") {
+            cFilter = searchFilter("mar");
+        } else if (filter == "favorite") {
+            cFilter = QContactFavorite::match();
+        } else if (filter == "ids") {
+            QContactIdFilter ids;
+            QList<QContactId> idList;
+            for (int i = 0; i < 10; i++) {
+                idList << contacts(size).at(i * (size / 10)).id();
+            }
+            ids.setIds(idList);
+            cFilter = ids;
+        }
+
+        const QList<QContact> &list = contacts(size);
+        // the filter threads use the numbers normalized when the contact is loaded
+        QList<QStringList> normalizedPhones;
+        Q_FOREACH(const QContact &c, list) {
+            QStringList phones;
+            if (filter == "phone-match-normalized") {
+                Q_FOREACH(const QContactPhoneNumber &p, c.details<QContactPhoneNumber>()) {
+                    phones << galera::Filter::normalizePhoneNumber(p.number());
+                }
+            }
+            normalizedPhones << phones;
+        }
+
+        galera::Filter gFilter(cFilter);
+        int matches = 0;
+        QBENCHMARK {
+            matches = 0;
+            for (int i = 0; i < list.size(); i++) {
+                if (gFilter.test(list[i], QDateTime(), normalizedPhones[i])) {
+                    matches++;
+                }
+            }
+        }
+        QVERIFY(matches <= size);
+    }
+
+    void benchmarkSortClauseChange_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<QString>("sort");
+
+        QStringList clauses;
+        clauses << "" << "FIRST_NAME ASC" << "LAST_NAME DESC, FIRST_NAME ASC" << "PHONE ASC";
+        Q_FOREACH(int size, ContactGenerator::sizes()) {
+            Q_FOREACH(const QString &clause, clauses) {
+                QString name = clause.isEmpty() ? QString("default") : clause;
+                QTest::newRow(qPrintable(ContactGenerator::sizeName(size) + ":" + name)) << size << clause;
+            }
+        }
+    }
+
+    void benchmarkSortClauseChange()
+    {
+        QFETCH(int, size);
+        QFETCH(QString, sort);
+
+        // the empty clause is the default sort used by the contacts map
+        galera::SortClause clause = sort.isEmpty() ? galera::ContactsMap::defaultSort() : galera::SortClause(sort);
+        galera::ContactLessThan lessThan(clause);
+        QList<QContact> list = contacts(size);
+        QBENCHMARK {
+            QList<QContact> sorted(list);
+            qSort(sorted.begin(), sorted.end(), lessThan);
+        }
+    }
+};
+
+QTEST_MAIN(FilterBenchmark)
+
+#include "filter-benchmark.moc"
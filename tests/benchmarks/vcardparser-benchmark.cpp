@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contact-generator.h"
+
+#include "common/vcard-parser.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+
+#include <QtContacts>
+
+using namespace QtContacts;
+
+class VCardParserBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchmarkExport_data()
+    {
+        QTest::addColumn<int>("size");
+        Q_FOREACH(int size, ContactGenerator::sizes()) {
+            QTest::newRow(qPrintable(ContactGenerator::sizeName(size))) << size;
+        }
+    }
+
+    void benchmarkExport()
+    {
+        QFETCH(int, size);
+
+        ContactGenerator generator;
+        QList<QContact> contacts = generator.contacts(size);
+        QStringList vcards;
+        QBENCHMARK {
+            vcards = galera::VCardParser::contactToVcardSync(contacts);
+        }
+        QCOMPARE(vcards.size(), size);
+    }
+
+    void benchmarkImport_data()
+    {
+        benchmarkExport_data();
+    }
+
+    void benchmarkImport()
+    {
+        QFETCH(int, size);
+
+        ContactGenerator generator;
+        QStringList vcards = galera::VCardParser::contactToVcardSync(generator.contacts(size));
+        QList<QContact> contacts;
+        QBENCHMARK {
+            contacts = galera::VCardParser::vcardToContactSync(vcards);
+        }
+        QCOMPARE(contacts.size(), size);
+    }
+};
+
+QTEST_MAIN(VCardParserBenchmark)
+
+#include "vcardparser-benchmark.moc"
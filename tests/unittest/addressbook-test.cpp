@@ -20,12 +20,15 @@
 #include "common/source.h"
 #include "common/dbus-service-defs.h"
 #include "common/vcard-parser.h"
+#include "lib/workload-recorder.h"
 
 #include <QObject>
 #include <QtDBus>
 #include <QtTest>
 #include <QDebug>
 #include <QtVersit>
+#include <QJsonDocument>
+#include <QTemporaryDir>
 
 class AddressBookTest : public BaseClientTest
 {
@@ -314,6 +317,364 @@ private Q_SLOTS:
         contactUpdatedResult = contacts[0];
         compareContact(contactUpdatedResult, contactUpdated);
     }
+
+    void testNotificationStatistics()
+    {
+        QDBusReply<QVariantMap> replyStats = m_serverIface->call("notificationStatistics");
+        int batches = replyStats.value().value("batches").toInt();
+
+        // a single contact creation should be notified as an interactive change
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        replyStats = m_serverIface->call("notificationStatistics");
+        QVariantMap stats = replyStats.value();
+        QCOMPARE(stats.value("batches").toInt(), batches + 1);
+        QVERIFY(stats.value("maxBatchSize").toInt() >= 1);
+        QVERIFY(stats.value("maxDelay").toLongLong() <= 2000);
+    }
+
+    void testUpdateContactDetailedSignal()
+    {
+        // register to receive the detailed signal with the phone numbers
+        QDBusReply<void> replyRegister = m_serverIface->call("registerChangesListener",
+                                                             QStringList() << "TEL",
+                                                             true);
+        QVERIFY(replyRegister.isValid());
+
+        // create a basic contact
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        QString vcard = replyAdd.value();
+        QContact newContact = galera::VCardParser::vcardToContact(vcard);
+        QString newContactId = newContact.detail<QContactGuid>().guid();
+
+        // update the contact phone number
+        vcard = vcard.replace("8888888", "0000000");
+        QSignalSpy updateContactSpy(m_serverIface, SIGNAL(contactsUpdatedDetailed(QStringList, QList<int>, QStringList)));
+        QDBusReply<QStringList> replyUpdate = m_serverIface->call("updateContacts", QStringList() << vcard);
+        QCOMPARE(replyUpdate.value().size(), 1);
+
+        // check if the signal contains the contact with the requested fields
+        QTRY_COMPARE(updateContactSpy.count(), 1);
+        QList<QVariant> args = updateContactSpy.takeFirst();
+        QCOMPARE(args.count(), 3);
+        QStringList ids = args[0].toStringList();
+        QCOMPARE(ids, QStringList() << newContactId);
+        QList<int> types = args[1].value<QList<int> >();
+        QVERIFY(types.isEmpty() || types.contains(QtContacts::QContactDetail::TypePhoneNumber));
+        QStringList vcards = args[2].toStringList();
+        QCOMPARE(vcards.size(), 1);
+
+        QtContacts::QContact contact = galera::VCardParser::vcardToContact(vcards[0]);
+        QCOMPARE(contact.detail<QContactGuid>().guid(), newContactId);
+        QCOMPARE(contact.details<QtContacts::QContactPhoneNumber>().size(), 2);
+        QVERIFY(contact.detail<QtContacts::QContactEmailAddress>().isEmpty());
+        QVERIFY(vcards[0].contains("0000000"));
+
+        QDBusReply<void> replyUnregister = m_serverIface->call("unregisterChangesListener");
+        QVERIFY(replyUnregister.isValid());
+    }
+
+    void testLookupPhone()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QString newContactId = replyAdd.value();
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        // formatted number
+        QDBusReply<QStringList> replyLookup = m_serverIface->call("lookupPhone", "3333-1410", QStringList() << "TEL");
+        QStringList vcards = replyLookup.value();
+        QCOMPARE(vcards.size(), 1);
+        QtContacts::QContact contact = galera::VCardParser::vcardToContact(vcards[0]);
+        QCOMPARE(contact.detail<QContactGuid>().guid(), newContactId);
+
+        // second lookup is answered by the cache
+        replyLookup = m_serverIface->call("lookupPhone", "33331410", QStringList());
+        QCOMPARE(replyLookup.value().size(), 1);
+
+        replyLookup = m_serverIface->call("lookupPhone", "55551234", QStringList());
+        QVERIFY(replyLookup.value().isEmpty());
+
+        // the cache must be invalidated when the contact is removed
+        QSignalSpy removedContactSpy(m_serverIface, SIGNAL(contactsRemoved(QStringList)));
+        m_serverIface->call("removeContacts", QStringList() << newContactId);
+        QTRY_COMPARE(removedContactSpy.count(), 1);
+
+        replyLookup = m_serverIface->call("lookupPhone", "33331410", QStringList());
+        QVERIFY(replyLookup.value().isEmpty());
+    }
+
+    void testContactsByIds()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QString newContactId = replyAdd.value();
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        // unknown ids are ignored
+        QDBusReply<QStringList> replyIds = m_serverIface->call("contactsByIds",
+                                                               QStringList() << "unknown-id" << newContactId,
+                                                               QStringList() << "TEL");
+        QVERIFY(replyIds.isValid());
+        QStringList vcards = replyIds.value();
+        QCOMPARE(vcards.size(), 1);
+        QtContacts::QContact contact = galera::VCardParser::vcardToContact(vcards[0]);
+        QCOMPARE(contact.detail<QContactGuid>().guid(), newContactId);
+        QCOMPARE(contact.details<QContactPhoneNumber>().size(), 2);
+
+        replyIds = m_serverIface->call("contactsByIds", QStringList() << "unknown-id", QStringList());
+        QVERIFY(replyIds.isValid());
+        QVERIFY(replyIds.value().isEmpty());
+
+        // removed contacts are not returned
+        QSignalSpy removedContactSpy(m_serverIface, SIGNAL(contactsRemoved(QStringList)));
+        m_serverIface->call("removeContacts", QStringList() << newContactId);
+        QTRY_COMPARE(removedContactSpy.count(), 1);
+
+        replyIds = m_serverIface->call("contactsByIds", QStringList() << newContactId, QStringList());
+        QVERIFY(replyIds.value().isEmpty());
+    }
+
+    void testQueryFirstPage()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QString newContactId = replyAdd.value();
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        // the view and its first page are returned by a single call
+        QDBusMessage reply = m_serverIface->call("queryFirstPage", "", "", 0, false, QStringList(),
+                                                 QStringList(), 10);
+        QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+        QCOMPARE(reply.arguments().size(), 2);
+        QDBusObjectPath viewPath = qdbus_cast<QDBusObjectPath>(reply.arguments()[0]);
+        QStringList vcards = qdbus_cast<QStringList>(reply.arguments()[1]);
+        QCOMPARE(vcards.size(), 1);
+        QtContacts::QContact contact = galera::VCardParser::vcardToContact(vcards[0]);
+        QCOMPARE(contact.detail<QContactGuid>().guid(), newContactId);
+
+        // the view keeps working for the next pages
+        QDBusInterface view(m_serverIface->service(),
+                            viewPath.path(),
+                            CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        QVERIFY(view.isValid());
+        QDBusReply<QStringList> replyPage = view.call("contactsDetails", QStringList(), 1, 10);
+        QVERIFY(replyPage.isValid());
+        QVERIFY(replyPage.value().isEmpty());
+        view.call("close");
+    }
+
+    void testSmartDial()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> replyAdd = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QString newContactId = replyAdd.value();
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        // "Fulano_ Tal": first name, last name, full name and phone number
+        QStringList digits;
+        digits << "3852" << "825" << "385266825" << "3141";
+        Q_FOREACH(const QString &d, digits) {
+            QDBusReply<QStringList> replyDial = m_serverIface->call("smartDial", d, 10);
+            QCOMPARE(replyDial.value(), QStringList() << newContactId);
+        }
+
+        QDBusReply<QStringList> replyDial = m_serverIface->call("smartDial", "999", 10);
+        QVERIFY(replyDial.value().isEmpty());
+
+        // the index must be updated when the contact is removed
+        QSignalSpy removedContactSpy(m_serverIface, SIGNAL(contactsRemoved(QStringList)));
+        m_serverIface->call("removeContacts", QStringList() << newContactId);
+        QTRY_COMPARE(removedContactSpy.count(), 1);
+
+        replyDial = m_serverIface->call("smartDial", "3852", 10);
+        QVERIFY(replyDial.value().isEmpty());
+    }
+
+    void testStats()
+    {
+        QDBusInterface statsIface(m_serverIface->service(),
+                                  CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                  CPIM_ADDRESSBOOK_STATS_IFACE_NAME);
+        QVERIFY(!statsIface.lastError().isValid());
+        statsIface.call("reset");
+
+        m_serverIface->call("smartDial", "3852", 10);
+        m_serverIface->call("smartDial", "825", 10);
+
+        QDBusReply<QString> replyDump = statsIface.call("dump");
+        QVERIFY(replyDump.isValid());
+        QVariantMap stats = QJsonDocument::fromJson(replyDump.value().toUtf8()).toVariant().toMap();
+        QVERIFY(stats.contains("counters"));
+        QVERIFY(stats.contains("notifications"));
+        QVariantMap smartDial = stats["histograms"].toMap()["AddressBook.smartDial"].toMap();
+        QCOMPARE(smartDial["count"].toInt(), 2);
+        QVERIFY(smartDial["p99"].toLongLong() <= smartDial["max"].toLongLong());
+
+        statsIface.call("reset");
+        replyDump = statsIface.call("dump");
+        stats = QJsonDocument::fromJson(replyDump.value().toUtf8()).toVariant().toMap();
+        smartDial = stats["histograms"].toMap()["AddressBook.smartDial"].toMap();
+        QCOMPARE(smartDial["count"].toInt(), 0);
+    }
+
+    void testMemoryUsage()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        QDBusReply<QString> reply = m_serverIface->call("createContact", m_basicVcard, "dummy-store");
+        QVERIFY(reply.isValid());
+        QTRY_COMPARE(addedContactSpy.count(), 1);
+
+        QDBusReply<QDBusObjectPath> viewPath = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QVERIFY(viewPath.isValid());
+
+        QDBusInterface statsIface(m_serverIface->service(),
+                                  CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                  CPIM_ADDRESSBOOK_STATS_IFACE_NAME);
+        QDBusReply<QString> replyDump = statsIface.call("dump");
+        QVERIFY(replyDump.isValid());
+        QVariantMap memory = QJsonDocument::fromJson(replyDump.value().toUtf8()).toVariant().toMap()["memory"].toMap();
+        QVERIFY(memory["individuals"].toLongLong() > 0);
+        QVERIFY(memory["phoneIndex"].toLongLong() > 0);
+        QVERIFY(memory["cachedContacts"].toInt() > 0);
+        QVERIFY(memory["contacts"].toLongLong() > 0);
+        QVERIFY(memory["openViews"].toInt() > 0);
+        QVERIFY(memory["total"].toLongLong() >= (memory["contacts"].toLongLong() + memory["individuals"].toLongLong()));
+        // the test server does not set a budget
+        QCOMPARE(memory["budget"].toLongLong(), qint64(0));
+
+        QDBusInterface view(m_serverIface->service(),
+                            viewPath.value().path(),
+                            CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        view.call("close");
+    }
+
+    void testViewReaping()
+    {
+        QDBusInterface statsIface(m_serverIface->service(),
+                                  CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                  CPIM_ADDRESSBOOK_STATS_IFACE_NAME);
+        statsIface.call("reset");
+        auto counters = [&statsIface]() {
+            QDBusReply<QString> replyDump = statsIface.call("dump");
+            return QJsonDocument::fromJson(replyDump.value().toUtf8()).toVariant().toMap()["counters"].toMap();
+        };
+
+        // views of a client that leaves the bus are closed
+        QDBusConnection client = QDBusConnection::connectToBus(QDBusConnection::SessionBus, "view-reaping-client");
+        QDBusInterface clientIface(m_serverIface->service(),
+                                   CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                   CPIM_ADDRESSBOOK_IFACE_NAME,
+                                   client);
+        QDBusReply<QDBusObjectPath> viewPath = clientIface.call("query", "", "", 0, false, QStringList());
+        QVERIFY(viewPath.isValid());
+        QDBusConnection::disconnectFromBus("view-reaping-client");
+
+        QTRY_COMPARE(counters()["Views.reapedDisconnected"].toInt(), 1);
+        QDBusInterface view(m_serverIface->service(),
+                            viewPath.value().path(),
+                            CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        QDBusReply<int> count = view.call("count");
+        QVERIFY(!count.isValid());
+
+        // the least recently used view is closed when the client opens too many
+        QStringList paths;
+        for(int i = 0; i <= 32; i++) {
+            viewPath = m_serverIface->call("query", "", "", 0, false, QStringList());
+            QVERIFY(viewPath.isValid());
+            paths << viewPath.value().path();
+        }
+        QCOMPARE(counters()["Views.reapedLimit"].toInt(), 1);
+
+        QDBusInterface firstView(m_serverIface->service(),
+                                 paths.first(),
+                                 CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        count = firstView.call("count");
+        QVERIFY(!count.isValid());
+
+        Q_FOREACH(const QString &path, paths.mid(1)) {
+            QDBusInterface openView(m_serverIface->service(),
+                                    path,
+                                    CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+            openView.call("close");
+        }
+    }
+
+    void testStartupTimeline()
+    {
+        QDBusInterface statsIface(m_serverIface->service(),
+                                  CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                  CPIM_ADDRESSBOOK_STATS_IFACE_NAME);
+        QDBusReply<QString> reply = statsIface.call("startupTimeline");
+        QVERIFY(reply.isValid());
+
+        QVariantList timeline = QJsonDocument::fromJson(reply.value().toUtf8()).toVariant().toList();
+        QStringList phases;
+        qint64 lastTime = 0;
+        Q_FOREACH(const QVariant &entry, timeline) {
+            QVariantMap phase = entry.toMap();
+            phases << phase["phase"].toString();
+            // the timeline is monotonic
+            QVERIFY(phase["time"].toLongLong() >= lastTime);
+            lastTime = phase["time"].toLongLong();
+        }
+
+        QVERIFY(phases.contains("start"));
+        QVERIFY(phases.contains("prepareFolks"));
+        QVERIFY(phases.contains("ready"));
+        QVERIFY(phases.indexOf("prepareFolks") < phases.indexOf("ready"));
+        // the individuals batches are aggregated in a single phase
+        QVERIFY(phases.count("individualsBatch") <= 1);
+    }
+
+    void testWorkloadRecorder()
+    {
+        QTemporaryDir dir;
+        QString fileName = dir.path() + "/workload";
+        QVERIFY(galera::WorkloadRecorder::start(fileName));
+
+        QDBusMessage query = QDBusMessage::createMethodCall(CPIM_SERVICE_NAME,
+                                                            CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                                            CPIM_ADDRESSBOOK_IFACE_NAME,
+                                                            "query");
+        {
+            GALERA_WORKLOAD_RECORD(query, QString("") << QString("") << -1 << false << QStringList());
+            GALERA_WORKLOAD_RESULT(QString(CPIM_ADDRESSBOOK_VIEW_OBJECT_PATH "/1"));
+        }
+        QDBusMessage page = QDBusMessage::createMethodCall(CPIM_SERVICE_NAME,
+                                                           CPIM_ADDRESSBOOK_VIEW_OBJECT_PATH "/1",
+                                                           CPIM_ADDRESSBOOK_VIEW_IFACE_NAME,
+                                                           "contactsDetails");
+        {
+            GALERA_WORKLOAD_RECORD(page, QStringList() << 0 << 10);
+            page.setDelayedReply(true);
+        }
+        galera::WorkloadRecorder::stop();
+
+        // calls are not recorded after stop
+        {
+            GALERA_WORKLOAD_RECORD_NO_ARGS(query);
+            QVERIFY(!_workloadScope.isActive());
+        }
+
+        QList<galera::WorkloadCall> calls = galera::WorkloadRecorder::load(fileName);
+        QCOMPARE(calls.size(), 2);
+        QCOMPARE(calls[0].member, QString("query"));
+        QCOMPARE(calls[0].path, QString(CPIM_ADDRESSBOOK_OBJECT_PATH));
+        QCOMPARE(calls[0].arguments.size(), 5);
+        QCOMPARE(calls[0].arguments[2].toInt(), -1);
+        QCOMPARE(calls[0].result, QString(CPIM_ADDRESSBOOK_VIEW_OBJECT_PATH "/1"));
+        QVERIFY(!calls[0].delayed);
+        QCOMPARE(calls[1].interface, QString(CPIM_ADDRESSBOOK_VIEW_IFACE_NAME));
+        QCOMPARE(calls[1].arguments[2].toInt(), 10);
+        QVERIFY(calls[1].delayed);
+        QVERIFY(calls[1].offset >= calls[0].offset);
+    }
 };
 
 QTEST_MAIN(AddressBookTest)
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2016 Canonical Ltd.
+ *
+ * This file is part of contact-service-app.
+ *
+ * contact-service-app is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * contact-service-app is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QObject>
+#include <QtTest>
+#include <QDebug>
+#include <QTemporaryDir>
+
+#include "lib/avatar-store.h"
+
+using namespace galera;
+
+class AvatarStoreTest : public QObject
+{
+    Q_OBJECT
+private:
+    QTemporaryDir m_cacheDir;
+
+    QStringList storedAvatars()
+    {
+        QDir dir(AvatarStore::storeDir());
+        QStringList avatars = dir.entryList(QDir::Files);
+        avatars.removeAll("index");
+        return avatars;
+    }
+
+    QString writeFile(const QString &name, const QByteArray &data)
+    {
+        QFile file(m_cacheDir.path() + "/" + name);
+        file.open(QIODevice::WriteOnly);
+        file.write(data);
+        file.close();
+        return file.fileName();
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(m_cacheDir.isValid());
+        qputenv("XDG_CACHE_HOME", m_cacheDir.path().toUtf8());
+    }
+
+    void testDeduplication()
+    {
+        GBytes *photo = g_bytes_new_static("photo-content", 13);
+        GBytes *samePhoto = g_bytes_new_static("photo-content", 13);
+
+        QString url = AvatarStore::instance()->store("contact-a", photo);
+        QVERIFY(!url.isEmpty());
+        QVERIFY(QFile::exists(QUrl(url).toLocalFile()));
+
+        // the same content is stored only once
+        QCOMPARE(AvatarStore::instance()->store("contact-b", samePhoto), url);
+        QCOMPARE(AvatarStore::instance()->store("contact-a", photo), url);
+        QCOMPARE(storedAvatars().size(), 1);
+
+        g_bytes_unref(photo);
+        g_bytes_unref(samePhoto);
+    }
+
+    void testCollect()
+    {
+        GBytes *photo = g_bytes_new_static("other-photo", 11);
+        QString url = AvatarStore::instance()->store("contact-c", photo);
+        g_bytes_unref(photo);
+        QCOMPARE(storedAvatars().size(), 2);
+
+        // still used by contact-b
+        AvatarStore::instance()->release("contact-a");
+        AvatarStore::instance()->release("contact-c");
+        QMetaObject::invokeMethod(AvatarStore::instance(), "collect");
+        QCOMPARE(storedAvatars().size(), 1);
+        QVERIFY(!QFile::exists(QUrl(url).toLocalFile()));
+
+        AvatarStore::instance()->release("contact-b");
+        QMetaObject::invokeMethod(AvatarStore::instance(), "collect");
+        QVERIFY(storedAvatars().isEmpty());
+    }
+
+    void testSameContent()
+    {
+        QUrl fileA = QUrl::fromLocalFile(writeFile("a.jpg", "avatar"));
+        QUrl fileB = QUrl::fromLocalFile(writeFile("b.jpg", "avatar"));
+        QUrl fileC = QUrl::fromLocalFile(writeFile("c.jpg", "avatar2"));
+
+        QVERIFY(AvatarStore::sameContent(fileA, fileB));
+        QVERIFY(!AvatarStore::sameContent(fileA, fileC));
+        QVERIFY(!AvatarStore::sameContent(fileA, QUrl()));
+
+        // a stored avatar is compared by the hash on its name
+        GBytes *photo = g_bytes_new_static("avatar", 6);
+        QUrl stored(AvatarStore::instance()->store("contact-d", photo));
+        g_bytes_unref(photo);
+        QVERIFY(AvatarStore::sameContent(stored, fileA));
+        QVERIFY(AvatarStore::sameContent(fileB, stored));
+        QVERIFY(!AvatarStore::sameContent(stored, fileC));
+        AvatarStore::instance()->release("contact-d");
+    }
+};
+
+QTEST_MAIN(AvatarStoreTest)
+
+#include "avatar-store-test.moc"
@@ -265,6 +265,66 @@ private Q_SLOTS:
         //QCOMPARE(myFilter.test(c), matchExactly);
     }
 
+    void testPhoneNumberFilterWithNormalizedNumbers()
+    {
+        QContact c;
+        QContactPhoneNumber p;
+        p.setNumber("+55(81)87042155");
+        c.saveDetail(&p);
+        QStringList normalized;
+        normalized << Filter::normalizePhoneNumber(p.number());
+
+        Filter match(QContactPhoneNumber::match("(81)87042155"));
+        QVERIFY(match.test(c));
+        QVERIFY(match.test(c, QDateTime(), normalized));
+
+        Filter noMatch(QContactPhoneNumber::match("(81)87042156"));
+        QVERIFY(!noMatch.test(c));
+        QVERIFY(!noMatch.test(c, QDateTime(), normalized));
+    }
+
+    void testIsNarrowerThan()
+    {
+        QContactDetailFilter jo;
+        jo.setDetailType(QContactDisplayLabel::Type, QContactDisplayLabel::FieldLabel);
+        jo.setMatchFlags(QContactFilter::MatchStartsWith);
+        jo.setValue("jo");
+
+        QContactDetailFilter joh(jo);
+        joh.setValue("Joh");
+
+        QContactDetailFilter ma(jo);
+        ma.setValue("ma");
+
+        QVERIFY(Filter(joh).isNarrowerThan(Filter(jo)));
+        QVERIFY(Filter(jo).isNarrowerThan(Filter(jo)));
+        QVERIFY(!Filter(jo).isNarrowerThan(Filter(joh)));
+        QVERIFY(!Filter(ma).isNarrowerThan(Filter(jo)));
+
+        // exact match does not narrow
+        QContactDetailFilter joExactly(jo);
+        joExactly.setMatchFlags(QContactFilter::MatchExactly);
+        QContactDetailFilter johExactly(joh);
+        johExactly.setMatchFlags(QContactFilter::MatchExactly);
+        QVERIFY(!Filter(johExactly).isNarrowerThan(Filter(joExactly)));
+
+        // union with the same structure
+        QContactDetailFilter phone = QContactPhoneNumber::match("jo");
+        phone.setMatchFlags(QContactFilter::MatchPhoneNumber | QContactFilter::MatchContains);
+        QContactDetailFilter phoneJoh(phone);
+        phoneJoh.setValue("joh");
+
+        QContactUnionFilter unionJo;
+        unionJo << jo << phone;
+        QContactUnionFilter unionJoh;
+        unionJoh << joh << phoneJoh;
+        QContactUnionFilter unionMa;
+        unionMa << ma << phoneJoh;
+        QVERIFY(Filter(unionJoh).isNarrowerThan(Filter(unionJo)));
+        QVERIFY(!Filter(unionMa).isNarrowerThan(Filter(unionJo)));
+        QVERIFY(!Filter(unionJoh).isNarrowerThan(Filter(jo)));
+    }
+
     void testExtractIds()
     {
         QContactIdFilter originalFilter;
@@ -20,12 +20,14 @@
 #include "common/source.h"
 #include "common/dbus-service-defs.h"
 #include "common/vcard-parser.h"
+#include "lib/section-index.h"
 
 #include <QObject>
 #include <QtDBus>
 #include <QtTest>
 #include <QDebug>
 #include <QtContacts>
+#include <QJsonDocument>
 #include <QUuid>
 
 #include "config.h"
@@ -202,6 +204,215 @@ private Q_SLOTS:
         QCOMPARE(contactsCreated[4].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("(999) 999-9999"));
         QCOMPARE(contactsCreated[5].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("555-5555"));
     }
+
+    void testSectionIndex()
+    {
+        m_serverIface->call("createContact", createContact("Foo Bar"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Baz Quux"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Renato Araujo"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Fone Broke"), "dummy-store");
+        m_serverIface->call("createContact", createContact("", "555-5555"), "dummy-store");
+
+        QDBusMessage result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusObjectPath viewObjectPath = result.arguments()[0].value<QDBusObjectPath>();
+        QDBusInterface *view = new QDBusInterface(m_serverIface->service(),
+                                                  viewObjectPath.path(),
+                                                  CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+
+        // Baz Quux, Fone Broke, Foo Bar, Renato Araujo, 555-5555
+        QDBusReply<QStringList> reply = view->call("sectionIndex");
+        QCOMPARE(reply.value(), QStringList() << "B" << "F" << "R" << "");
+
+        QDBusMessage sections = view->call("sectionIndex");
+        QCOMPARE(sections.arguments().size(), 3);
+        QCOMPARE(qdbus_cast<QList<int> >(sections.arguments()[1]), QList<int>() << 0 << 1 << 3 << 4);
+        QCOMPARE(qdbus_cast<QList<int> >(sections.arguments()[2]), QList<int>() << 1 << 2 << 1 << 1);
+
+        // jump to "F" section
+        QDBusReply<QStringList> page = view->call("contactsDetails", QStringList(), 1, 2);
+        QList<QtContacts::QContact> contacts = galera::VCardParser::vcardToContactSync(page.value());
+        QCOMPARE(contacts.count(), 2);
+        QCOMPARE(contacts[0].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("Fone Broke"));
+        QCOMPARE(contacts[1].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("Foo Bar"));
+        delete view;
+    }
+
+    void testSectionIndexCollation()
+    {
+        m_serverIface->call("createContact", createContact("\u00e9lodie Martin"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Eva Lima"), "dummy-store");
+        m_serverIface->call("createContact", createContact("alice Souza"), "dummy-store");
+        m_serverIface->call("createContact", createContact("\u00c1gata Costa"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Bob Dylan"), "dummy-store");
+        m_serverIface->call("createContact", createContact("zoe Reis"), "dummy-store");
+
+        QDBusMessage result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusObjectPath viewObjectPath = result.arguments()[0].value<QDBusObjectPath>();
+        QDBusInterface *view = new QDBusInterface(m_serverIface->service(),
+                                                  viewObjectPath.path(),
+                                                  CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+
+        QDBusMessage sections = view->call("sectionIndex");
+        QStringList names = sections.arguments()[0].toStringList();
+        QList<int> offsets = qdbus_cast<QList<int> >(sections.arguments()[1]);
+        QList<int> counts = qdbus_cast<QList<int> >(sections.arguments()[2]);
+        QCOMPARE(names.toSet().size(), names.size());
+        QCOMPARE(offsets.size(), names.size());
+        QCOMPARE(counts.size(), names.size());
+
+        // each section must cover exactly the contacts with its letter in the view order
+        QDBusReply<QStringList> reply = view->call("contactsDetails", QStringList(), 0, 100);
+        QList<QtContacts::QContact> contacts = galera::VCardParser::vcardToContactSync(reply.value());
+        QCOMPARE(contacts.count(), 6);
+        int offset = 0;
+        for (int i = 0; i < names.size(); i++) {
+            QCOMPARE(offsets[i], offset);
+            for (int j = offset; j < (offset + counts[i]); j++) {
+                QCOMPARE(galera::SectionIndex::sectionName(contacts[j]), names[i]);
+            }
+            offset += counts[i];
+        }
+        QCOMPARE(offset, contacts.count());
+        delete view;
+    }
+
+    void testSharedViews()
+    {
+        QSignalSpy addedContactSpy(m_serverIface, SIGNAL(contactsAdded(QStringList)));
+        m_serverIface->call("createContact", createContact("Foo Bar"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Baz Quux"), "dummy-store");
+        QTRY_COMPARE(addedContactSpy.count(), 2);
+
+        QDBusInterface statsIface(m_serverIface->service(),
+                                  CPIM_ADDRESSBOOK_OBJECT_PATH,
+                                  CPIM_ADDRESSBOOK_STATS_IFACE_NAME);
+        statsIface.call("reset");
+
+        // both views use the same result
+        QDBusMessage result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusInterface *viewA = new QDBusInterface(m_serverIface->service(),
+                                                   result.arguments()[0].value<QDBusObjectPath>().path(),
+                                                   CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusInterface *viewB = new QDBusInterface(m_serverIface->service(),
+                                                   result.arguments()[0].value<QDBusObjectPath>().path(),
+                                                   CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        QVERIFY(viewA->path() != viewB->path());
+
+        // the contacts were filtered only once
+        QDBusReply<QString> replyDump = statsIface.call("dump");
+        QVERIFY(replyDump.isValid());
+        QVariantMap stats = QJsonDocument::fromJson(replyDump.value().toUtf8()).toVariant().toMap();
+        QCOMPARE(stats["counters"].toMap()["FilterThread.all"].toInt(), 1);
+
+        QDBusReply<QStringList> reply = viewA->call("contactsDetails", QStringList(), 0, 100);
+        QCOMPARE(reply.value().count(), 2);
+
+        // sort one of them does not change the other
+        viewA->call("sort", "FIRST_NAME DESC");
+        viewA->call("close");
+        delete viewA;
+
+        reply = viewB->call("contactsDetails", QStringList(), 0, 100);
+        QList<QtContacts::QContact> contacts = galera::VCardParser::vcardToContactSync(reply.value());
+        QCOMPARE(contacts.count(), 2);
+        QCOMPARE(contacts[0].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("Baz Quux"));
+        QCOMPARE(contacts[1].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("Foo Bar"));
+
+        // a new contact creates a new result
+        m_serverIface->call("createContact", createContact("Renato Araujo"), "dummy-store");
+        QTRY_COMPARE(addedContactSpy.count(), 3);
+        result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusInterface *viewC = new QDBusInterface(m_serverIface->service(),
+                                                   result.arguments()[0].value<QDBusObjectPath>().path(),
+                                                   CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+        reply = viewC->call("contactsDetails", QStringList(), 0, 100);
+        QCOMPARE(reply.value().count(), 3);
+        delete viewB;
+        delete viewC;
+    }
+
+    void testPageToken()
+    {
+        m_serverIface->call("createContact", createContact("Foo Bar"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Baz Quux"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Renato Araujo"), "dummy-store");
+        m_serverIface->call("createContact", createContact("Fone Broke"), "dummy-store");
+
+        QDBusMessage result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusInterface *view = new QDBusInterface(m_serverIface->service(),
+                                                  result.arguments()[0].value<QDBusObjectPath>().path(),
+                                                  CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+
+        // Baz Quux, Fone Broke, Foo Bar, Renato Araujo
+        QDBusMessage page = view->call("contactsDetailsFrom", QStringList(), QString(), 3);
+        QCOMPARE(page.arguments().size(), 2);
+        QList<QtContacts::QContact> contacts = galera::VCardParser::vcardToContactSync(page.arguments()[0].toStringList());
+        QCOMPARE(contacts.count(), 3);
+        QCOMPARE(contacts[2].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("Foo Bar"));
+        QString token = page.arguments()[1].toString();
+        QVERIFY(!token.isEmpty());
+
+        page = view->call("contactsDetailsFrom", QStringList(), token, 3);
+        contacts = galera::VCardParser::vcardToContactSync(page.arguments()[0].toStringList());
+        QCOMPARE(contacts.count(), 1);
+        QCOMPARE(contacts[0].detail<QtContacts::QContactDisplayLabel>().label(), QStringLiteral("Renato Araujo"));
+        // last page
+        QVERIFY(page.arguments()[1].toString().isEmpty());
+
+        // invalid token
+        page = view->call("contactsDetailsFrom", QStringList(), QString("invalid"), 3);
+        QCOMPARE(page.type(), QDBusMessage::ErrorMessage);
+
+        // a token of a contact that is not on the view, Eg. from another view
+        QByteArray data = QByteArray::fromBase64(token.toLatin1());
+        QString id;
+        QVariantList keys;
+        QDataStream input(data);
+        input >> id >> keys;
+        QByteArray otherData;
+        QDataStream output(&otherData, QIODevice::WriteOnly);
+        output << QString("unknown-id") << keys;
+        page = view->call("contactsDetailsFrom", QStringList(), QString::fromLatin1(otherData.toBase64()), 3);
+        QCOMPARE(page.type(), QDBusMessage::ErrorMessage);
+        QCOMPARE(page.errorName(), QString("org.freedesktop.DBus.Error.InvalidArgs"));
+        delete view;
+    }
+
+    void testPageTokenWithDuplicatedNames()
+    {
+        m_serverIface->call("createContact", createContact("Baz Quux"), "dummy-store");
+        for (int i = 0; i < 4; i++) {
+            m_serverIface->call("createContact", createContact("Foo Bar"), "dummy-store");
+        }
+        m_serverIface->call("createContact", createContact("Renato Araujo"), "dummy-store");
+
+        QDBusMessage result = m_serverIface->call("query", "", "", 0, false, QStringList());
+        QDBusInterface *view = new QDBusInterface(m_serverIface->service(),
+                                                  result.arguments()[0].value<QDBusObjectPath>().path(),
+                                                  CPIM_ADDRESSBOOK_VIEW_IFACE_NAME);
+
+        // Baz Quux, Foo Bar x4, Renato Araujo: the page boundaries fall inside the "Foo Bar" contacts
+        QStringList ids;
+        QString token;
+        int pages = 0;
+        do {
+            QDBusMessage page = view->call("contactsDetailsFrom", QStringList(), token, 2);
+            QCOMPARE(page.arguments().size(), 2);
+            Q_FOREACH(const QtContacts::QContact &contact,
+                      galera::VCardParser::vcardToContactSync(page.arguments()[0].toStringList())) {
+                ids << contact.detail<QtContacts::QContactGuid>().guid();
+            }
+            token = page.arguments()[1].toString();
+            pages++;
+        } while (!token.isEmpty() && (pages < 10));
+
+        // every contact returned once
+        QCOMPARE(pages, 3);
+        QCOMPARE(ids.size(), 6);
+        QCOMPARE(ids.toSet().size(), 6);
+        delete view;
+    }
 };
 
 QTEST_MAIN(ContactSortTest)
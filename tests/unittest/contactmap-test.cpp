@@ -196,6 +196,69 @@ private Q_SLOTS:
         QVERIFY(entry->individual()->individual() == individual);
     }
 
+    void testLookupPhoneVisibility()
+    {
+        galera::ContactEntry *entry = m_map.value(m_individuals.first());
+        QVERIFY(entry);
+        QString id = entry->individual()->id();
+        QString phone = entry->individual()->contact().detail<QtContacts::QContactPhoneNumber>().number();
+        QCOMPARE(m_map.lookupPhone(phone), id);
+
+        // cached results must not survive a visibility change
+        entry->individual()->setVisible(false);
+        m_map.updateIndexes(entry);
+        QVERIFY(m_map.lookupPhone(phone).isEmpty());
+
+        // neither the negative ones
+        entry->individual()->setVisible(true);
+        m_map.updateIndexes(entry);
+        QCOMPARE(m_map.lookupPhone(phone), id);
+    }
+
+    void testLookupPhoneInvalidation()
+    {
+        m_map.releaseCaches();
+        galera::ContactEntry *entry = m_map.value(m_individuals[0]);
+        galera::ContactEntry *other = m_map.value(m_individuals[1]);
+        QVERIFY(entry && other);
+        QString phone = entry->individual()->contact().detail<QtContacts::QContactPhoneNumber>().number();
+        QCOMPARE(m_map.lookupPhone(phone), entry->individual()->id());
+        QVERIFY(m_map.memoryUsage()["phoneLookupCache"].toLongLong() > 0);
+
+        // a change on a contact with other numbers keeps the cached lookup
+        m_map.updateIndexes(other);
+        QVERIFY(m_map.memoryUsage()["phoneLookupCache"].toLongLong() > 0);
+
+        // a change on the contact drops it
+        m_map.updateIndexes(entry);
+        QCOMPARE(m_map.memoryUsage()["phoneLookupCache"].toLongLong(), qint64(0));
+        QCOMPARE(m_map.lookupPhone(phone), entry->individual()->id());
+    }
+
+    void testSmartDialOrder()
+    {
+        // "fula" matches the first word of all contacts, they must follow the map order
+        QStringList expected;
+        Q_FOREACH(galera::ContactEntry *entry, m_map.values()) {
+            expected << entry->individual()->id();
+        }
+
+        QCOMPARE(m_map.smartDial("3852", 0), expected);
+        QCOMPARE(m_map.smartDial("3852", 2), expected.mid(0, 2));
+        QVERIFY(m_map.smartDial("999", 10).isEmpty());
+
+        // the keys of the updated contacts are replaced, the old ones are dropped
+        galera::QIndividual *first = m_map.value(m_individuals.first())->individual();
+        QString phone = first->normalizedPhoneNumbers().first();
+        for (int i = 0; i < 3; i++) {
+            Q_FOREACH(galera::ContactEntry *entry, m_map.values()) {
+                m_map.updateIndexes(entry);
+            }
+            QCOMPARE(m_map.smartDial("3852", 0), expected);
+            QCOMPARE(m_map.smartDial(phone, 0), QStringList() << first->id());
+        }
+    }
+
     void testLookupByPhone_data()
     {
         QStringList phones = allPhones();
@@ -100,6 +100,60 @@ private Q_SLOTS:
         // check if the signal did not fire
         QCOMPARE(spyContactAdded.count(), 0);
     }
+
+    /*
+     * Test a fetch with streaming enabled, each page is delivered once
+     */
+    void testStreamingFetch()
+    {
+        // small pages, this way the result is delivered in several updates
+        qputenv("CANONICAL_PIM_SERVICE_PAGE_SIZE", "2");
+        QContactManager manager("galera");
+        QMap<QString, QString> parameters;
+        parameters.insert(ADDRESS_BOOK_STREAMING_FETCH_PROP, "true");
+        QContactManager streamingManager("galera", parameters);
+        qunsetenv("CANONICAL_PIM_SERVICE_PAGE_SIZE");
+
+        QSignalSpy spyContactAdded(&manager, SIGNAL(contactsAdded(QList<QContactId>)));
+        QList<QContact> contacts;
+        for (int i = 0; i < 5; i++) {
+            QContact contact;
+            QContactName name;
+            name.setFirstName(QString("Fulano_%1").arg(i));
+            name.setLastName("Tal");
+            contact.saveDetail(&name);
+            contacts << contact;
+        }
+        QVERIFY(manager.saveContacts(&contacts));
+        QTRY_COMPARE(spyContactAdded.count(), 1);
+
+        QContactSortOrder sort;
+        sort.setDetailType(QContactDetail::TypeName, QContactName::FieldFirstName);
+        QList<QContact> expected = manager.contacts(QContactFilter(), QList<QContactSortOrder>() << sort);
+        QVERIFY(expected.size() >= 5);
+
+        QContactFetchRequest req;
+        req.setManager(&streamingManager);
+        req.setSorting(QList<QContactSortOrder>() << sort);
+        // each update only carries the new page
+        QList<QContact> delivered;
+        int updates = 0;
+        connect(&req, &QContactFetchRequest::resultsAvailable, [&]() {
+            delivered << req.contacts();
+            updates++;
+        });
+        req.start();
+        QTRY_COMPARE(req.state(), QContactAbstractRequest::FinishedState);
+        QCOMPARE(req.error(), QContactManager::NoError);
+        QVERIFY(updates > 1);
+
+        QCOMPARE(delivered.size(), expected.size());
+        for (int i = 0; i < expected.size(); i++) {
+            QCOMPARE(delivered[i].id(), expected[i].id());
+            QCOMPARE(delivered[i].detail<QContactName>().firstName(),
+                     expected[i].detail<QContactName>().firstName());
+        }
+    }
 };
 
 QTEST_MAIN(QContactsAsyncRequestTest)
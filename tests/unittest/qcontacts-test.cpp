@@ -168,6 +168,62 @@ private Q_SLOTS:
         QCOMPARE(updatedName.lastName(), name.lastName());
     }
 
+    /*
+     * Test fetch a contact by id after it changes, the cached contact must be invalidated
+     */
+    void testFetchByIdAfterUpdate()
+    {
+        QContact contact = testContact();
+        QSignalSpy spyContactAdded(m_manager, SIGNAL(contactsAdded(QList<QContactId>)));
+        QCOMPARE(m_manager->saveContact(&contact), true);
+        QTRY_COMPARE(spyContactAdded.count(), 1);
+
+        // fetch it twice, the second one can be answered by the cache
+        QContact fetchedContact = m_manager->contact(contact.id());
+        QCOMPARE(fetchedContact.id(), contact.id());
+        fetchedContact = m_manager->contact(contact.id());
+        QCOMPARE(fetchedContact.id(), contact.id());
+        QCOMPARE(fetchedContact.detail<QContactName>().lastName(), QStringLiteral("Tal"));
+
+        // modify contact
+        QContactName name = contact.detail<QContactName>();
+        name.setLastName("Silva");
+        contact.saveDetail(&name);
+
+        QSignalSpy spyContactChanged(m_manager, SIGNAL(contactsChanged(QList<QContactId>)));
+        QCOMPARE(m_manager->saveContact(&contact), true);
+        QTRY_COMPARE(spyContactChanged.count(), 1);
+
+        fetchedContact = m_manager->contact(contact.id());
+        QCOMPARE(fetchedContact.detail<QContactName>().lastName(), QStringLiteral("Silva"));
+
+        // the id filter must return the updated contact too
+        QContactIdFilter idFilter;
+        idFilter.setIds(QList<QContactId>() << contact.id());
+        QList<QContact> contacts = m_manager->contacts(idFilter);
+        QCOMPARE(contacts.size(), 1);
+        QCOMPARE(contacts[0].detail<QContactName>().lastName(), QStringLiteral("Silva"));
+    }
+
+    /*
+     * Test query only the contact ids
+     */
+    void testQueryContactIds()
+    {
+        QContact contact = testContact();
+        QSignalSpy spyContactAdded(m_manager, SIGNAL(contactsAdded(QList<QContactId>)));
+        QCOMPARE(m_manager->saveContact(&contact), true);
+        QTRY_COMPARE(spyContactAdded.count(), 1);
+
+        QList<QContactId> ids = m_manager->contactIds();
+        QVERIFY(ids.contains(contact.id()));
+
+        QContactIdFilter idFilter;
+        idFilter.setIds(QList<QContactId>() << contact.id());
+        ids = m_manager->contactIds(idFilter);
+        QCOMPARE(ids, QList<QContactId>() << contact.id());
+    }
+
     /*
      * Test query a contact source using the contact group
      */
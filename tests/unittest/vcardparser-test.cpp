@@ -226,6 +226,51 @@ private Q_SLOTS:
         compareContact(contacts[1], m_contacts[1]);
     }
 
+    /*
+     * Test parse a list of vcards big enough to be parsed in parallel
+     */
+    void testVCardToContactAsyncInOrder()
+    {
+        QStringList vcards;
+        for(int i = 0; i < 100; i++) {
+            vcards << QString("BEGIN:VCARD\r\n"
+                              "VERSION:3.0\r\n"
+                              "N:Last%1;First%1\r\n"
+                              "TEL;TYPE=CELL:55555%1\r\n"
+                              "END:VCARD\r\n").arg(i);
+        }
+
+        VCardParser parser;
+        qRegisterMetaType< QList<QtContacts::QContact> >();
+        QSignalSpy vcardToContactSignal(&parser, SIGNAL(contactsParsed(QList<QtContacts::QContact>)));
+        parser.vcardToContact(vcards);
+
+        QTRY_COMPARE(vcardToContactSignal.count(), 1);
+        QList<QtContacts::QContact> contacts =  qvariant_cast<QList<QtContacts::QContact> >(vcardToContactSignal.takeFirst().at(0));
+        QCOMPARE(contacts.size(), 100);
+        for(int i = 0; i < contacts.size(); i++) {
+            QCOMPARE(contacts[i].detail<QContactName>().firstName(), QString("First%1").arg(i));
+        }
+    }
+
+    /*
+     * Test cancel a parse in progress
+     */
+    void testVCardToContactCancel()
+    {
+        VCardParser parser;
+        qRegisterMetaType< QList<QtContacts::QContact> >();
+        QSignalSpy vcardToContactSignal(&parser, SIGNAL(contactsParsed(QList<QtContacts::QContact>)));
+        QSignalSpy canceledSignal(&parser, SIGNAL(canceled()));
+        parser.vcardToContact(m_vcards);
+        parser.cancel();
+        parser.waitForFinished();
+
+        QCOMPARE(canceledSignal.count(), 1);
+        QCOMPARE(vcardToContactSignal.count(), 0);
+        QVERIFY(parser.contactsResult().isEmpty());
+    }
+
     /*
      * Test parse a single vcard to contact using the sync function
      */
@@ -396,6 +441,30 @@ private Q_SLOTS:
         QCOMPARE(xDetail.data().toString(), QStringLiteral("MY_REMOTE_ID"));
     }
 
+    /*
+     * Test parse a contact with avatar thumbnails into a vcard and back
+     */
+    void testAvatarThumbnails()
+    {
+        QContact c = m_contacts[0];
+
+        QVariantMap thumbnails;
+        thumbnails.insert("48", QStringLiteral("file:///tmp/thumbnails/0a1b-48.png"));
+        thumbnails.insert("96", QStringLiteral("file:///tmp/thumbnails/0a1b-96.png"));
+        QContactAvatar avatar;
+        avatar.setImageUrl(QUrl("file:///tmp/avatar.jpg"));
+        avatar.setValue(VCardParser::AvatarThumbnailsField, thumbnails);
+        c.saveDetail(&avatar);
+
+        QString vcard = VCardParser::contactToVcard(c);
+        QVERIFY(vcard.contains("X-THUMBNAIL-48=/tmp/thumbnails/0a1b-48.png"));
+
+        QContact contact = VCardParser::vcardToContact(vcard);
+        avatar = contact.detail<QContactAvatar>();
+        QCOMPARE(avatar.imageUrl(), QUrl("file:///tmp/avatar.jpg"));
+        QCOMPARE(avatar.value(VCardParser::AvatarThumbnailsField).toMap(), thumbnails);
+    }
+
     void testVCardFromGoogle()
     {
         QString vcard = QStringLiteral("BEGIN:VCARD\r\n"